@@ -0,0 +1,67 @@
+/* Compares building a B-tree of u32 keys one insert at a time with loading the sorted keys bottom
+ * up, for a few fill factors. Both write the tree to an in memory database and flush it.
+ *
+ * usage: bench_bulk_load [keys] */
+
+#include "database/bulk_load.hpp"
+#include "database/pager.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char *name, double seconds, Pager &pager)
+{
+  std::printf("%-14s %10.2f %10llu %10llu\n", name, seconds * 1e3,
+              static_cast<unsigned long long>(pager.fsize() / pager.pageSize()),
+              static_cast<unsigned long long>(pager.stats().writes));
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const u32 keys = argc > 1 ? std::stoul(argv[1]) : 1000000;
+  std::printf("%u keys\n\n", keys);
+  std::printf("%-14s %10s %10s %10s\n", "build", "ms", "pages", "writes");
+
+  {
+    std::stringstream ss;
+    Pager pager(ss);
+    const auto start = Clock::now();
+    // ascending keys always go into the first leaf, as it keeps the upper half when it splits
+    PageId leafId{};
+    UNUSED(pager.fromNextFree<BTreeHeader>(PageType::Leaf, &leafId));
+    for (u32 key{0}; key < keys; ++key)
+    {
+      leafInsert<u32>(pager, leafId, pager.getPage<BTreeHeader>(leafId), key);
+    }
+    pager.flush();
+    report("insert", secondsSince(start), pager);
+  }
+
+  for (double fill : {1.0, 0.9, 0.7})
+  {
+    std::stringstream ss;
+    Pager pager(ss);
+    const auto start = Clock::now();
+    BulkLoader<u32> loader(pager, {.fill = fill});
+    for (u32 key{0}; key < keys; ++key)
+    {
+      loader.add(key);
+    }
+    UNUSED(loader.finish());
+    pager.flush();
+    const std::string name = "bulk " + std::to_string(static_cast<int>(fill * 100)) + "%";
+    report(name.c_str(), secondsSince(start), pager);
+  }
+  return 0;
+}
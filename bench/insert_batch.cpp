@@ -0,0 +1,86 @@
+/* Compares inserting random u32 keys into a B-tree one at a time, descending from the root for
+ * each, with inserting them in batches of a few sizes. Both write the tree to an in memory database
+ * and flush it.
+ *
+ * usage: bench_insert_batch [keys] */
+
+#include "database/pages/btree.hpp"
+#include "database/pager.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char *name, double seconds, Pager &pager)
+{
+  std::printf("%-14s %10.2f %10llu %10llu\n", name, seconds * 1e3,
+              static_cast<unsigned long long>(pager.fsize() / pager.pageSize()),
+              static_cast<unsigned long long>(pager.stats().writes));
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const u32 count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+  std::printf("%u keys\n\n", count);
+  std::printf("%-14s %10s %10s %10s\n", "insert", "ms", "pages", "writes");
+
+  std::vector<u32> keys(count);
+  std::mt19937 rng(1);
+  for (u32 &key : keys)
+  {
+    key = rng();
+  }
+
+  {
+    std::stringstream ss;
+    Pager pager(ss);
+    const auto start = Clock::now();
+    PageId root{};
+    UNUSED(pager.fromNextFree<BTreeHeader>(PageType::Leaf, &root));
+    for (u32 key : keys)
+    {
+      PageId leaf = root;
+      while (!pager.readPage<BTreeHeader>(leaf).header()->isLeaf())
+      {
+        leaf = InteriorNode::childFor(pager.readPage<BTreeHeader>(leaf).header()->slots, key);
+      }
+      leafInsert<u32>(pager, leaf, pager.getPage<BTreeHeader>(leaf), key);
+      while (!pager.readPage<BTreeHeader>(root).header()->isRoot())
+      {
+        root = pager.readPage<BTreeHeader>(root).header()->parent;
+      }
+    }
+    pager.flush();
+    report("single", secondsSince(start), pager);
+  }
+
+  for (u32 batch : {100u, 10000u, count})
+  {
+    std::stringstream ss;
+    Pager pager(ss);
+    const auto start = Clock::now();
+    PageId root{};
+    UNUSED(pager.fromNextFree<BTreeHeader>(PageType::Leaf, &root));
+    for (u32 from{0}; from < count; from += batch)
+    {
+      root = insertBatch(pager, root,
+                         std::vector<u32>(keys.begin() + from,
+                                          keys.begin() + std::min(from + batch, count)));
+    }
+    pager.flush();
+    const std::string name = "batch " + std::to_string(batch);
+    report(name.c_str(), secondsSince(start), pager);
+  }
+  return 0;
+}
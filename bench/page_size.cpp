@@ -0,0 +1,148 @@
+/* Measures point lookups and a full scan of a B-tree of u32 keys for each page size.
+ * The cache gets the same byte budget for every page size, so larger pages mean fewer frames.
+ *
+ * usage: bench_page_size [keys] [lookups] [file]
+ * without a file the database is kept in memory and only the page counts are meaningful */
+
+#include "database/pager.hpp"
+#include "database/pages/btree.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// small enough that the tree does not fit for any page size
+constexpr std::size_t CACHE_BUDGET = 256 * 1024;
+
+double secondsSince(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+PageId findRoot(Pager &pager, PageId id)
+{
+  while (!pager.readPage<BTreeHeader>(id).header()->isRoot())
+  {
+    id = pager.readPage<BTreeHeader>(id).header()->parent;
+  }
+  return id;
+}
+
+u32 height(Pager &pager, PageId root)
+{
+  u32 h = 1;
+  for (PageId id = root; !pager.readPage<BTreeHeader>(id).header()->isLeaf(); ++h)
+  {
+    const auto &slots = pager.readPage<BTreeHeader>(id).header()->slots;
+    id = reinterpret_cast<const InteriorCell<u32> *>(slots.readCell(slots.begin()->cellOffset))
+             ->leftChild;
+  }
+  return h;
+}
+
+/* insert keys in ascending order, which always go into the first leaf as it keeps the upper half
+ * when it splits. returns the root */
+PageId build(std::iostream &stream, u32 pageSize, u32 keys)
+{
+  Pager pager(stream, DEFAULT_CACHE_SIZE, pageSize);
+  PageId leafId{};
+  Page<BTreeHeader> &leaf = pager.fromNextFree<BTreeHeader>(PageType::Leaf, &leafId);
+  UNUSED(leaf);
+  for (u32 key{0}; key < keys; ++key)
+  {
+    leafInsert<u32>(pager, leafId, pager.getPage<BTreeHeader>(leafId), key);
+  }
+  return findRoot(pager, leafId);
+}
+
+/* visit every leaf in key order, returns the number of keys seen */
+std::size_t scan(Pager &pager, PageId id)
+{
+  const auto &page = pager.readPage<BTreeHeader>(id);
+  if (page.header()->isLeaf())
+  {
+    return page.header()->slots.entryCount();
+  }
+
+  std::vector<PageId> children;
+  for (const Slot &s : page.header()->slots)
+  {
+    children.push_back(
+        reinterpret_cast<const InteriorCell<u32> *>(page.header()->slots.readCell(s.cellOffset))
+            ->leftChild);
+  }
+  std::size_t n = 0;
+  for (PageId child : children)
+  {
+    n += scan(pager, child);
+  }
+  return n;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const u32 keys = argc > 1 ? std::stoul(argv[1]) : 100000;
+  const u32 lookups = argc > 2 ? std::stoul(argv[2]) : 20000;
+  const char *file = argc > 3 ? argv[3] : nullptr;
+
+  std::printf("%u keys, %u lookups, %zu KiB cache, %s\n\n", keys, lookups, CACHE_BUDGET / 1024,
+              file != nullptr ? file : "in memory");
+  std::printf("%8s %6s %8s %12s %12s %10s %12s %10s\n", "page", "height", "pages", "lookup us",
+              "reads/look", "scan ms", "scan reads", "scan MB");
+
+  for (u32 pageSize = MIN_PAGE_SIZE; pageSize <= MAX_PAGE_SIZE; pageSize *= 2)
+  {
+    std::stringstream memory;
+    std::fstream disk;
+    if (file != nullptr)
+    {
+      disk.open(file, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    }
+    std::iostream &stream = file != nullptr ? static_cast<std::iostream &>(disk) : memory;
+
+    const PageId root = build(stream, pageSize, keys);
+    Pager pager(stream, CACHE_BUDGET, pageSize);
+    const u32 h = height(pager, root);
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<u32> pick(0, keys - 1);
+    u64 reads = pager.stats().reads;
+    auto start = Clock::now();
+    for (u32 i{0}; i < lookups; ++i)
+    {
+      const u32 key = pick(rng);
+      const Page<BTreeHeader> &leaf = InteriorNode::searchGetLeaf(pager, root, key);
+      const auto [first, last] = LeafNode::equalRange<u32>(leaf.header()->slots, key);
+      if (first == last)
+      {
+        std::fprintf(stderr, "key %u not found\n", key);
+        return 1;
+      }
+    }
+    const double lookupSeconds = secondsSince(start);
+    const double lookupReads = static_cast<double>(pager.stats().reads - reads) / lookups;
+
+    reads = pager.stats().reads;
+    start = Clock::now();
+    if (scan(pager, root) != keys)
+    {
+      std::fprintf(stderr, "scan did not see every key\n");
+      return 1;
+    }
+    const double scanSeconds = secondsSince(start);
+    const u64 scanReads = pager.stats().reads - reads;
+
+    std::printf("%8u %6u %8llu %12.2f %12.2f %10.2f %12llu %10.2f\n", pageSize, h,
+                static_cast<unsigned long long>(pager.fsize() / pageSize), lookupSeconds * 1e6 / lookups, lookupReads,
+                scanSeconds * 1e3, static_cast<unsigned long long>(scanReads),
+                static_cast<double>(scanReads) * pageSize / (1024 * 1024));
+  }
+  return 0;
+}
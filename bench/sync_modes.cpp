@@ -0,0 +1,130 @@
+/* Measures commit latency and throughput for each sync mode, with the database and its log in
+ * files so the syncs are real. Every commit changes a few pages of its own thread's.
+ *
+ * usage: bench_sync_modes [commits] [threads] [directory]
+ * the files are created in the directory, the system's temporary directory by default, and
+ * removed afterwards */
+
+#include "database/pager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// pages changed by each commit
+constexpr u32 PAGES_PER_COMMIT = 4;
+
+const char *name(Sync mode)
+{
+  switch (mode)
+  {
+  case Sync::Full:
+    return "full";
+  case Sync::Normal:
+    return "normal";
+  case Sync::Off:
+    return "off";
+  }
+  return "?";
+}
+
+double percentile(std::vector<double> &sorted, double p)
+{
+  return sorted[std::min<std::size_t>(sorted.size() - 1, sorted.size() * p)];
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const u32 commits = argc > 1 ? std::stoul(argv[1]) : 2000;
+  const u32 threads = argc > 2 ? std::stoul(argv[2]) : 1;
+  const std::filesystem::path dir =
+      argc > 3 ? std::filesystem::path(argv[3]) : std::filesystem::temp_directory_path();
+  const std::filesystem::path dbPath = dir / "bench_sync_modes.db";
+  const std::filesystem::path logPath = dir / "bench_sync_modes.log";
+
+  std::printf("%u commits of %u pages on %u threads in %s\n\n", commits, PAGES_PER_COMMIT, threads,
+              dir.c_str());
+  std::printf("%8s %12s %10s %10s %10s %10s %14s\n", "mode", "commits/s", "mean us", "p50 us",
+              "p99 us", "log syncs", "checkpoint ms");
+
+  for (Sync mode : {Sync::Full, Sync::Normal, Sync::Off})
+  {
+    std::filesystem::remove(dbPath);
+    std::filesystem::remove(logPath);
+    {
+      Pager pager(std::make_unique<FileStorage>(dbPath));
+      pager.useLog(std::make_unique<FileStorage>(logPath));
+      pager.setSync(mode);
+
+      std::vector<PageId> pages;
+      for (u32 i{0}; i < threads * PAGES_PER_COMMIT; ++i)
+      {
+        pages.push_back(pager.nextFree(PageType::Leaf));
+      }
+      pager.commit(Sync::Full);
+      pager.checkpoint();
+      const u64 syncs = pager.wal()->stats().syncs;
+
+      std::vector<std::vector<double>> latencies(threads);
+      const auto start = Clock::now();
+      std::vector<std::thread> workers;
+      for (u32 t{0}; t < threads; ++t)
+      {
+        workers.emplace_back(
+            [&, t]
+            {
+              for (u32 n = t; n < commits; n += threads)
+              {
+                const auto begin = Clock::now();
+                for (u32 i{0}; i < PAGES_PER_COMMIT; ++i)
+                {
+                  ExclusivePage<> page = pager.pinExclusive(pages[t * PAGES_PER_COMMIT + i]);
+                  page->buf[pager.pageSize() - 1] = static_cast<std::byte>(n);
+                }
+                pager.commit();
+                latencies[t].push_back(
+                    std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+              }
+            });
+      }
+      for (auto &w : workers)
+      {
+        w.join();
+      }
+      const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+      const u64 logSyncs = pager.wal()->stats().syncs - syncs;
+
+      const auto checkpointStart = Clock::now();
+      pager.checkpoint();
+      const double checkpointMs =
+          std::chrono::duration<double, std::milli>(Clock::now() - checkpointStart).count();
+
+      std::vector<double> all;
+      for (const auto &l : latencies)
+      {
+        all.insert(all.end(), l.begin(), l.end());
+      }
+      std::sort(all.begin(), all.end());
+      double mean = 0;
+      for (double l : all)
+      {
+        mean += l / all.size();
+      }
+      std::printf("%8s %12.0f %10.1f %10.1f %10.1f %10llu %14.2f\n", name(mode), commits / seconds,
+                  mean, percentile(all, 0.5), percentile(all, 0.99),
+                  static_cast<unsigned long long>(logSyncs), checkpointMs);
+    }
+  }
+  std::filesystem::remove(dbPath);
+  std::filesystem::remove(logPath);
+  return 0;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "storage.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/uio.h>
+#endif
+
+/* one read or write of a contiguous range of the file */
+struct IORequest
+{
+  enum class Kind
+  {
+    Read,
+    Write,
+  };
+
+  Kind kind;
+  u64 offset;
+  std::byte *buf;
+  std::size_t length;
+  // when not empty, a write gathered from these buffers instead of `buf`. `length` is their total
+  std::span<const std::span<const std::byte>> bufs = {};
+};
+
+/* Runs reads and writes in the background so many can be in flight at once.
+ * Requests are queued with `enqueue` and only start on `submit`, so a batch costs one submission.
+ * The buffers of a request must stay alive until it has been waited on */
+class AsyncIO
+{
+public:
+  using Ticket = u64;
+
+  virtual ~AsyncIO() = default;
+
+  virtual Ticket enqueue(const IORequest &request) = 0;
+  /* start every queued request */
+  virtual void submit() = 0;
+  /* block until the request has finished, submitting it first if needed. a read or write the
+   * kernel only does part of is carried on from where it stopped.
+   * returns false if it failed or ran into the end of the file, or if the ticket was never enqueued
+   * or has already been waited on */
+  virtual bool wait(Ticket ticket) = 0;
+  /* has the request finished. does not block */
+  virtual bool done(Ticket ticket) = 0;
+
+  /* io_uring when the storage has a file descriptor and the kernel supports its read and write
+   * operations, otherwise a pool of threads doing blocking I/O through the storage */
+  static std::unique_ptr<AsyncIO> create(Storage &storage, u32 depth = 64);
+};
+
+/* the portable fallback, each worker thread does blocking reads and writes through the storage */
+class ThreadPoolIO : public AsyncIO
+{
+public:
+  static constexpr u32 DEFAULT_THREADS = 4;
+
+  explicit ThreadPoolIO(Storage &storage, u32 threads = DEFAULT_THREADS);
+  ~ThreadPoolIO() override;
+
+  Ticket enqueue(const IORequest &request) override;
+  void submit() override;
+  bool wait(Ticket ticket) override;
+  bool done(Ticket ticket) override;
+
+private:
+  void work();
+
+  Storage &m_storage;
+  std::mutex m_mutex;
+  std::condition_variable m_workCv;
+  std::condition_variable m_doneCv;
+  bool m_stop = false;
+  Ticket m_nextTicket = 0;
+  std::vector<std::pair<Ticket, IORequest>> m_queued;
+  std::deque<std::pair<Ticket, IORequest>> m_work;
+  // enqueued and not finished yet
+  std::unordered_set<Ticket> m_pending;
+  std::unordered_map<Ticket, bool> m_done;
+  std::vector<std::thread> m_threads;
+};
+
+#ifdef __linux__
+/* Talks to io_uring directly through its system calls and shared rings.
+ * Completed writes are reported to the storage so it can keep track of the file size */
+class UringIO : public AsyncIO
+{
+public:
+  UringIO(Storage &storage, int fd, u32 entries);
+  ~UringIO() override;
+
+  UringIO(const UringIO &) = delete;
+  UringIO &operator=(const UringIO &) = delete;
+
+  Ticket enqueue(const IORequest &request) override;
+  void submit() override;
+  bool wait(Ticket ticket) override;
+  bool done(Ticket ticket) override;
+
+private:
+  /* can the ring do the reads and writes we ask of it */
+  static bool supportsOps(int ring) noexcept;
+  void submitLocked();
+  /* submit what is queued, false if the kernel refused */
+  bool trySubmitLocked() noexcept;
+  /* put the request in the next submission entry, the ring must have room */
+  void prepare(Ticket ticket, const IORequest &request) noexcept;
+  /* move finished requests from the completion ring into `m_done`, resubmitting the rest of any
+   * that were short */
+  void reap(bool block);
+  /* skip the part of a request that is done */
+  void advance(Ticket ticket, IORequest &request, std::size_t done) noexcept;
+
+  Storage &m_storage;
+  int m_fd;
+  int m_ring = -1;
+  u32 m_entries = 0;
+
+  void *m_sqMap = nullptr;
+  std::size_t m_sqMapSize = 0;
+  void *m_cqMap = nullptr;
+  std::size_t m_cqMapSize = 0;
+  void *m_sqes = nullptr;
+  std::size_t m_sqesSize = 0;
+
+  u32 *m_sqTail = nullptr;
+  u32 *m_sqMask = nullptr;
+  u32 *m_sqArray = nullptr;
+  u32 *m_cqHead = nullptr;
+  u32 *m_cqTail = nullptr;
+  u32 *m_cqMask = nullptr;
+  void *m_cqes = nullptr;
+
+  std::mutex m_mutex;
+  Ticket m_nextTicket = 0;
+  u32 m_queued = 0;
+  u32 m_inFlight = 0;
+  std::unordered_map<Ticket, IORequest> m_requests;
+  // the vectors of gathered writes, which the kernel reads until they complete
+  std::unordered_map<Ticket, std::vector<iovec>> m_iovecs;
+  std::unordered_map<Ticket, bool> m_done;
+};
+#endif
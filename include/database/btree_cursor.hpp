@@ -0,0 +1,275 @@
+#pragma once
+
+#include "pages/btree.hpp"
+
+#include <optional>
+
+/* Walks the keys of a B-tree of `K` in order, in either direction. Finding where to start takes one
+ * descent from the root, after that the cursor follows the leaves' sibling links and keeps the leaf
+ * it is on pinned, so a range costs a page per leaf rather than a descent per key. The chain is read
+ * ahead in whichever direction the cursor is going, separately for each cursor.
+ * The tree must not change while a cursor is on it */
+template <typename K> class BTreeCursor
+{
+public:
+  // one end of a range
+  struct Bound
+  {
+    K key;
+    bool inclusive = true;
+  };
+
+  BTreeCursor(Pager &pager, PageId root) : m_pager(pager), m_root(root) {}
+  BTreeCursor(const BTreeCursor &) = delete;
+  BTreeCursor &operator=(const BTreeCursor &) = delete;
+  ~BTreeCursor() { m_pager.endScan(m_readAhead); }
+
+  /* false once the cursor has moved past either end, or found nothing */
+  bool valid() const noexcept { return static_cast<bool>(m_leaf); }
+  /* the key the cursor is on, it must be valid */
+  K key() const;
+  PageId leaf() const noexcept { return m_leaf.id(); }
+
+  /* move to the first key not less than `key` */
+  bool seek(const K &key);
+  /* move to the first key greater than `key` */
+  bool seekAfter(const K &key);
+  bool first();
+  bool last();
+  bool next();
+  bool prev();
+
+  /* call `f` with every key between the bounds in ascending order, an unset bound leaves that end
+   * open. returns how many keys there were */
+  template <typename F>
+  std::size_t range(const std::optional<Bound> &lower, const std::optional<Bound> &upper, F &&f);
+  /* the same in descending order */
+  template <typename F>
+  std::size_t reverseRange(const std::optional<Bound> &lower, const std::optional<Bound> &upper,
+                           F &&f);
+
+private:
+  /* the leaf `key` would be inserted into */
+  PageId descend(const K &key);
+  /* the first or last leaf */
+  PageId edge(bool forward);
+  /* follow the chain from `id` to its end, backwards when `forward` as that is where a scan in
+   * that direction starts */
+  PageId outermost(PageId id, bool forward);
+  /* go to the first key of `id`, or the last going backwards, skipping empty leaves.
+   * false if there are none left that way */
+  bool enter(PageId id, bool forward);
+  SlotNum entries() const noexcept { return m_leaf.header()->slots.entryCount(); }
+
+  Pager &m_pager;
+  PageId m_root;
+  StablePage<BTreeHeader> m_leaf;
+  SlotNum m_slot = 0;
+  Pager::ReadAhead m_readAhead;
+};
+
+template <typename K> K BTreeCursor<K>::key() const
+{
+  assert(valid() && "Cursor must be on a key");
+  return LeafNode::payloadAt<K>(m_leaf.header()->slots, m_slot);
+}
+
+template <typename K> PageId BTreeCursor<K>::descend(const K &key)
+{
+  PageId id = m_root;
+  while (true)
+  {
+    const StablePage<BTreeHeader> node = m_pager.pinStable<BTreeHeader>(id);
+    if (node.header()->isLeaf())
+    {
+      return id;
+    }
+    id = InteriorNode::childFor(node.header()->slots, key);
+  }
+}
+
+template <typename K> PageId BTreeCursor<K>::edge(bool forward)
+{
+  PageId id = m_root;
+  while (true)
+  {
+    const StablePage<BTreeHeader> node = m_pager.pinStable<BTreeHeader>(id);
+    const SlotHeader &slots = node.header()->slots;
+    if (node.header()->isLeaf())
+    {
+      return outermost(id, forward);
+    }
+    if (slots.isEmpty())
+    {
+      return id;
+    }
+    // the child pointer comes first in every interior cell, and the end cell is last
+    const SlotNum slot = forward ? 0 : slots.entryCount() - 1;
+    id = *reinterpret_cast<const PageId *>(slots.readCell(slots.getSlot(slot)->cellOffset));
+  }
+}
+
+template <typename K> PageId BTreeCursor<K>::outermost(PageId id, bool forward)
+{
+  // keys equal to a separator can be left in leaves the edge cells don't lead to, like `seek` steps
+  // back over, so the edge leaf is only where to start looking
+  while (true)
+  {
+    const StablePage<BTreeHeader> leaf = m_pager.pinStable<BTreeHeader>(id);
+    const Page<> &page = leaf->template as_const<CommonHeader>();
+    const PageId next = forward ? LeafNode::prevOf(page) : LeafNode::siblingOf(page);
+    if (next == 0)
+    {
+      return id;
+    }
+    id = next;
+  }
+}
+
+template <typename K> bool BTreeCursor<K>::enter(PageId id, bool forward)
+{
+  while (id != 0)
+  {
+    StablePage<BTreeHeader> leaf = m_pager.pinStable<BTreeHeader>(id);
+    const Page<> &page = leaf->template as_const<CommonHeader>();
+    m_pager.readAhead(id, forward ? LeafNode::siblingOf : LeafNode::prevOf, m_readAhead);
+    const SlotNum count = leaf.header()->slots.entryCount();
+    if (count > 0)
+    {
+      m_slot = forward ? 0 : count - 1;
+      m_leaf = std::move(leaf);
+      return true;
+    }
+    id = forward ? LeafNode::siblingOf(page) : LeafNode::prevOf(page);
+  }
+  m_leaf.release();
+  return false;
+}
+
+template <typename K> bool BTreeCursor<K>::seek(const K &key)
+{
+  if (!enter(descend(key), true))
+  {
+    return false;
+  }
+  m_slot = LeafNode::lowerBound<K>(m_leaf.header()->slots, key);
+  if (m_slot == entries() && !next())
+  {
+    return false;
+  }
+  // keys equal to a separator can be left in the leaves before it by a split
+  while (m_slot == 0)
+  {
+    const PageId current = m_leaf.id();
+    if (!prev())
+    {
+      return enter(current, true);
+    }
+    if (this->key() < key)
+    {
+      return next();
+    }
+    m_slot = LeafNode::lowerBound<K>(m_leaf.header()->slots, key);
+  }
+  return true;
+}
+
+template <typename K> bool BTreeCursor<K>::seekAfter(const K &key)
+{
+  if (!enter(descend(key), true))
+  {
+    return false;
+  }
+  m_slot = LeafNode::upperBound<K>(m_leaf.header()->slots, key);
+  return m_slot < entries() || next();
+}
+
+template <typename K> bool BTreeCursor<K>::first()
+{
+  return enter(edge(true), true);
+}
+
+template <typename K> bool BTreeCursor<K>::last()
+{
+  return enter(edge(false), false);
+}
+
+template <typename K> bool BTreeCursor<K>::next()
+{
+  if (!valid())
+  {
+    return false;
+  }
+  if (m_slot + 1 < entries())
+  {
+    ++m_slot;
+    return true;
+  }
+  return enter(LeafNode::siblingOf(m_leaf->template as_const<CommonHeader>()), true);
+}
+
+template <typename K> bool BTreeCursor<K>::prev()
+{
+  if (!valid())
+  {
+    return false;
+  }
+  if (m_slot > 0)
+  {
+    --m_slot;
+    return true;
+  }
+  return enter(LeafNode::prevOf(m_leaf->template as_const<CommonHeader>()), false);
+}
+
+template <typename K>
+template <typename F>
+std::size_t BTreeCursor<K>::range(const std::optional<Bound> &lower,
+                                  const std::optional<Bound> &upper, F &&f)
+{
+  bool on = !lower.has_value() ? first()
+            : lower->inclusive ? seek(lower->key)
+                               : seekAfter(lower->key);
+  std::size_t n = 0;
+  for (; on; on = next())
+  {
+    const K current = key();
+    if (upper.has_value() && (upper->inclusive ? upper->key < current : !(current < upper->key)))
+    {
+      break;
+    }
+    f(current);
+    ++n;
+  }
+  return n;
+}
+
+template <typename K>
+template <typename F>
+std::size_t BTreeCursor<K>::reverseRange(const std::optional<Bound> &lower,
+                                         const std::optional<Bound> &upper, F &&f)
+{
+  bool on;
+  if (!upper.has_value())
+  {
+    on = last();
+  }
+  else
+  {
+    // step back from the first key past the bound, or from the end if there isn't one
+    on = upper->inclusive ? seekAfter(upper->key) : seek(upper->key);
+    on = on ? prev() : last();
+  }
+  std::size_t n = 0;
+  for (; on; on = prev())
+  {
+    const K current = key();
+    if (lower.has_value() && (lower->inclusive ? current < lower->key : !(lower->key < current)))
+    {
+      break;
+    }
+    f(current);
+    ++n;
+  }
+  return n;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "pages/page.hpp"
+
+#include <deque>
+#include <set>
+#include <shared_mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+using FrameId = u32;
+
+// the default byte budget for the page cache
+static constexpr std::size_t DEFAULT_CACHE_SIZE = 4 * 1024 * 1024;
+
+// a slot in the buffer pool that holds one page while it is resident
+struct Frame
+{
+  static constexpr u32 LRU_K = 2;
+
+  Frame(FrameId index, u32 pageSize) : page(Leaf, pageSize), index(index) {}
+
+  Page<> page;
+  FrameId index;
+  PageId id = 0;
+  u32 pins = 0;       // pinned frames are never chosen for eviction
+  bool dirty = false; // the page must be written back before the frame is reused
+  // with a log, changed since the last commit. it can't be written back or evicted until then
+  bool uncommitted = false;
+  // the thread that changed the page first since its last commit, whose commit logs it
+  std::thread::id writer;
+  // with a log, the end of the last record for the page. 0 once the page has been written back
+  Lsn lsn = 0;
+  // with a log, the page as it was in its last record, which the next record can be a delta
+  // against. empty when the next record has to be the whole page
+  std::vector<std::byte> logged;
+  // the logical times of the last K accesses, most recent first
+  std::array<u64, LRU_K> history = {0};
+  u32 accesses = 0;
+  // held by page guards for the duration of their access to the page
+  std::shared_mutex latch;
+};
+
+/* A fixed capacity set of frames with LRU-K (K = 2) replacement.
+ * A frame's priority is the time of its K-th most recent access, so a page has to be seen twice
+ * before it can compete with the hot set. Frames seen fewer than K times are evicted first, in LRU
+ * order, which stops a single scan over the leaves from pushing out the interior nodes.
+ * The pool does no I/O, the owner writes back dirty victims before reusing them. */
+class BufferPool
+{
+public:
+  // always keep enough frames for a split to hold the pages it works on
+  static constexpr std::size_t MIN_FRAMES = 8;
+
+  explicit BufferPool(std::size_t budgetBytes, u32 pageSize = DEFAULT_PAGE_SIZE);
+
+  std::size_t capacity() const noexcept { return m_capacity; }
+  std::size_t size() const noexcept { return m_table.size(); }
+  bool full() const noexcept { return size() >= m_capacity; }
+
+  /* find a resident page without recording an access */
+  Frame *find(PageId id) noexcept;
+  /* record an access to the frame for the replacement policy */
+  void touch(Frame &frame);
+  /* the unpinned frame that should be evicted next, or nullptr if every frame is pinned.
+   * uncommitted frames are never chosen */
+  Frame *victim() noexcept;
+  /* up to `max` committed dirty frames that are next in line for eviction */
+  std::vector<Frame *> dirtyVictims(std::size_t max);
+  /* take an unused frame for the page and record the first access. the pool must not be full */
+  Frame &insert(PageId id);
+  /* drop the page from the pool, its frame is reused by the next insert */
+  void erase(Frame &frame);
+
+  template <typename F> void forEach(F &&f)
+  {
+    for (const auto &[id, index] : m_table)
+    {
+      f(m_frames[index]);
+    }
+  }
+
+private:
+  // frames seen fewer than K times sort before all others
+  using Priority = std::tuple<bool, u64, FrameId>;
+  static Priority priority(const Frame &frame) noexcept;
+
+  u32 m_pageSize;
+  std::size_t m_capacity;
+  u64 m_clock = 0;
+  // frames are never moved once created so references to their pages stay valid
+  std::deque<Frame> m_frames;
+  std::vector<FrameId> m_unused;
+  std::unordered_map<PageId, FrameId> m_table;
+  // eviction order, lowest first
+  std::set<Priority> m_order;
+};
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "pages/btree.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+
+// how a bulk load lays out the tree
+struct BulkLoadOptions
+{
+  // how full each node is packed. below 1 leaves room for inserts before the nodes have to split
+  double fill = 1.0;
+  // leaves allocated at a time with adjacent ids, so a scan along them reads the file in order.
+  // capped to a quarter of the cache, as they stay there until they are filled
+  u32 run = 32;
+};
+
+/* Builds a B-tree of `K` bottom up from keys that are already sorted, instead of inserting them one
+ * at a time. Keys are appended to the last leaf until it is full, and each full node adds a cell for
+ * itself to the last node on the level above, so there are no descents, no splits and no slots to
+ * move. Only the last node on each level is pinned, and every page is finished before it is
+ * unpinned, so each is written once.
+ * Nodes are packed to `BulkLoadOptions::fill` and the leaves are allocated in runs of adjacent
+ * pages, doubly linked like the leaves of any other tree */
+template <typename K> class BulkLoader
+{
+public:
+  explicit BulkLoader(Pager &pager, BulkLoadOptions options = {});
+
+  BulkLoader(const BulkLoader &) = delete;
+  BulkLoader &operator=(const BulkLoader &) = delete;
+
+  /* keys must come in ascending order, equal keys are kept */
+  void add(const K &key);
+  template <typename It> void add(It first, It last)
+  {
+    for (; first != last; ++first)
+    {
+      add(*first);
+    }
+  }
+  /* close every level and return the root. nothing can be added after */
+  PageId finish();
+
+  std::size_t keys() const noexcept { return m_keys; }
+  std::size_t leaves() const noexcept { return m_leaves; }
+
+private:
+  template <typename Cell> static void append(ExclusivePage<BTreeHeader> &node, const Cell &cell)
+  {
+    std::memcpy(node.header()->slots.createNextSlotWithCell(sizeof(Cell), nullptr), &cell,
+                sizeof(Cell));
+  }
+  ExclusivePage<BTreeHeader> nextLeaf();
+  /* `child` on the level below `level` is full and the node after it starts at `key` */
+  void push(std::size_t level, const K &key, ExclusivePage<BTreeHeader> &child);
+
+  Pager &m_pager;
+  u32 m_leafCapacity;
+  u32 m_interiorCapacity;
+  u32 m_run;
+  // the node being filled on each level, the leaf first
+  std::vector<ExclusivePage<BTreeHeader>> m_levels;
+  // the rest of the run the leaves are taken from, pinned until they are used
+  std::deque<StablePage<BTreeHeader>> m_runPages;
+  std::size_t m_keys = 0;
+  std::size_t m_leaves = 0;
+  bool m_finished = false;
+};
+
+template <typename K>
+BulkLoader<K>::BulkLoader(Pager &pager, BulkLoadOptions options) : m_pager(pager)
+{
+  if (!(options.fill > 0 && options.fill <= 1))
+  {
+    throw std::invalid_argument("Fill factor must be in (0, 1].");
+  }
+  const double order = static_cast<double>(btreeOrder(pager.pageSize()));
+  m_leafCapacity = std::max(1u, static_cast<u32>(order * options.fill));
+  // an interior node needs a key and its end cell
+  m_interiorCapacity = std::max(2u, static_cast<u32>(order * options.fill));
+  m_run = std::clamp<u32>(options.run, 1, std::max<u32>(1, pager.cacheCapacity() / 4));
+}
+
+template <typename K> ExclusivePage<BTreeHeader> BulkLoader<K>::nextLeaf()
+{
+  if (m_runPages.empty())
+  {
+    for (StablePage<BTreeHeader> &page : m_pager.pinNextFreeRun<BTreeHeader>(m_run))
+    {
+      m_runPages.push_back(std::move(page));
+    }
+  }
+  ExclusivePage<BTreeHeader> leaf = m_pager.pinExclusive<BTreeHeader>(m_runPages.front().id());
+  m_runPages.pop_front();
+  m_leaves++;
+  // the run only has a common header
+  leaf->reset(PageType::Leaf);
+  return leaf;
+}
+
+template <typename K> void BulkLoader<K>::add(const K &key)
+{
+  if (m_finished)
+  {
+    throw std::logic_error("The bulk load has finished.");
+  }
+  if (m_levels.empty())
+  {
+    m_levels.push_back(nextLeaf());
+  }
+
+  const SlotNum count = m_levels[0].header()->slots.entryCount();
+  if (count > 0 && key < LeafNode::payloadAt<K>(m_levels[0].header()->slots, count - 1))
+  {
+    throw std::invalid_argument("Bulk loaded keys must be in ascending order.");
+  }
+  if (count >= m_leafCapacity)
+  {
+    ExclusivePage<BTreeHeader> full = std::exchange(m_levels[0], nextLeaf());
+    LeafNode(*full).setSibling(m_levels[0].id());
+    LeafNode(*m_levels[0]).setPrev(full.id());
+    push(1, key, full);
+  }
+  append(m_levels[0], LeafCell<K>(key));
+  m_keys++;
+}
+
+template <typename K>
+void BulkLoader<K>::push(std::size_t level, const K &key, ExclusivePage<BTreeHeader> &child)
+{
+  if (level == m_levels.size())
+  {
+    m_levels.push_back(m_pager.pinNextFree<BTreeHeader>(PageType::Interior));
+  }
+  ExclusivePage<BTreeHeader> &node = m_levels[level];
+  child.header()->parent = node.id();
+  if (node.header()->slots.entryCount() + 1u < m_interiorCapacity)
+  {
+    InteriorCell<K> cell(key);
+    cell.leftChild = child.id();
+    append(node, cell);
+    return;
+  }
+
+  // the child is the last one of a full node, whose keys all come before `key`
+  InteriorCell<K> end = InteriorCell<K>::End();
+  end.leftChild = child.id();
+  append(node, end);
+  ExclusivePage<BTreeHeader> full =
+      std::exchange(m_levels[level], m_pager.pinNextFree<BTreeHeader>(PageType::Interior));
+  push(level + 1, key, full);
+}
+
+template <typename K> PageId BulkLoader<K>::finish()
+{
+  if (m_finished)
+  {
+    throw std::logic_error("The bulk load has finished.");
+  }
+  m_finished = true;
+  if (m_levels.empty())
+  {
+    m_levels.push_back(nextLeaf());
+  }
+
+  PageId root = 0;
+  for (std::size_t level{0}; root == 0; ++level)
+  {
+    ExclusivePage<BTreeHeader> node = std::move(m_levels[level]);
+    if (level + 1 == m_levels.size())
+    {
+      // a level is only started with a key for it, so the top node always has two children
+      node.header()->parent = 0;
+      root = node.id();
+    }
+    else
+    {
+      // the last node on a level can be left with only this one child, which is still a valid node
+      InteriorCell<K> end = InteriorCell<K>::End();
+      end.leftChild = node.id();
+      node.header()->parent = m_levels[level + 1].id();
+      append(m_levels[level + 1], end);
+    }
+  }
+  m_levels.clear();
+
+  // the leaves the last run didn't need
+  for (; !m_runPages.empty(); m_runPages.pop_front())
+  {
+    const PageId id = m_runPages.front().id();
+    m_runPages.front().release();
+    m_pager.freePage(id);
+  }
+  return root;
+}
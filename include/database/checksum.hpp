@@ -0,0 +1,12 @@
+#pragma once
+
+#include "machine.hpp"
+
+#include <cstddef>
+#include <span>
+
+/* CRC32C (Castagnoli), using the SSE4.2 or ARMv8 CRC instructions when the CPU has them.
+ * Pass the previous result as `crc` to continue over more data */
+u32 crc32c(std::span<const std::byte> data, u32 crc = 0) noexcept;
+/* whether crc32c runs on CRC instructions rather than a table */
+bool crc32cAccelerated() noexcept;
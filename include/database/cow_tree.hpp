@@ -0,0 +1,443 @@
+#pragma once
+
+#include "pager.hpp"
+#include "pages/btree.hpp"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/* The versions of a structure that readers are still looking at. A reader takes a slot holding the
+ * version it started from without locking, and the writer only frees what every slot has moved
+ * past. Versions start at 1, a free slot holds 0 */
+class ReaderTable
+{
+public:
+  static constexpr u32 MAX_READERS = 64;
+
+  /* take a slot for the version in `current`, returns the slot and the version it holds */
+  std::pair<u32, u64> enter(const std::atomic<u64> &current);
+  void leave(u32 slot) noexcept;
+  /* the oldest version being read, `current` if there are no readers */
+  u64 oldest(u64 current) const noexcept;
+  /* the versions being read, in ascending order */
+  std::vector<u64> active() const;
+
+private:
+  std::array<std::atomic<u64>, MAX_READERS> m_slots{};
+};
+
+// counters for what a copy on write tree has done
+struct CowStats
+{
+  u64 versions = 0; // roots published
+  u64 copies = 0;   // pages copied instead of changed in place
+  u64 freed = 0;    // old pages given back once no reader could reach them
+};
+
+/* A B-tree of `K` keys whose reachable pages are never changed in place. An insert copies the
+ * pages from the root down to its leaf, changes the copies and publishes the new root, so a reader
+ * holding an older root keeps seeing a whole tree. Readers pin the pages they look at but never
+ * latch them and never wait on a writer, which is serialised on its own mutex. Pinning still goes
+ * through the pager's lock for every page, so reads on many threads serialise on that lock.
+ * The pages have the same layout as the in place tree, but keep no parent pointers or sibling
+ * links since those would have to be copied along with every page they point at. Replaced pages
+ * go back to the pager once every reader has moved past the version that replaced them */
+template <typename K> class CowTree
+{
+public:
+  /* a reader's view of the tree as it was when the snapshot was taken */
+  class Snapshot
+  {
+  public:
+    ~Snapshot() { release(); }
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+    Snapshot(Snapshot &&other) noexcept
+        : m_tree(std::exchange(other.m_tree, nullptr)), m_slot(other.m_slot),
+          m_version(other.m_version), m_root(other.m_root)
+    {
+    }
+
+    PageId root() const noexcept { return m_root; }
+    u64 version() const noexcept { return m_version; }
+    bool contains(const K &key) const;
+    /* the first key that is not less than `key` */
+    std::optional<K> lowerBound(const K &key) const { return lowerBound(m_root, key); }
+    /* call `f` with every key in order */
+    template <typename F> void forEach(F &&f) const { forEach(m_root, f); }
+    /* let the pages of this version be reused */
+    void release() noexcept
+    {
+      if (m_tree != nullptr)
+      {
+        m_tree->m_readers.leave(m_slot);
+        m_tree = nullptr;
+      }
+    }
+
+  private:
+    friend class CowTree;
+    Snapshot(CowTree &tree, u32 slot, u64 version, PageId root) noexcept
+        : m_tree(&tree), m_slot(slot), m_version(version), m_root(root)
+    {
+    }
+    template <typename F> void forEach(PageId id, F &f) const;
+    std::optional<K> lowerBound(PageId id, const K &key) const;
+
+    CowTree *m_tree;
+    u32 m_slot;
+    u64 m_version;
+    PageId m_root;
+  };
+
+  /* use the tree at `root`, or start an empty one */
+  explicit CowTree(Pager &pager, PageId root = 0);
+  /* every snapshot must have been released */
+  ~CowTree();
+
+  CowTree(const CowTree &) = delete;
+  CowTree &operator=(const CowTree &) = delete;
+
+  PageId root() const noexcept { return m_root.load(); }
+  u64 version() const noexcept { return m_version.load(); }
+  const CowStats &stats() const noexcept { return m_stats; }
+
+  Snapshot snapshot();
+  void insert(const K &key);
+  /* false if the key was not in the tree. leaves are not merged, an empty leaf stays in the tree */
+  bool erase(const K &key);
+  /* free the replaced pages no reader can reach anymore. inserts do this as they go */
+  void reclaim();
+
+private:
+  // the interior nodes from the root down to a leaf, with the slot followed out of each
+  using Path = std::vector<std::pair<PageId, SlotNum>>;
+
+  /* which slot of an interior node to follow for `key`, and the child it points at */
+  static std::pair<SlotNum, PageId> childFor(const Page<BTreeHeader> &node, const K &key);
+  /* find the leaf for `key`, filling in the path to it */
+  PageId descend(const K &key, Path &path);
+  /* copy the nodes on the path above a changed `child`, inserting the separator of a split child.
+   * publishes the new root and retires the originals, which are added to `replaced` */
+  void publish(const Path &path, PageId child, std::optional<InteriorCell<K>> separator,
+               std::vector<PageId> &replaced);
+  /* a new page with the contents of `id`, which is replaced once the new root is published */
+  ExclusivePage<BTreeHeader> copy(PageId id);
+  /* insert the cell into a copied node, splitting it if it is full.
+   * returns the key to insert into the parent for the new lower half if it split */
+  template <typename Cell>
+  std::optional<InteriorCell<K>> insertInto(ExclusivePage<BTreeHeader> &node, const Cell &cell);
+  void freeRetired();
+
+  Pager &m_pager;
+  std::mutex m_writer;
+  std::atomic<PageId> m_root = 0;
+  std::atomic<u64> m_version = 1;
+  ReaderTable m_readers;
+  // replaced pages, with the version that replaced them
+  std::vector<std::pair<u64, PageId>> m_retired;
+  CowStats m_stats;
+};
+
+template <typename K> CowTree<K>::CowTree(Pager &pager, PageId root) : m_pager(pager), m_root(root)
+{
+  if (root == 0)
+  {
+    m_root = m_pager.pinNextFree<BTreeHeader>(PageType::Leaf).id();
+  }
+}
+
+template <typename K> CowTree<K>::~CowTree()
+{
+  std::lock_guard lock(m_writer);
+  freeRetired();
+}
+
+template <typename K> typename CowTree<K>::Snapshot CowTree<K>::snapshot()
+{
+  const auto [slot, version] = m_readers.enter(m_version);
+  // the root is at least as new as the version, whose pages are kept for as long as the slot is
+  return Snapshot(*this, slot, version, m_root.load());
+}
+
+template <typename K>
+std::pair<SlotNum, PageId> CowTree<K>::childFor(const Page<BTreeHeader> &node, const K &key)
+{
+  const SlotHeader &slots = node.header()->slots;
+  if (slots.isEmpty())
+  {
+    throw std::runtime_error("Interior node has no end cell.");
+  }
+  const SlotNum slot = InteriorNode::childSlot(slots, key);
+  const auto *cell = reinterpret_cast<const InteriorCell<K> *>(
+      slots.readCell(slots.getSlot(slot)->cellOffset));
+  return {slot, cell->leftChild};
+}
+
+template <typename K> bool CowTree<K>::Snapshot::contains(const K &key) const
+{
+  PageId id = m_root;
+  while (true)
+  {
+    const StablePage<BTreeHeader> node = m_tree->m_pager.template pinStable<BTreeHeader>(id);
+    if (!node.header()->isLeaf())
+    {
+      id = childFor(*node, key).second;
+      continue;
+    }
+    const SlotHeader &slots = node.header()->slots;
+    const SlotNum slot = LeafNode::lowerBound<K>(slots, key);
+    return slot < slots.entryCount() &&
+           reinterpret_cast<const LeafCell<K> *>(slots.readCell(slots.getSlot(slot)->cellOffset))
+                   ->getPayload() == key;
+  }
+}
+
+template <typename K>
+std::optional<K> CowTree<K>::Snapshot::lowerBound(PageId id, const K &key) const
+{
+  std::vector<PageId> children;
+  {
+    const StablePage<BTreeHeader> node = m_tree->m_pager.template pinStable<BTreeHeader>(id);
+    const SlotHeader &slots = node.header()->slots;
+    if (node.header()->isLeaf())
+    {
+      const SlotNum slot = LeafNode::lowerBound<K>(slots, key);
+      if (slot == slots.entryCount())
+      {
+        return std::nullopt;
+      }
+      return reinterpret_cast<const LeafCell<K> *>(slots.readCell(slots.getSlot(slot)->cellOffset))
+          ->getPayload();
+    }
+    // the key is under the child it would be inserted into, or failing that the first key of a
+    // child after it
+    SlotNum slot = childFor(*node, key).first;
+    for (; slot < slots.entryCount(); ++slot)
+    {
+      children.push_back(reinterpret_cast<const InteriorCell<K> *>(
+                             slots.readCell(slots.getSlot(slot)->cellOffset))
+                             ->leftChild);
+    }
+  }
+  for (PageId child : children)
+  {
+    if (std::optional<K> found = lowerBound(child, key))
+    {
+      return found;
+    }
+  }
+  return std::nullopt;
+}
+
+template <typename K>
+template <typename F>
+void CowTree<K>::Snapshot::forEach(PageId id, F &f) const
+{
+  std::vector<PageId> children;
+  {
+    const StablePage<BTreeHeader> node = m_tree->m_pager.template pinStable<BTreeHeader>(id);
+    const SlotHeader &slots = node.header()->slots;
+    for (const Slot &s : slots)
+    {
+      if (node.header()->isLeaf())
+      {
+        f(reinterpret_cast<const LeafCell<K> *>(slots.readCell(s.cellOffset))->getPayload());
+      }
+      else
+      {
+        children.push_back(
+            reinterpret_cast<const InteriorCell<K> *>(slots.readCell(s.cellOffset))->leftChild);
+      }
+    }
+  }
+  for (PageId child : children)
+  {
+    forEach(child, f);
+  }
+}
+
+template <typename K> ExclusivePage<BTreeHeader> CowTree<K>::copy(PageId id)
+{
+  const StablePage<BTreeHeader> old = m_pager.pinStable<BTreeHeader>(id);
+  ExclusivePage<BTreeHeader> page = m_pager.pinNextFree<BTreeHeader>(old.header()->common.type);
+  // the common header belongs to the new page
+  std::memcpy(page->buf.data() + sizeof(CommonHeader), old->buf.data() + sizeof(CommonHeader),
+              m_pager.pageSize() - sizeof(CommonHeader));
+  page.header()->parent = 0;
+  if (page.header()->isLeaf())
+  {
+    LeafNode(*page).setSibling(0);
+    LeafNode(*page).setPrev(0);
+  }
+  m_stats.copies++;
+  return page;
+}
+
+template <typename K>
+template <typename Cell>
+std::optional<InteriorCell<K>> CowTree<K>::insertInto(ExclusivePage<BTreeHeader> &node,
+                                                      const Cell &cell)
+{
+  if (node.header()->slots.entryCount() < btreeOrder(m_pager.pageSize()))
+  {
+    node.header()->slots.insertCell(cell);
+    return std::nullopt;
+  }
+
+  // the lower half moves to a new page, the copy keeps the upper half
+  PageId lowerId = 0;
+  UNUSED(node.header()->split(m_pager, &lowerId));
+  ExclusivePage<BTreeHeader> lower = m_pager.pinExclusive<BTreeHeader>(lowerId);
+  lower.header()->parent = 0;
+  const K median = node.header()->template getLowestPayload<K>();
+  if (!node.header()->isLeaf())
+  {
+    // the median moves up, and where it pointed becomes the end of the lower half
+    InteriorCell<K> end = InteriorCell<K>::End();
+    end.leftChild =
+        reinterpret_cast<const InteriorCell<K> *>(node.header()->slots.getSlotAndCell(0, nullptr))
+            ->leftChild;
+    node.header()->slots.deleteSlot(static_cast<SlotNum>(0));
+    lower.header()->slots.insertCell(end);
+  }
+  insertByMedianKey(cell, median, *lower, *node);
+
+  InteriorCell<K> separator(median);
+  separator.leftChild = lowerId;
+  return separator;
+}
+
+template <typename K> PageId CowTree<K>::descend(const K &key, Path &path)
+{
+  PageId id = m_root.load();
+  while (true)
+  {
+    const StablePage<BTreeHeader> node = m_pager.pinStable<BTreeHeader>(id);
+    if (node.header()->isLeaf())
+    {
+      return id;
+    }
+    const auto [slot, child] = childFor(*node, key);
+    path.emplace_back(id, slot);
+    id = child;
+  }
+}
+
+template <typename K> void CowTree<K>::insert(const K &key)
+{
+  std::lock_guard lock(m_writer);
+  Path path;
+  const PageId id = descend(key, path);
+
+  std::vector<PageId> replaced{id};
+  ExclusivePage<BTreeHeader> leaf = copy(id);
+  const std::optional<InteriorCell<K>> separator = insertInto(leaf, LeafCell<K>(key));
+  const PageId child = leaf.id();
+  leaf.release();
+  publish(path, child, separator, replaced);
+}
+
+template <typename K> bool CowTree<K>::erase(const K &key)
+{
+  std::lock_guard lock(m_writer);
+  Path path;
+  const PageId id = descend(key, path);
+
+  std::optional<SlotNum> found;
+  {
+    const StablePage<BTreeHeader> node = m_pager.pinStable<BTreeHeader>(id);
+    const SlotHeader &slots = node.header()->slots;
+    const SlotNum slot = LeafNode::lowerBound<K>(slots, key);
+    if (slot < slots.entryCount() &&
+        reinterpret_cast<const LeafCell<K> *>(slots.readCell(slots.getSlot(slot)->cellOffset))
+                ->getPayload() == key)
+    {
+      found = slot;
+    }
+  }
+  if (!found.has_value())
+  {
+    return false;
+  }
+
+  std::vector<PageId> replaced{id};
+  ExclusivePage<BTreeHeader> leaf = copy(id);
+  leaf.header()->slots.deleteSlot(*found);
+  leaf.header()->slots.compact(BTreeHeader::slotsSize(m_pager.pageSize()));
+  const PageId child = leaf.id();
+  leaf.release();
+  publish(path, child, std::nullopt, replaced);
+  return true;
+}
+
+template <typename K>
+void CowTree<K>::publish(const Path &path, PageId child, std::optional<InteriorCell<K>> separator,
+                         std::vector<PageId> &replaced)
+{
+  for (auto it = path.rbegin(); it != path.rend(); ++it)
+  {
+    const auto [nodeId, slot] = *it;
+    replaced.push_back(nodeId);
+    ExclusivePage<BTreeHeader> node = copy(nodeId);
+    reinterpret_cast<InteriorCell<K> *>(node.header()->slots.getSlotAndCell(slot, nullptr))
+        ->leftChild = child;
+    if (separator.has_value())
+    {
+      separator = insertInto(node, *separator);
+    }
+    child = node.id();
+  }
+  if (separator.has_value())
+  {
+    // the root split, grow a new one above it
+    ExclusivePage<BTreeHeader> root = m_pager.pinNextFree<BTreeHeader>(PageType::Interior);
+    InteriorCell<K> end = InteriorCell<K>::End();
+    end.leftChild = child;
+    root.header()->slots.insertCell(*separator);
+    root.header()->slots.insertCell(end);
+    child = root.id();
+  }
+
+  // readers that see the old version keep the old root, see `ReaderTable::enter`
+  m_root.store(child);
+  const u64 version = m_version.load() + 1;
+  m_version.store(version);
+  for (PageId old : replaced)
+  {
+    m_retired.emplace_back(version, old);
+  }
+  m_stats.versions++;
+  freeRetired();
+}
+
+template <typename K> void CowTree<K>::reclaim()
+{
+  std::lock_guard lock(m_writer);
+  freeRetired();
+}
+
+template <typename K> void CowTree<K>::freeRetired()
+{
+  // a page replaced by a version can be freed once every reader is at that version or later
+  const u64 oldest = m_readers.oldest(m_version.load());
+  std::size_t kept = 0;
+  for (const auto &[version, id] : m_retired)
+  {
+    if (version <= oldest)
+    {
+      m_pager.freePage(id);
+      m_stats.freed++;
+    }
+    else
+    {
+      m_retired[kept++] = {version, id};
+    }
+  }
+  m_retired.resize(kept);
+}
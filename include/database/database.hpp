@@ -8,7 +8,11 @@
 class Database
 {
 public:
-  explicit Database(std::iostream &stream);
+  explicit Database(std::iostream &stream, u32 pageSize = DEFAULT_PAGE_SIZE);
+  explicit Database(std::unique_ptr<Storage> storage, u32 pageSize = DEFAULT_PAGE_SIZE);
+  /* changes only reach `storage` through the write-ahead log in `log`, see `Pager::commit` */
+  Database(std::unique_ptr<Storage> storage, std::unique_ptr<Storage> log,
+           u32 pageSize = DEFAULT_PAGE_SIZE);
   Pager pager;
 };
 
@@ -0,0 +1,350 @@
+#pragma once
+
+#include "cow_tree.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <map>
+#include <thread>
+#include <type_traits>
+
+// counters for what a multi version store has done
+struct MvccStats
+{
+  u64 commits = 0;   // transactions that wrote something
+  u64 conflicts = 0; // commits refused because a key was written since the transaction began
+  u64 collected = 0; // versions dropped once no transaction could see them
+};
+
+/* Rows of `K` to `V` with snapshot isolation. Every committed write adds a version of its row
+ * tagged with the commit timestamp, and a transaction sees the newest version of each row that
+ * committed before it began. The versions are kept in a `CowTree` ordered by key and then newest
+ * first, so a read is one descent to the first version at or before the transaction's timestamp.
+ * Readers take no page latches and no tree or commit locks, only the pager's own lock on its cache.
+ * Commits are serialised and the first to commit wins: a transaction that writes a key someone
+ * else committed since it began is refused. Versions that no running transaction would read, and
+ * that no new one will, are collected by `collect` or on a background thread */
+template <typename K, typename V> class MvccStore
+{
+public:
+  // one version of a row, the key and timestamp are what the tree is ordered by
+  struct Row
+  {
+    K key;
+    V value;
+    u64 ts;
+    bool deleted;
+
+    friend bool operator<(const Row &a, const Row &b)
+    {
+      if (a.key < b.key || b.key < a.key)
+      {
+        return a.key < b.key;
+      }
+      return a.ts > b.ts;
+    }
+    friend bool operator==(const Row &a, const Row &b)
+    {
+      return !(a.key < b.key) && !(b.key < a.key) && a.ts == b.ts;
+    }
+  };
+  static_assert(std::is_trivially_copyable_v<Row> && sizeof(Row) <= MAX_CELL_PAYLOAD,
+                "A row version must fit in a cell");
+
+  /* reads see the store as it was when the transaction began, with its own writes on top.
+   * the writes are only applied on `commit` */
+  class Transaction
+  {
+  public:
+    ~Transaction() { abort(); }
+
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+    Transaction(Transaction &&other) noexcept
+        : m_store(std::exchange(other.m_store, nullptr)), m_slot(other.m_slot), m_ts(other.m_ts),
+          m_snapshot(std::move(other.m_snapshot)), m_writes(std::move(other.m_writes))
+    {
+    }
+
+    u64 timestamp() const noexcept { return m_ts; }
+    std::optional<V> get(const K &key) const;
+    void put(const K &key, const V &value) { m_writes[key] = value; }
+    void erase(const K &key) { m_writes[key] = std::nullopt; }
+    /* apply the writes at a new timestamp. false if another transaction committed a write to one
+     * of the keys since this one began, in which case nothing is written */
+    bool commit();
+    /* drop the writes and stop holding back the collection of old versions */
+    void abort() noexcept;
+
+  private:
+    friend class MvccStore;
+    Transaction(MvccStore &store, u32 slot, u64 ts, typename CowTree<Row>::Snapshot snapshot)
+        : m_store(&store), m_slot(slot), m_ts(ts), m_snapshot(std::move(snapshot))
+    {
+    }
+
+    MvccStore *m_store;
+    u32 m_slot;
+    u64 m_ts;
+    typename CowTree<Row>::Snapshot m_snapshot;
+    // nullopt erases the row
+    std::map<K, std::optional<V>> m_writes;
+  };
+
+  /* a new store, or the one already in the tree at `root` */
+  explicit MvccStore(Pager &pager, PageId root = 0);
+  /* every transaction must have finished */
+  ~MvccStore() { stopCollector(); }
+
+  MvccStore(const MvccStore &) = delete;
+  MvccStore &operator=(const MvccStore &) = delete;
+
+  PageId root() const noexcept { return m_tree.root(); }
+  const MvccStats &stats() const noexcept { return m_stats; }
+  const CowTree<Row> &tree() const noexcept { return m_tree; }
+
+  Transaction begin();
+  /* drop the versions no running transaction can see. returns how many */
+  std::size_t collect();
+  /* collect every `interval` on a background thread */
+  void startCollector(std::chrono::milliseconds interval = std::chrono::milliseconds{100});
+  void stopCollector();
+
+private:
+  /* the newest version of the row at or before `ts` */
+  static std::optional<Row> find(const typename CowTree<Row>::Snapshot &snapshot, const K &key,
+                                 u64 ts);
+
+  CowTree<Row> m_tree;
+  // the timestamp of the last commit, the one new transactions read at
+  std::atomic<u64> m_clock = 1;
+  std::mutex m_commitMutex;
+  std::mutex m_collectMutex;
+  // the timestamps running transactions read at
+  ReaderTable m_transactions;
+  MvccStats m_stats;
+
+  struct Collector
+  {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop = false;
+    std::thread thread;
+  };
+  std::unique_ptr<Collector> m_collector;
+};
+
+template <typename K, typename V>
+MvccStore<K, V>::MvccStore(Pager &pager, PageId root) : m_tree(pager, root)
+{
+  if (root == 0)
+  {
+    return;
+  }
+  // carry on from the newest commit in the tree, so later versions still sort before it
+  u64 latest = m_clock.load();
+  m_tree.snapshot().forEach([&latest](const Row &row) { latest = std::max(latest, row.ts); });
+  m_clock.store(latest);
+}
+
+template <typename K, typename V>
+std::optional<typename MvccStore<K, V>::Row>
+MvccStore<K, V>::find(const typename CowTree<Row>::Snapshot &snapshot, const K &key, u64 ts)
+{
+  // versions of a row are newest first, so the first at or after (key, ts) is the one to see
+  Row probe{};
+  probe.key = key;
+  probe.ts = ts;
+  const std::optional<Row> row = snapshot.lowerBound(probe);
+  if (!row.has_value() || row->key < key || key < row->key)
+  {
+    return std::nullopt;
+  }
+  return row;
+}
+
+template <typename K, typename V>
+typename MvccStore<K, V>::Transaction MvccStore<K, V>::begin()
+{
+  const auto [slot, ts] = m_transactions.enter(m_clock);
+  // every commit up to `ts` finished its inserts before the clock moved, so the tree has them
+  return Transaction(*this, slot, ts, m_tree.snapshot());
+}
+
+template <typename K, typename V>
+std::optional<V> MvccStore<K, V>::Transaction::get(const K &key) const
+{
+  if (auto it = m_writes.find(key); it != m_writes.end())
+  {
+    return it->second;
+  }
+  const std::optional<Row> row = find(m_snapshot, key, m_ts);
+  if (!row.has_value() || row->deleted)
+  {
+    return std::nullopt;
+  }
+  return row->value;
+}
+
+template <typename K, typename V> bool MvccStore<K, V>::Transaction::commit()
+{
+  if (m_store == nullptr)
+  {
+    return false;
+  }
+  if (m_writes.empty())
+  {
+    abort();
+    return true;
+  }
+
+  MvccStore &store = *m_store;
+  {
+    std::lock_guard lock(store.m_commitMutex);
+    {
+      const typename CowTree<Row>::Snapshot latest = store.m_tree.snapshot();
+      for (const auto &[key, value] : m_writes)
+      {
+        const std::optional<Row> row = find(latest, key, std::numeric_limits<u64>::max());
+        if (row.has_value() && row->ts > m_ts)
+        {
+          store.m_stats.conflicts++;
+          abort();
+          return false;
+        }
+      }
+    }
+
+    const u64 ts = store.m_clock.load() + 1;
+    for (const auto &[key, value] : m_writes)
+    {
+      Row row{};
+      row.key = key;
+      row.value = value.value_or(V{});
+      row.ts = ts;
+      row.deleted = !value.has_value();
+      store.m_tree.insert(row);
+    }
+    // only now can new transactions see the commit
+    store.m_clock.store(ts);
+    store.m_stats.commits++;
+  }
+  abort();
+  return true;
+}
+
+template <typename K, typename V> void MvccStore<K, V>::Transaction::abort() noexcept
+{
+  if (m_store == nullptr)
+  {
+    return;
+  }
+  m_writes.clear();
+  m_snapshot.release();
+  m_store->m_transactions.leave(m_slot);
+  m_store = nullptr;
+}
+
+template <typename K, typename V> std::size_t MvccStore<K, V>::collect()
+{
+  std::lock_guard lock(m_collectMutex);
+  // a transaction that begins from now on reads at `now` or later
+  const u64 now = m_clock.load();
+  const std::vector<u64> reading = m_transactions.active();
+  const u64 oldest = reading.empty() ? now : std::min(reading.front(), now);
+  // a version is seen by the transactions reading from its timestamp up to the next version's
+  const auto seen = [&](u64 from, u64 to)
+  {
+    const auto it = std::lower_bound(reading.begin(), reading.end(), from);
+    return to > now || (it != reading.end() && *it < to);
+  };
+
+  std::vector<Row> dead;
+  std::vector<Row> versions;
+  const auto sweep = [&]
+  {
+    // newest first
+    std::vector<bool> keep(versions.size());
+    u64 next = std::numeric_limits<u64>::max();
+    for (std::size_t i{0}; i < versions.size(); ++i)
+    {
+      keep[i] = seen(versions[i].ts, next);
+      next = versions[i].ts;
+    }
+    // an erase with nothing kept before it looks the same as no row at all, once no running
+    // transaction could have started before it and still write the row
+    bool olderKept = false;
+    for (std::size_t i = versions.size(); i-- > 0;)
+    {
+      if (keep[i] && versions[i].deleted && !olderKept && versions[i].ts <= oldest)
+      {
+        keep[i] = false;
+      }
+      olderKept = olderKept || keep[i];
+      if (!keep[i])
+      {
+        dead.push_back(versions[i]);
+      }
+    }
+    versions.clear();
+  };
+
+  {
+    const typename CowTree<Row>::Snapshot snapshot = m_tree.snapshot();
+    snapshot.forEach(
+        [&](const Row &row)
+        {
+          if (!versions.empty() && versions.back().key < row.key)
+          {
+            sweep();
+          }
+          versions.push_back(row);
+        });
+    sweep();
+  }
+
+  for (const Row &row : dead)
+  {
+    UNUSED(m_tree.erase(row));
+  }
+  m_stats.collected += dead.size();
+  return dead.size();
+}
+
+template <typename K, typename V>
+void MvccStore<K, V>::startCollector(std::chrono::milliseconds interval)
+{
+  if (m_collector != nullptr)
+  {
+    return;
+  }
+  m_collector = std::make_unique<Collector>();
+  m_collector->thread = std::thread(
+      [this, interval]
+      {
+        std::unique_lock lock(m_collector->mutex);
+        while (!m_collector->cv.wait_for(lock, interval, [this] { return m_collector->stop; }))
+        {
+          lock.unlock();
+          UNUSED(collect());
+          lock.lock();
+        }
+      });
+}
+
+template <typename K, typename V> void MvccStore<K, V>::stopCollector()
+{
+  if (m_collector == nullptr)
+  {
+    return;
+  }
+  {
+    std::lock_guard lock(m_collector->mutex);
+    m_collector->stop = true;
+  }
+  m_collector->cv.notify_all();
+  m_collector->thread.join();
+  m_collector.reset();
+}
@@ -1,69 +1,41 @@
 #pragma once
 
-#include "row.hpp"
+#include "common.hpp"
+#include "machine.hpp"
+#include "async_io.hpp"
+#include "buffer_pool.hpp"
+#include "storage.hpp"
+#include "wal.hpp"
+#include "pages/page.hpp"
 #include "pages/page_header.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
-#include <unordered_map>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
 
-// template the header so that we can retrieve it easily
 struct BTreeHeader;
+class Pager;
 
-template <typename Header = CommonHeader> struct Page
-{
-  std::array<std::byte, PAGE_SIZE> buf = {static_cast<std::byte>(0)};
-
-  Page() : Page(Leaf) {}
-
-  explicit Page(PageType type)
-  {
-    buf.fill(static_cast<std::byte>(0));
-
-    // TODO: endianness
-
-    // setup the custom header
-
-    Header *h = header();
-    *h = Header();
-
-    // setup the common header
-    setType(type);
-  }
-
-  inline void setType(PageType type)
-  {
-    CommonHeader *ch = reinterpret_cast<CommonHeader *>(header());
-    ch->type = type;
-  }
-
-  // cast the current header to a different header type
-  // this is intended to be used when reading the page from disk and relying on the `type` value
-  /* return a pointer to the page, casted to a certain page header type */
-  template <typename H> // pointer to a page header type
-  constexpr Page<H> *as()
-  {
-    return reinterpret_cast<Page<H> *>(this);
-  }
-
-  // when header type is non pointer return a reference to the page instead
-  template <typename H> Page<H> &as_ref()
-  {
-    // return *std::launder(reinterpret_cast<Page<H>*>(this));
-    return reinterpret_cast<Page<H> &>(*this);
-  }
-
-  Header *header() noexcept { return reinterpret_cast<Header *>(buf.data()); }
-  const Header *header() const noexcept { return reinterpret_cast<const Header *>(buf.data()); }
-};
-
-// the freelist pages are kept as a linked list with the head stored in the `DatabaseHeader`
+// the free pages are listed in trunk pages, each an array of free page ids and a pointer to the
+// next trunk, with the head stored in the `DatabaseHeader`. allocating from the head trunk needs no
+// reads, and when it is empty the trunk itself is handed out.
+// the ids are kept in descending order so the lowest is used first and runs of adjacent ids are
+// easy to find
 struct FreelistPage
 {
   struct Header
   {
     CommonHeader common;
     PageId next = 0;
+    u32 count = 0; // free page ids held after the header
   };
 
   Page<Header> page = Page<Header>(PageType::Freelist);
@@ -75,6 +47,19 @@ struct FreelistPage
   }
 
   inline PageId next() { return page.header()->next; }
+
+  static constexpr u32 capacity(u32 pageSize) noexcept
+  {
+    return (pageSize - sizeof(Header)) / sizeof(PageId);
+  }
+  static std::span<PageId> ids(Page<Header> &trunk) noexcept
+  {
+    return {reinterpret_cast<PageId *>(trunk.header() + 1), trunk.header()->count};
+  }
+  static std::span<const PageId> ids(const Page<Header> &trunk) noexcept
+  {
+    return {reinterpret_cast<const PageId *>(trunk.header() + 1), trunk.header()->count};
+  }
 };
 
 // the first page of the document file located at offset 0
@@ -103,7 +88,7 @@ struct OverflowPage
   Page<Header> page = Page<Header>(PageType::Overflow);
 };
 
-class PageError : std::exception
+class PageError : public std::exception
 {
 private:
   std::string m_message;
@@ -122,29 +107,289 @@ public:
   const char *what() const noexcept override { return m_message.c_str(); }
 };
 
+// a page read in place from the storage's mapping, handed out by guards without a copy
+struct MappedView
+{
+  MappedView(PageId id, Page<> view) : page(std::move(view)), id(id) {}
+
+  Page<> page;
+  PageId id;
+  // guards on the view. while there are any the page is not written back, which would change the
+  // mapping under them, and the file is not truncated past it
+  u32 pins = 0;
+};
+
+enum class Latch
+{
+  Shared,
+  Exclusive,
+  None, // only pinned, for pages that are never changed in place while they can be reached
+};
+
+/* A pinned page. The frame cannot be evicted while the guard is alive, and the guard holds the
+ * frame's latch: shared guards only give const access and can be held by many threads, an
+ * exclusive guard marks the page dirty. A thread must not latch a page it already holds.
+ * When the storage is mapped, a shared guard on a page that is not cached points straight into the
+ * mapping and pins the view instead. A writer then changes a copy in the cache, which is not
+ * written back into the mapping until the view is released. Unlatched guards are read only like
+ * shared ones */
+template <typename H, Latch L> class PageGuard
+{
+public:
+  using page_type = std::conditional_t<L == Latch::Exclusive, Page<H>, const Page<H>>;
+
+  PageGuard() noexcept = default;
+  ~PageGuard() { release(); }
+
+  PageGuard(const PageGuard &) = delete;
+  PageGuard &operator=(const PageGuard &) = delete;
+
+  PageGuard(PageGuard &&other) noexcept
+      : m_pager(std::exchange(other.m_pager, nullptr)),
+        m_frame(std::exchange(other.m_frame, nullptr)), m_view(std::exchange(other.m_view, nullptr)),
+        m_page(std::exchange(other.m_page, nullptr)), m_id(other.m_id)
+  {
+  }
+
+  PageGuard &operator=(PageGuard &&other) noexcept
+  {
+    if (this != &other)
+    {
+      release();
+      m_pager = std::exchange(other.m_pager, nullptr);
+      m_frame = std::exchange(other.m_frame, nullptr);
+      m_view = std::exchange(other.m_view, nullptr);
+      m_page = std::exchange(other.m_page, nullptr);
+      m_id = other.m_id;
+    }
+    return *this;
+  }
+
+  explicit operator bool() const noexcept { return m_page != nullptr; }
+  PageId id() const noexcept { return m_id; }
+
+  page_type &page() const noexcept { return *reinterpret_cast<page_type *>(m_page); }
+  page_type &operator*() const noexcept { return page(); }
+  page_type *operator->() const noexcept { return &page(); }
+  auto *header() const noexcept { return page().header(); }
+
+  /* unlatch and unpin the page early */
+  void release() noexcept;
+
+private:
+  friend class Pager;
+  PageGuard(Pager &pager, Frame &frame) noexcept
+      : m_pager(&pager), m_frame(&frame), m_page(&frame.page), m_id(frame.id)
+  {
+  }
+  PageGuard(Pager &pager, MappedView &view) noexcept
+      : m_pager(&pager), m_view(&view), m_page(&view.page), m_id(view.id)
+  {
+    static_assert(L != Latch::Exclusive, "Mapped pages are read only");
+  }
+
+  Pager *m_pager = nullptr;
+  Frame *m_frame = nullptr;
+  MappedView *m_view = nullptr;
+  Page<> *m_page = nullptr;
+  PageId m_id = 0;
+};
+
+template <typename H = CommonHeader> using SharedPage = PageGuard<H, Latch::Shared>;
+template <typename H = CommonHeader> using ExclusivePage = PageGuard<H, Latch::Exclusive>;
+template <typename H = CommonHeader> using StablePage = PageGuard<H, Latch::None>;
+
+// counters for what the pager has done since it was opened
+struct PagerStats
+{
+  u64 reads = 0;        // pages read in on a cache miss
+  u64 writes = 0;       // pages written back
+  u64 writeCalls = 0;   // writes made to the storage, adjacent pages share one
+  u64 extents = 0;      // times the file was grown ahead of the pages being used
+  u64 prefetched = 0;   // pages read ahead of being asked for
+  u64 prefetchHits = 0; // misses served by a prefetch instead of a read
+  u64 readAhead = 0;       // prefetches started by a sequential scan
+  u64 readAheadWasted = 0; // of those, the ones the scan never reached
+  u64 verified = 0;         // pages whose checksum was checked as they were read in
+  u64 redone = 0;           // pages recovered from the log
+  u64 redoSkipped = 0;      // log records recovery found the page already had
+  u64 checkpoints = 0;      // times the log was started over
+  u64 checkpointWrites = 0; // pages written back by checkpoints
+};
+
+// which pages read from the storage have their checksum checked
+enum class Verify
+{
+  Always,
+  Once, // skip pages already checked or written since the pager was opened
+  Never,
+};
+
+// when the background checkpointer runs and how hard it pushes
+struct CheckpointOptions
+{
+  // checkpoint this often while there is anything in the log. longer means fewer writes of hot
+  // pages, but more log to redo after a crash
+  std::chrono::milliseconds interval{1000};
+  // checkpoint as soon as a commit takes the log past this many bytes
+  u64 maxLogSize = 16 * 1024 * 1024;
+  // pages written back per step, the pager is only locked for one step at a time
+  std::size_t batch = 32;
+  // the pause between steps while the foreground is reading pages
+  std::chrono::milliseconds throttle{2};
+};
+
 // manages the pages for the database
-// keeps a cache that is flushed to disk
+// keeps a bounded cache of pages. modified pages are only written back when they are evicted, on
+// `flush` or when the pager is destroyed, always in page order
+// with a log, changes are made durable by `commit` appending the changed pages to the log, and
+// a page is only written back once it is committed and its log records are durable. uncommitted
+// pages stay in the cache, so the changes between two commits have to fit in it
 class Pager
 {
 public:
-  u32 fsize() const noexcept { return m_fSize; }
+  // the most dirty pages written back together when a dirty page has to be evicted
+  static constexpr std::size_t WRITEBACK_BATCH = 32;
+  // how much disk space is reserved at a time for appended pages
+  static constexpr std::size_t DEFAULT_EXTENT_SIZE = 1024 * 1024;
+  // the most adjacent pages written back in one call
+  static constexpr std::size_t MAX_WRITE_RUN = 64;
+  // the most prefetches in flight or waiting to be used
+  static constexpr std::size_t MAX_PREFETCH = 64;
+  // the most threads recovery uses by default
+  static constexpr u32 MAX_REDO_THREADS = 8;
+  // bounds for how many pages a scan reads ahead
+  static constexpr u32 MIN_READAHEAD = 4;
+  static constexpr u32 MAX_READAHEAD = 32;
+
+  /* what one scan has read ahead of itself, so scans going on at once don't disturb each other */
+  struct ReadAhead
+  {
+    PageId expected = 0; // where the scan should go next
+    u32 window = MIN_READAHEAD;
+    std::unordered_set<PageId> issued; // read ahead but not reached yet
+  };
 
+  u64 fsize() const noexcept { return m_fSize; }
+  u32 pageSize() const noexcept { return m_pageSize; }
+  /* the end of the disk space reserved for appended pages, at least `fsize` */
+  u64 reservedSize() const noexcept { return std::max(m_reserved, m_fSize); }
+  /* grow the file by this many bytes at a time as pages are appended, 0 to grow a page at a time.
+   * rounded up to whole pages */
+  void setExtentSize(std::size_t bytes) noexcept { m_extentSize = bytes; }
+  void setVerify(Verify verify) noexcept { m_verify = verify; }
+  /* how hard commits and write backs work to survive a crash, see `Sync`. commits can ask for
+   * their own */
+  void setSync(Sync sync) noexcept { m_sync = sync; }
+  Sync sync() const noexcept { return m_sync; }
+  std::size_t cacheCapacity() const noexcept { return m_pool.capacity(); }
+  std::size_t cachedPages() const noexcept { return m_pool.size(); }
+  std::size_t dirtyPages();
+  const PagerStats &stats() const noexcept { return m_stats; }
+  /* counts the pages handed out for writing, so a caller can tell if anything changed since */
+  u64 changes() const noexcept { return m_changes; }
+  Storage &storage() noexcept { return *m_storage; }
+  Wal *wal() noexcept { return m_wal.get(); }
+
+  /* the returned reference stays valid until the page is evicted from the cache.
+   * the page is assumed to be modified through it and is marked dirty */
   template <typename H = CommonHeader> // page header type
   Page<H> &getPage(PageId pageNum);
-  void setPage(PageId pageNum, const Page<> &page) noexcept;
+  /* like getPage, but for reading only so the page is not marked dirty */
+  template <typename H = CommonHeader> const Page<H> &readPage(PageId pageNum);
+  void setPage(PageId pageNum, const Page<> &page);
+  void markDirty(PageId pageNum);
 
-  template <typename H = CommonHeader> void flushPage(u32 pageNum, const Page<H> &page)
+  /* pin the page in the cache and latch it for the lifetime of the returned guard */
+  template <typename H = CommonHeader> SharedPage<H> pinShared(PageId pageNum)
   {
-    if (!m_stream.seekp(pageNum * PAGE_SIZE))
+    if (MappedView *view = pinMapped(pageNum))
     {
-      throw PageError(pageNum, "Failed in seeking to flush");
-      return;
+      return SharedPage<H>(*this, *view);
     }
-    if (!m_stream.write(reinterpret_cast<const char *>(page.buf.data()), page.buf.size()))
+    Frame &frame = pin(pageNum, false);
+    frame.latch.lock_shared();
+    return SharedPage<H>(*this, frame);
+  }
+  /* pin the page without latching it, for structures that copy a page instead of changing it.
+   * the lookup and pin still take the pager's lock */
+  template <typename H = CommonHeader> StablePage<H> pinStable(PageId pageNum)
+  {
+    if (MappedView *view = pinMapped(pageNum))
     {
-      throw PageError(pageNum, "Failed to flush");
-      return;
+      return StablePage<H>(*this, *view);
     }
+    return StablePage<H>(*this, pin(pageNum, false));
+  }
+  template <typename H = CommonHeader> ExclusivePage<H> pinExclusive(PageId pageNum)
+  {
+    Frame &frame = pin(pageNum, true);
+    frame.latch.lock();
+    return ExclusivePage<H>(*this, frame);
+  }
+  /* like fromNextFree, but the new page is returned pinned */
+  template <typename H> ExclusivePage<H> pinNextFree(PageType type = Leaf)
+  {
+    PageId pageId = 0;
+    UNUSED(fromNextFree<H>(type, &pageId));
+    return pinExclusive<H>(pageId);
+  }
+
+  /* write every dirty page back in page order and sync the file, unless syncing is off. pages
+   * latched by another guard are skipped, as are uncommitted pages when there is a log */
+  void flush();
+
+  /* Log changes to `log` before they reach the database file. Call before using the pager.
+   * Anything committed to the log that may not have made it to the file before a crash is redone
+   * on `redoThreads` threads (0 for one per core) split by page id, skipping records that the page
+   * on disk already has. The pager can be used straight away, a page that has not been redone
+   * yet is redone as soon as it is needed */
+  void useLog(std::unique_ptr<Storage> log, u32 redoThreads = 0);
+  /* block until every page has been redone */
+  void waitForRecovery();
+  bool recovering();
+  /* make the calling thread's changes since its last commit durable and return the lsn of the
+   * commit. the pages are logged together, then the caller waits for a sync of the log which other
+   * threads' commits can share. pages latched by a writer are left for the next commit. a page
+   * changed by several threads goes with the commit of the first to change it.
+   * without a log this is `flush`, and the file is only synced for `Sync::Full` */
+  Lsn commit() { return commit(m_sync); }
+  /* commit with its own sync mode instead of the pager's */
+  Lsn commit(Sync sync);
+  /* write back every committed page and start the log over. a page changed since its last commit
+   * has the image it was committed with written instead. the log is only kept while a page is
+   * being read in place from a mapping */
+  void checkpoint();
+  /* checkpoint on a background thread, see `CheckpointOptions`. pages are written back a batch at
+   * a time in page order and the log is started over at the end */
+  void startCheckpointer(CheckpointOptions options = {});
+  void stopCheckpointer();
+  /* tell the storage how a run of pages is about to be accessed */
+  void advise(PageId first, u32 count, Storage::Access access);
+
+  /* do reads and write backs through `io` so they can be in flight together */
+  void useAsyncIO(std::unique_ptr<AsyncIO> io);
+  /* start reading pages that will be needed soon, e.g. the children of an interior node.
+   * pages that are cached, mapped or not yet on disk are skipped. does nothing without async io */
+  void prefetch(std::span<const PageId> pages);
+  /* Called by a scan after reading each page it reaches through a sibling link, with a function
+   * that reads the link. When the next page is also the next on disk, the following window of pages
+   * is prefetched by id. Otherwise the chain is followed through pages already in memory and the
+   * first one that isn't is prefetched. The window doubles each time the scan reaches a page read
+   * ahead for it, and halves when the scan stops or jumps before using them */
+  void readAhead(PageId pageNum, PageId (*next)(const Page<> &), ReadAhead &scan);
+  /* the same for a scan that doesn't keep its own state, starting another such scan ends it */
+  void readAhead(PageId pageNum, PageId (*next)(const Page<> &))
+  {
+    readAhead(pageNum, next, m_readAhead);
+  }
+  /* the scan is finished, what it read ahead and never reached is wasted */
+  void endScan(ReadAhead &scan) noexcept;
+  u32 readAheadWindow() const noexcept { return m_readAhead.window; }
+
+  template <typename H = CommonHeader> void flushPage(u32 pageNum, const Page<H> &page)
+  {
+    writePage(pageNum, page.template as_const<CommonHeader>());
   }
 
   /* Get the next free page and intiialise its header to H */
@@ -154,22 +399,38 @@ public:
     const auto pageId = nextFree(type);
     auto &page = getPage<H>(pageId);
     // construct the header defaults
-    *page.header() = H();
-    // page type is not part of header defaults
-    page.setType(type);
+    page.reset(type);
     if (retPageId != nullptr)
       *retPageId = pageId;
     return page;
   }
 
+  /* a page from the free list or the end of the file, reset to `type` */
   [[nodiscard]] PageId nextFree(PageType type = PageType::Leaf);
+  /* `count` pages with adjacent ids, for pages that will be read in order like a run of leaves.
+   * taken from the head trunk of the free list if it has such a run, otherwise appended.
+   * returns the first */
+  [[nodiscard]] PageId nextFreeRun(u32 count, PageType type = PageType::Leaf);
+  /* like nextFreeRun, but the pages are returned pinned. new pages are the first to be evicted, so
+   * otherwise the start of a long run could be written back before it is used */
+  template <typename H = CommonHeader>
+  std::vector<StablePage<H>> pinNextFreeRun(u32 count, PageType type = PageType::Leaf)
+  {
+    std::lock_guard lock(m_mutex);
+    const PageId first = allocateRun(count, type, true);
+    std::vector<StablePage<H>> pages;
+    for (PageId id = first; id < first + std::max(count, 1u); ++id)
+    {
+      pages.push_back(StablePage<H>(*this, *m_pool.find(id)));
+    }
+    return pages;
+  }
   template <typename H>
   Page<H> &nextFree(PageId *retPageId = nullptr)
   {
     PageId id = nextFree();
     Page<H> &newPage = getPage<H>(id);
-    newPage = Page<H>();
-    flushPage(id, newPage); // write the updated page header
+    newPage.reset(PageType::Leaf);
     if (retPageId != nullptr)
     {
       *retPageId = id;
@@ -177,12 +438,153 @@ public:
     return newPage;
   }
   void freePage(PageId pageNum);
-
-  explicit Pager(std::iostream &stream);
+  /* drop every page from `pageCount` on, shrinking the file. with a log this checkpoints first.
+   * false if the storage can't shrink, a page past the end is pinned, or the log could not be
+   * started over, in which case nothing changes */
+  bool truncate(PageId pageCount);
+
+  /* `pageSize` is only used when creating a new database, an existing one keeps the page size
+   * stored in its header */
+  explicit Pager(std::iostream &stream, std::size_t cacheSize = DEFAULT_CACHE_SIZE,
+                 u32 pageSize = DEFAULT_PAGE_SIZE);
+  explicit Pager(std::unique_ptr<Storage> storage, std::size_t cacheSize = DEFAULT_CACHE_SIZE,
+                 u32 pageSize = DEFAULT_PAGE_SIZE);
+  ~Pager();
+
+  Pager(const Pager &) = delete;
+  Pager &operator=(const Pager &) = delete;
 
 private:
-  std::iostream &m_stream;
+  template <typename H, Latch L> friend class PageGuard;
+  void flush(bool sync);
+  /* write back the next batch of committed pages from `cursor` on, in page order.
+   * returns false once there are no more */
+  bool checkpointStep(PageId &cursor, std::size_t batch);
+  /* write back what is left and start the log over if every logged page is in the file */
+  bool finishCheckpoint();
+  /* write the last logged image of each page that has changed again since, so the log is no longer
+   * needed for it */
+  void writeLogged();
+  void runCheckpointer();
+  /* bring the page up to date with its committed records, skipping those it already has */
+  void redoInto(PageBuffer &page, const std::vector<Lsn> &records);
+  /* the frame's page was just redone from `records` */
+  void redone(Frame &frame, const std::vector<Lsn> &records);
+  /* the page as it is on disk, or zeros if it never got there */
+  void readForRedo(PageId pageNum, PageBuffer &page);
+  void redoPages(const std::vector<PageId> &pages);
+  /* the frame's page is about to change */
+  void modified(Frame &frame);
+  /* the head trunk of the free list, or nullptr if the list is empty */
+  Page<FreelistPage::Header> *freelistHead();
+  /* reset a page being handed out, it never needs to be read */
+  Frame &allocate(PageId pageNum, PageType type);
+  /* take `count` adjacent pages, optionally pinning each as it is allocated. returns the first */
+  PageId allocateRun(u32 count, PageType type, bool pin);
+  /* make sure there is reserved space for the page at the logical end */
+  void reserveNext();
+  /* the page size of the database in the storage, or `pageSize` if it is empty. throws if the
+   * storage holds a database of another version */
+  static u32 storedPageSize(Storage &storage, u32 pageSize);
+  Frame &pin(PageId pageNum, bool dirty);
+  void unpin(Frame &frame) noexcept;
+  /* the view of the page in the storage's mapping, pinned, if it is mapped and not cached */
+  MappedView *pinMapped(PageId pageNum);
+  void unpin(MappedView &view) noexcept;
+  /* a guard is reading the page in place in the mapping */
+  bool readInPlace(PageId pageNum) const;
+
+  /* the page in place in the storage's mapping, if it is mapped and not cached */
+  const Page<> *findMapped(PageId pageNum);
+  MappedView *findView(PageId pageNum);
+  /* find the frame for the page, reading it in if needed */
+  Frame &fetch(PageId pageNum, bool read);
+  /* copy a finished prefetch of the page into the frame. false if there was none */
+  bool takePrefetch(PageId pageNum, Frame &frame, bool read);
+  /* queue a read of the page, the caller submits. false if it was not needed or there is no room */
+  bool prefetchOne(PageId pageNum);
+  void dropPrefetch(PageId pageNum);
+  /* drop the prefetches a scan is still waiting on and count them as wasted */
+  void abandon(ReadAhead &scan);
+  /* the page if it can be looked at without blocking on a read */
+  const Page<> *loaded(PageId pageNum);
+  /* check the checksum of a page read from the storage, throws if it does not match */
+  void verify(PageId pageNum, std::span<const std::byte> page);
+  void writePage(PageId pageNum, const Page<> &page);
+  /* write the frames back sorted by page id, each run of adjacent pages in a single write */
+  void writeBack(std::vector<Frame *> frames);
+
+  std::recursive_mutex m_mutex;
+  std::unique_ptr<Storage> m_storage;
+  u32 m_pageSize;
   // our cache for the pages
-  std::unordered_map<PageId, Page<>> m_pages;
-  u32 m_fSize;
+  BufferPool m_pool;
+  u64 m_fSize; // including pages that have not been written yet
+  // pages are appended into space reserved on disk in extents, past the logical end in `m_fSize`
+  u64 m_reserved = 0;
+  std::size_t m_extentSize = DEFAULT_EXTENT_SIZE;
+  PagerStats m_stats;
+  Verify m_verify = Verify::Once;
+  Sync m_sync = Sync::Full;
+  u64 m_changes = 0;
+  // pages that are known to match their checksum on disk, by id
+  std::vector<bool> m_knownGood;
+  std::unique_ptr<Wal> m_wal;
+  // pages not recovered yet, with the lsns of their committed records in order
+  std::unordered_map<PageId, std::vector<Lsn>> m_redo;
+  std::mutex m_redoMutex; // held while the redo threads are started or joined
+  std::vector<std::thread> m_redoThreads;
+
+  struct Checkpointer
+  {
+    CheckpointOptions options;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop = false;
+    bool wanted = false; // the log has outgrown `maxLogSize`
+    std::thread thread;
+  };
+  std::unique_ptr<Checkpointer> m_checkpointer;
+
+  struct Prefetch
+  {
+    AsyncIO::Ticket ticket;
+    std::unique_ptr<Page<>> page;
+  };
+  std::unordered_map<PageId, Prefetch> m_prefetching;
+  // views of pages read in place from a mapping, kept so guards can point at them
+  std::unordered_map<PageId, MappedView> m_mapped;
+
+  // for scans that don't keep their own
+  ReadAhead m_readAhead;
+  // declared last so it is destroyed first, while the buffers it writes into still exist
+  std::unique_ptr<AsyncIO> m_io;
 };
+
+template <typename H, Latch L> void PageGuard<H, L>::release() noexcept
+{
+  m_page = nullptr;
+  if (m_view != nullptr)
+  {
+    m_pager->unpin(*m_view);
+    m_pager = nullptr;
+    m_view = nullptr;
+    return;
+  }
+  if (m_frame == nullptr)
+  {
+    return;
+  }
+
+  if constexpr (L == Latch::Shared)
+  {
+    m_frame->latch.unlock_shared();
+  }
+  else if constexpr (L == Latch::Exclusive)
+  {
+    m_frame->latch.unlock();
+  }
+  m_pager->unpin(*m_frame);
+  m_pager = nullptr;
+  m_frame = nullptr;
+}
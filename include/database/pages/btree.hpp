@@ -10,6 +10,7 @@
 #include <functional>
 #include <optional>
 #include <type_traits>
+#include <vector>
 
 // we use the slot numbers in the table b tree for row ids
 // this is used in indexes to then find the row data
@@ -34,21 +35,83 @@ template <typename T> using LeafCell = NodeCell<T>;
 // not to be used independently
 // used for page types to support slots
 // data is the region of the page that is used to store slots and cells
-// it does not include the slot header itself or any other data, just slots and cells
-template <std::size_t bufsize> struct SlotHeader
+// it does not include the slot header itself or any other data, just slots and cells.
+// the region runs from the end of the header to the end of the page, so its size is set at runtime
+struct SlotHeader
 {
 private:
-  template <bool IsConst> struct iteratorbase;
+  template <bool IsConst> struct iteratorbase
+  {
+    using container_type = std::conditional_t<IsConst, const SlotHeader, SlotHeader>;
+    using value_type = std::conditional_t<IsConst, const Slot, Slot>;
+    using container_pointer = container_type *;
+    using difference_type = SlotNum;
+    using pointer = value_type *;
+    using reference = value_type &;
+
+    explicit iteratorbase(container_pointer slots) noexcept : m_slots(slots)
+    {
+      if (slots == nullptr || slots->isEmpty() || slots->isSlotOutOfBounds(0))
+      {
+        m_isEnd = true;
+        return;
+      }
+
+      m_current = slots->getSlot(0);
+    }
+    iteratorbase() : m_slots(nullptr), m_isEnd(true), m_current() {}
+    static iteratorbase end() { return iteratorbase(); }
+
+    reference operator*() noexcept { return *m_current; }
+    pointer operator->() noexcept { return m_current; }
+    iteratorbase &operator++() { return (*this) + 1; }
+    iteratorbase operator++(int)
+    {
+      iteratorbase tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+    iteratorbase &operator+(int n)
+    {
+      if (m_isEnd || m_slots == nullptr)
+        return *this;
+
+      m_currentNum += n;
+      if (m_currentNum >= (m_slots->freeStart / sizeof(Slot)))
+      {
+        m_isEnd = true;
+      }
+      else
+      {
+        m_current = m_slots->getSlot(m_currentNum);
+      }
+
+      return *this;
+    }
+    friend bool operator==(const iteratorbase &a, const iteratorbase &b)
+    {
+      if (a.m_isEnd && b.m_isEnd)
+        return true;
+      return a.m_isEnd == b.m_isEnd && a.m_slots == b.m_slots && a.m_current == b.m_current;
+    }
+    friend bool operator!=(const iteratorbase &a, const iteratorbase &b) { return !(a == b); }
+
+  private:
+    container_pointer m_slots = nullptr;
+    bool m_isEnd = false;
+    pointer m_current;
+    SlotNum m_currentNum = 0;
+  };
 
 public:
   struct iterator : public iteratorbase<false>
   {
-    explicit iterator(SlotHeader<bufsize> *p) : iteratorbase<false>(p) {}
+    explicit iterator(SlotHeader *p) : iteratorbase<false>(p) {}
     iterator() : iteratorbase<false>() {}
   };
   struct const_iterator : public iteratorbase<true>
   {
-    explicit const_iterator(const SlotHeader<bufsize> *p) : iteratorbase<true>(p) {}
+    explicit const_iterator(const SlotHeader *p) : iteratorbase<true>(p) {}
     const_iterator() : iteratorbase<true>() {}
   };
 
@@ -57,8 +120,12 @@ public:
   const_iterator begin() const { return const_iterator(this); }
   const_iterator end() const { return const_iterator(); }
 
-  u16 freeStart = 0;        // offset from end of header
-  u16 freeLength = bufsize; // marked as free if both 0
+  u16 freeStart = 0;  // offset from end of header
+  u16 freeLength = 0; // marked as free if both 0
+
+  SlotHeader() = default;
+  /* an empty region of `size` bytes following the header */
+  explicit SlotHeader(u16 size) : freeLength(size) {}
 
   bool isEmpty() const noexcept { return freeStart == 0; }
   bool isFree() const noexcept { return freeStart == 0 && freeLength == 0; }
@@ -72,11 +139,11 @@ public:
     {
       throw std::out_of_range("Slot number out of bounds");
     }
-    return reinterpret_cast<Slot *>(buf().data() + slotNumber * sizeof(Slot));
+    return reinterpret_cast<Slot *>(data() + slotNumber * sizeof(Slot));
   }
   const Slot *getSlot(SlotNum slotNumber) const
   {
-    return const_cast<const Slot *>(const_cast<SlotHeader<bufsize> *>(this)->getSlot(slotNumber));
+    return const_cast<const Slot *>(const_cast<SlotHeader *>(this)->getSlot(slotNumber));
   }
 
   // get a slot and its cell using its number
@@ -90,9 +157,9 @@ public:
     return getCell(s->cellOffset);
   }
 
-  inline std::byte *getCell(u16 offset) { return buf().data() + offset; }
-  inline const std::byte *getCell(u16 offset) const { return buf().data() + offset; }
-  inline const std::byte *readCell(u16 offset) const { return buf().data() + offset; }
+  inline std::byte *getCell(u16 offset) { return data() + offset; }
+  inline const std::byte *getCell(u16 offset) const { return data() + offset; }
+  inline const std::byte *readCell(u16 offset) const { return data() + offset; }
 
   // delete the slot from the slot array.
   void deleteSlot(SlotNum slotNum)
@@ -101,6 +168,21 @@ public:
     deleteSlot(&s);
   }
 
+  /* deleting a slot leaves its cell behind, so move the remaining cells together at the end of the
+   * region to make that space free again. `size` is the size the region was created with */
+  void compact(u16 size)
+  {
+    const std::vector<std::byte> before(data(), data() + size);
+    u16 end = size;
+    for (Slot &s : *this)
+    {
+      end -= s.cellSize;
+      std::memcpy(data() + end, before.data() + s.cellOffset, s.cellSize);
+      s.cellOffset = end;
+    }
+    freeLength = end - freeStart;
+  }
+
   // copy the cell into the slot buffer and create its slot in the sorted position
   // returns the slot that points to the cell in the slot buffer
   template <typename Cell>
@@ -163,7 +245,7 @@ public:
   Slot *createNextSlot(u16 cellSize, u16 *retSlotNum = nullptr)
   {
     assert(freeLength >= cellSize + sizeof(Slot) && "Not enough room in page for new cell&slot");
-    Slot *slot = reinterpret_cast<Slot *>(buf().data() + freeStart);
+    Slot *slot = reinterpret_cast<Slot *>(data() + freeStart);
 
     slot->cellSize = cellSize;
 
@@ -190,28 +272,17 @@ public:
   }
 
 private:
-  // TODO: LeafNodes store their reserved data at the end of the buffer, so the bufsize here is
-  // incorrect for them. The memory is valid, but points into the reserved data.
-  std::span<std::byte> buf() noexcept
-  {
-    return std::span<std::byte>(reinterpret_cast<std::byte *>(this + 1), bufsize);
-  }
-
-  std::span<const std::byte> buf() const noexcept
-  {
-    return std::span<const std::byte>(reinterpret_cast<const std::byte *>(this + 1), bufsize);
-  }
+  std::byte *data() noexcept { return reinterpret_cast<std::byte *>(this + 1); }
+  const std::byte *data() const noexcept { return reinterpret_cast<const std::byte *>(this + 1); }
 
   SlotNum slotNumber(const Slot *s)
   {
     // how many slots between the header end and s
-    assert(reinterpret_cast<intptr_t>(s) >= reinterpret_cast<intptr_t>(buf().data()) &&
-           reinterpret_cast<intptr_t>(s) <=
-               reinterpret_cast<intptr_t>(buf().data() + buf().size()) &&
+    assert(reinterpret_cast<intptr_t>(s) >= reinterpret_cast<intptr_t>(data()) &&
+           reinterpret_cast<intptr_t>(s) <= reinterpret_cast<intptr_t>(data() + freeStart) &&
            "Slot pointer out of bounds to retrieve slot number");
 
-    return (reinterpret_cast<intptr_t>(s) - reinterpret_cast<intptr_t>(buf().data())) /
-           sizeof(Slot);
+    return (reinterpret_cast<intptr_t>(s) - reinterpret_cast<intptr_t>(data())) / sizeof(Slot);
   }
 
   Slot *insertSlot(SlotNum slotNum)
@@ -241,69 +312,6 @@ private:
   }
 };
 
-template <std::size_t BS> template <bool IsConst> struct SlotHeader<BS>::iteratorbase
-{
-  using container_type = std::conditional_t<IsConst, const SlotHeader<BS>, SlotHeader<BS>>;
-  using value_type = std::conditional_t<IsConst, const Slot, Slot>;
-  using container_pointer = container_type *;
-  using difference_type = SlotNum;
-  using pointer = value_type *;
-  using reference = value_type &;
-
-  explicit iteratorbase(container_pointer slots) noexcept : m_slots(slots)
-  {
-    if (slots == nullptr || slots->isEmpty() || slots->isSlotOutOfBounds(0))
-    {
-      m_isEnd = true;
-      return;
-    }
-
-    m_current = slots->getSlot(0);
-  }
-  iteratorbase() : m_slots(nullptr), m_isEnd(true), m_current() {}
-  static iteratorbase end() { return iteratorbase(); }
-
-  reference operator*() noexcept { return *m_current; }
-  pointer operator->() noexcept { return m_current; }
-  iteratorbase &operator++() { return (*this) + 1; }
-  iteratorbase operator++(int)
-  {
-    iteratorbase tmp = *this;
-    ++(*this);
-    return tmp;
-  }
-  iteratorbase &operator+(int n)
-  {
-    if (m_isEnd || m_slots == nullptr)
-      return *this;
-
-    m_currentNum += n;
-    if (m_currentNum >= (m_slots->freeStart / sizeof(Slot)))
-    {
-      m_isEnd = true;
-    }
-    else
-    {
-      m_current = m_slots->getSlot(m_currentNum);
-    }
-
-    return *this;
-  }
-  friend bool operator==(const iteratorbase &a, const iteratorbase &b)
-  {
-    if (a.m_isEnd && b.m_isEnd)
-      return true;
-    return a.m_isEnd == b.m_isEnd && a.m_slots == b.m_slots && a.m_current == b.m_current;
-  }
-  friend bool operator!=(const iteratorbase &a, const iteratorbase &b) { return !(a == b); }
-
-private:
-  container_pointer m_slots = nullptr;
-  bool m_isEnd = false;
-  pointer m_current;
-  SlotNum m_currentNum = 0;
-};
-
 static constexpr std::size_t MAX_CELL_PAYLOAD = 32;
 
 union CellPayload
@@ -336,7 +344,7 @@ template <typename T> struct NodeCell
     std::memcpy(payload.small.data(), &data, payloadSize);
   }
 
-  template <std::size_t BS> NodeCell(const SlotHeader<BS> &sh, const Slot &s)
+  NodeCell(const SlotHeader &sh, const Slot &s)
   {
     // read the structure of the cell from the slot
     const std::byte *pCell = sh.readCell(s.cellOffset);
@@ -403,7 +411,7 @@ template <typename T> struct InteriorCell
 
   bool isEnd() const noexcept { return cell.payloadSize == 0; }
 
-  template <std::size_t BS> static InteriorCell fromSlot(const SlotHeader<BS> &sh, const Slot &s)
+  static InteriorCell fromSlot(const SlotHeader &sh, const Slot &s)
   {
     // read the structure of the cell from the slot
     const std::byte *pCell = sh.readCell(s.cellOffset);
@@ -425,7 +433,7 @@ template <typename T> struct InteriorCell
 
   static InteriorCell End() noexcept
   {
-    InteriorCell c(0);
+    InteriorCell c(T{});
     c.leftChild = 0;
     c.cell.payloadSize = 0;
     return c;
@@ -469,7 +477,18 @@ struct BTreeHeader
 {
   CommonHeader common;
   PageId parent = 0;
-  SlotHeader<PAGE_SIZE - sizeof(common) - sizeof(parent) - sizeof(SlotHeader<0>)> slots;
+  SlotHeader slots;
+
+  // kept free at the end of the page, leaves store their sibling links there
+  static constexpr u32 RESERVED_SIZE = 2 * sizeof(PageId);
+
+  /* the size of the slotted region between the header and the reserved bytes */
+  static constexpr u16 slotsSize(u32 pageSize) noexcept
+  {
+    return static_cast<u16>(pageSize - sizeof(BTreeHeader) - RESERVED_SIZE);
+  }
+  /* give the slots the rest of the page */
+  void fit(u32 pageSize) noexcept { slots = SlotHeader(slotsSize(pageSize)); }
 
   bool isRoot() const noexcept { return parent == 0; }
   bool isLeaf() const noexcept { return common.type == PageType::Leaf; }
@@ -506,55 +525,91 @@ static_assert(offsetof(BTreeHeader, slots) == (sizeof(BTreeHeader) - sizeof(BTre
  * page */
 static constexpr std::size_t MAX_CELL_SIZE =
     std::max(sizeof(NodeCell<std::any>), sizeof(InteriorCell<std::any>)) + MAX_CELL_PAYLOAD;
-static constexpr std::size_t BTREE_ORDER =
-    (PAGE_SIZE - sizeof(BTreeHeader)) / (MAX_CELL_SIZE + sizeof(Slot));
-static_assert(BTREE_ORDER > 0, "BTree order must be at least 1");
+/* how many of the largest cells fit in a node, which grows with the page size */
+constexpr std::size_t btreeOrder(u32 pageSize) noexcept
+{
+  return BTreeHeader::slotsSize(pageSize) / (MAX_CELL_SIZE + sizeof(Slot));
+}
+static_assert(btreeOrder(MIN_PAGE_SIZE) > 0, "BTree order must be at least 1");
 
 struct InteriorNode
 {
   Page<BTreeHeader> &page;
 
-  /* find the leaf node a cell value would be located in.
-   * following the leaf linked list is not needed to find the existence of the value */
-  template <typename V> Page<BTreeHeader> &searchGetLeaf(Pager &pager, const V &Q)
+  /* start reading every child of this node, for when most of them are about to be visited */
+  void prefetchChildren(Pager &pager)
   {
-    // find the node to follow down
-    // TODO: maybe a binary search here to find the node
-
-    Page<BTreeHeader> *currentPage = &this->page;
+    std::vector<PageId> children;
+    for (const Slot &s : page.header()->slots)
+    {
+      // the child pointer comes first in every interior cell, whatever the key type
+      children.push_back(*reinterpret_cast<const PageId *>(page.header()->slots.readCell(s.cellOffset)));
+    }
+    pager.prefetch(children);
+  }
 
-    while (!currentPage->header()->isLeaf())
+  /* the slot of the child to follow for Q, the first whose key is greater than it or else the end
+   * cell. the keys are sorted with the end cell last, so this is a binary search reading the cells
+   * in place */
+  template <typename V> static SlotNum childSlot(const SlotHeader &slots, const V &Q)
+  {
+    assert(slots.entryCount() > 0 && "Interior node must have an end cell");
+    SlotNum lo = 0;
+    SlotNum hi = slots.entryCount() - 1;
+    while (lo < hi)
     {
-      for (const Slot &s : currentPage->header()->slots)
+      const SlotNum mid = lo + (hi - lo) / 2;
+      const Slot &s = *slots.getSlot(mid);
+      assert(s.cellSize == sizeof(InteriorCell<V>) &&
+             "Interior search cell should be size of Interior");
+      const auto *interior = reinterpret_cast<const InteriorCell<V> *>(slots.readCell(s.cellOffset));
+      // TODO: overflow
+      assert((interior->isEnd() || interior->cell.payloadSize == sizeof(V)) &&
+             "Interior cell payload should be size of search type");
+      if (interior->isEnd() || Q < interior->cell.getPayload())
+      {
+        hi = mid;
+      }
+      else
       {
-        // get the interior cell for this slot
-        assert(s.cellSize == sizeof(InteriorCell<V>) &&
-               "Interior search cell should be size of Interior");
-        const InteriorCell interior = *reinterpret_cast<InteriorCell<V> *>(
-            currentPage->header()->slots.getCell(s.cellOffset));
-        assert(interior.leftChild != 0 &&
-               "Non leaf node cannot have leaf cell. Tree must be unbalanced");
-        if (interior.isEnd())
-        {
-          // end cell of this node, follow it down
-          currentPage = &pager.getPage<BTreeHeader>(interior.leftChild);
-          break;
-        }
-
-        // TODO: overflow
-        assert(interior.cell.payloadSize == sizeof(V) &&
-               "Interior cell payload should be size of search type");
-        // get the payload for the cell - the search value in this node
-        const V &value = interior.cell.getPayload();
-        if (Q < value)
-        {
-          // follow the slot to the next node
-          currentPage = &pager.getPage<BTreeHeader>(interior.leftChild);
-          break;
-        }
+        lo = mid + 1;
       }
     }
+    return lo;
+  }
+
+  /* the child to follow for Q */
+  template <typename V> static PageId childFor(const SlotHeader &slots, const V &Q)
+  {
+    const Slot &s = *slots.getSlot(childSlot(slots, Q));
+    const PageId child = *reinterpret_cast<const PageId *>(slots.readCell(s.cellOffset));
+    assert(child != 0 && "Non leaf node cannot have leaf cell. Tree must be unbalanced");
+    return child;
+  }
 
+  /* find the leaf node a cell value would be located in.
+   * following the leaf linked list is not needed to find the existence of the value.
+   * the pages are only read, so a lookup doesn't mark the path to the leaf dirty */
+  template <typename V> const Page<BTreeHeader> &searchGetLeaf(Pager &pager, const V &Q)
+  {
+    return leafBelow(pager, this->page, Q);
+  }
+  /* the same from the id of the root, so it doesn't have to be fetched for writing */
+  template <typename V>
+  static const Page<BTreeHeader> &searchGetLeaf(Pager &pager, PageId root, const V &Q)
+  {
+    return leafBelow(pager, pager.readPage<BTreeHeader>(root), Q);
+  }
+
+private:
+  template <typename V>
+  static const Page<BTreeHeader> &leafBelow(Pager &pager, const Page<BTreeHeader> &node, const V &Q)
+  {
+    const Page<BTreeHeader> *currentPage = &node;
+    while (!currentPage->header()->isLeaf())
+    {
+      currentPage = &pager.readPage<BTreeHeader>(childFor(currentPage->header()->slots, Q));
+    }
     return *currentPage;
   }
 };
@@ -565,8 +620,11 @@ struct LeafNode
 
   struct Reserved
   {
-    PageId sibling;
+    PageId prev;    // the leaf before this one, 0 for the first
+    PageId sibling; // the leaf after this one, 0 for the last
   };
+  static_assert(sizeof(Reserved) <= BTreeHeader::RESERVED_SIZE,
+                "Leaf data must fit in the space reserved at the end of the page");
 
   explicit LeafNode(Page<BTreeHeader> &existingPage) : page(existingPage) {};
 
@@ -584,30 +642,79 @@ struct LeafNode
     return r->sibling;
   }
 
+  /* read the sibling link of a leaf page, for the pager's read ahead */
+  static PageId siblingOf(const Page<> &leaf)
+  {
+    return reinterpret_cast<const Reserved *>(leaf.buf.data() + leaf.buf.size() - sizeof(Reserved))
+        ->sibling;
+  }
+
   void setSibling(PageId sibling)
   {
     Reserved *r = reserved();
     r->sibling = sibling;
   }
 
+  PageId getPrev() { return reserved()->prev; }
+  /* read the link to the leaf before, for scans that go backwards */
+  static PageId prevOf(const Page<> &leaf)
+  {
+    return reinterpret_cast<const Reserved *>(leaf.buf.data() + leaf.buf.size() - sizeof(Reserved))
+        ->prev;
+  }
+  void setPrev(PageId prev) { reserved()->prev = prev; }
+
+  /* the first slot whose key is not less than `key`, or the number of slots. the slots are kept
+   * sorted, so this is also where `key` would be inserted. `less` compares a stored key with `key`
+   * either way round, so a lookup can be by part of the key, like a prefix */
+  template <typename T, typename K = T, typename Less = std::less<>>
+  static SlotNum lowerBound(const SlotHeader &slots, const K &key, Less less = {})
+  {
+    return partition<T>(slots, [&](const T &stored) { return less(stored, key); });
+  }
+  /* the first slot whose key is greater than `key`, or the number of slots */
+  template <typename T, typename K = T, typename Less = std::less<>>
+  static SlotNum upperBound(const SlotHeader &slots, const K &key, Less less = {})
+  {
+    return partition<T>(slots, [&](const T &stored) { return !less(key, stored); });
+  }
+  /* the slots with keys equal to `key`, from the first up to but not including the last */
+  template <typename T, typename K = T, typename Less = std::less<>>
+  static std::pair<SlotNum, SlotNum> equalRange(const SlotHeader &slots, const K &key,
+                                                Less less = {})
+  {
+    return {lowerBound<T>(slots, key, less), upperBound<T>(slots, key, less)};
+  }
+
+  /* the key in a slot of a leaf */
+  template <typename T> static T payloadAt(const SlotHeader &slots, SlotNum slot)
+  {
+    // TODO: overflow
+    return reinterpret_cast<const LeafCell<T> *>(slots.readCell(slots.getSlot(slot)->cellOffset))
+        ->getPayload();
+  }
+
+  /* the slot holding `key` and true, or the slot it would be inserted at and false */
+  template <typename T, typename K = T, typename Less = std::less<>>
+  std::pair<SlotNum, bool> find(const K &key, Less less = {}) const
+  {
+    const SlotHeader &slots = page.header()->slots;
+    const SlotNum slot = lowerBound<T>(slots, key, less);
+    return {slot, slot < slots.entryCount() && !less(key, payloadAt<T>(slots, slot))};
+  }
+
   /* find the slot for Q and return the slot and cell */
   template <typename T>
   std::optional<std::pair<Slot *, LeafCell<T> *>> searchGetSlot(const LeafCell<T> &Q)
   {
-    // TODO: binary search?
-    for (Slot &s : page.header()->slots)
+    // TODO: overflow
+    const auto [slotNum, found] = find<T>(Q.getPayload());
+    if (!found)
     {
-      // TODO: overflow
-      LeafCell<T> *c = reinterpret_cast<LeafCell<T> *>(page.header()->slots.getCell(s.cellOffset));
-      // TODO: ordering
-      if (Q.payload.small == c->payload.small)
-      {
-        // TODO: overflow
-        return std::pair(&s, c);
-      }
+      return std::nullopt;
     }
-
-    return std::nullopt;
+    Slot *s = page.header()->slots.getSlot(slotNum);
+    return std::pair(s, reinterpret_cast<LeafCell<T> *>(page.header()->slots.getCell(s->cellOffset)));
   }
 
 private:
@@ -615,6 +722,27 @@ private:
   {
     return reinterpret_cast<Reserved *>(page.buf.data() + page.buf.size() - sizeof(Reserved));
   }
+
+  /* the first slot for which `before` is false, given it is true for every slot up to there */
+  template <typename T, typename Pred>
+  static SlotNum partition(const SlotHeader &slots, const Pred &before)
+  {
+    SlotNum lo = 0;
+    SlotNum hi = slots.entryCount();
+    while (lo < hi)
+    {
+      const SlotNum mid = lo + (hi - lo) / 2;
+      if (before(payloadAt<T>(slots, mid)))
+      {
+        lo = mid + 1;
+      }
+      else
+      {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
 };
 
 template <typename T> void printTree(std::stringstream &stream, Pager &pager, const Page<BTreeHeader> &root, u32 depth = 0)
@@ -635,7 +763,7 @@ template <typename T> void printTree(std::stringstream &stream, Pager &pager, co
       {
         stream << cell->cell.getPayload() << ' ';
       }
-      Page<BTreeHeader> &child = pager.getPage<BTreeHeader>(cell->leftChild);
+      const Page<BTreeHeader> &child = pager.readPage<BTreeHeader>(cell->leftChild);
       printTree<T>(stream, pager, child, depth + 1);
     }
     stream << ')';
@@ -673,32 +801,37 @@ void insertByMedianKey(const T &value, const K &medianKey, Page<BTreeHeader> &lo
 }
 
 template <typename K>
-void interiorInsert(Pager &pager, PageId nodeId, Page<BTreeHeader> &node,
-                    const InteriorCell<K> &cell)
+void interiorInsert(Pager &pager, ExclusivePage<BTreeHeader> &node, const InteriorCell<K> &cell)
 {
   assert(node.header()->common.type == PageType::Interior &&
          "Interior insert can only be used on interior nodes");
 
-  if (node.header()->slots.entryCount() < BTREE_ORDER)
+  if (node.header()->slots.entryCount() < btreeOrder(pager.pageSize()))
   {
     node.header()->slots.insertCell(cell);
     return;
   }
 
   // interior nodes move their middle value up when splitting
-  splitAndInsert<K>(pager, nodeId, node, cell, true);
+  auto [lower, separator] = splitAndInsert<K>(pager, node, cell, true);
+  // the child goes with its cell
+  pager.getPage<BTreeHeader>(cell.leftChild).header()->parent =
+      cell < separator.cell.getPayload() ? lower.id() : node.id();
 }
 
+/* split the node and insert the value into one of the halves, then insert the key for the new
+ * node into the parent. every page involved stays pinned until it is no longer needed */
 template <typename K, typename V>
-std::pair<Page<BTreeHeader> &, InteriorCell<K>>
-splitAndInsert(Pager &pager, PageId nodeToSplitId, Page<BTreeHeader> &nodeToSplit,
-               const V &valueToInsert, bool keyShouldReplaceValue)
+std::pair<ExclusivePage<BTreeHeader>, InteriorCell<K>>
+splitAndInsert(Pager &pager, ExclusivePage<BTreeHeader> &nodeToSplit, const V &valueToInsert,
+               bool keyShouldReplaceValue)
 {
   PageId newNodePageId = 0;
-  auto &newNode = nodeToSplit.header()->split(pager, &newNodePageId);
-  assert(newNode.header()->slots.entryCount() < BTREE_ORDER &&
+  UNUSED(nodeToSplit.header()->split(pager, &newNodePageId));
+  ExclusivePage<BTreeHeader> newNode = pager.pinExclusive<BTreeHeader>(newNodePageId);
+  assert(newNode.header()->slots.entryCount() < btreeOrder(pager.pageSize()) &&
          "New node from splits hould have empty slots");
-  assert(nodeToSplit.header()->slots.entryCount() < BTREE_ORDER &&
+  assert(nodeToSplit.header()->slots.entryCount() < btreeOrder(pager.pageSize()) &&
          "Original node after split should have empty slots");
   assert(nodeToSplit.header()->common.type == newNode.header()->common.type &&
          "Original and new node must have same type");
@@ -706,7 +839,7 @@ splitAndInsert(Pager &pager, PageId nodeToSplitId, Page<BTreeHeader> &nodeToSpli
   // create a key for the new node using the median key
   // HACK: we assume the key is always the first attribute in the payload
   // TODO: optimise getting payload for LeafNode
-  const K medianKey = nodeToSplit.header()->getLowestPayload<K>();
+  const K medianKey = nodeToSplit.header()->template getLowestPayload<K>();
   auto keyForNewNode = InteriorCell(medianKey);
   keyForNewNode.leftChild = newNodePageId;
 
@@ -721,47 +854,206 @@ splitAndInsert(Pager &pager, PageId nodeToSplitId, Page<BTreeHeader> &nodeToSpli
     }
     nodeToSplit.header()->slots.deleteSlot(static_cast<SlotNum>(0));
     newNode.header()->slots.insertCell(endCell);
+
+    // the children that moved have a new parent. `split` leaves them alone as a copy on write tree
+    // splits nodes whose children are still shared with older versions
+    const SlotHeader &moved = newNode.header()->slots;
+    for (const Slot &s : moved)
+    {
+      const PageId child = *reinterpret_cast<const PageId *>(moved.readCell(s.cellOffset));
+      pager.getPage<BTreeHeader>(child).header()->parent = newNodePageId;
+    }
   }
 
-  insertByMedianKey(valueToInsert, medianKey, newNode, nodeToSplit);
+  insertByMedianKey(valueToInsert, medianKey, *newNode, *nodeToSplit);
 
-  Page<BTreeHeader> *parent = nullptr;
+  ExclusivePage<BTreeHeader> parent;
   if (!nodeToSplit.header()->isRoot())
   {
-    parent = &pager.getPage<BTreeHeader>(nodeToSplit.header()->parent);
+    parent = pager.pinExclusive<BTreeHeader>(nodeToSplit.header()->parent);
   }
   else
   {
     // create a parent
-    PageId parentId{};
-    parent = &pager.fromNextFree<BTreeHeader>(PageType::Interior, &parentId);
-    nodeToSplit.header()->parent = newNode.header()->parent = parentId;
+    parent = pager.pinNextFree<BTreeHeader>(PageType::Interior);
+    nodeToSplit.header()->parent = newNode.header()->parent = parent.id();
     // link the end node to the original node
     InteriorCell<K> endCell = InteriorCell<K>::End();
-    endCell.leftChild = nodeToSplitId;
-    parent->header()->slots.insertCell(endCell);
+    endCell.leftChild = nodeToSplit.id();
+    parent.header()->slots.insertCell(endCell);
     // we don't need to touch the types of `node` or `newNode`. If the root
     // was a leaf, it still is. If it was internal, it still is.
   }
 
   assert(!nodeToSplit.header()->isRoot() && "Node cannot be root after splitting");
-  interiorInsert<K>(pager, nodeToSplit.header()->parent, *parent, keyForNewNode);
-  return std::make_pair(std::ref(newNode), keyForNewNode);
+  interiorInsert<K>(pager, parent, keyForNewNode);
+  return std::make_pair(std::move(newNode), keyForNewNode);
 }
 
 template <typename K, typename V>
-void leafInsert(Pager &pager, PageId nodeId, Page<BTreeHeader> &node, const V &value)
+void leafInsert(Pager &pager, ExclusivePage<BTreeHeader> &node, const V &value)
 {
-  if (node.header()->slots.entryCount() < BTREE_ORDER)
+  if (node.header()->slots.entryCount() < btreeOrder(pager.pageSize()))
   {
     node.header()->slots.insertCell(LeafCell<V>(value));
     return;
   }
 
   // leaf nodes must maintain the linked list between them
-  auto [newNode, keyForNewNode] = splitAndInsert<K>(pager, nodeId, node, LeafCell<V>(value), false);
-  LeafNode newLeaf{newNode};
-  // TODO: set sibling double linked list
-  // the left sibling of node still points to node, it should point to the new node
-  newLeaf.setSibling(nodeId);
+  auto [newNode, keyForNewNode] = splitAndInsert<K>(pager, node, LeafCell<V>(value), false);
+  UNUSED(keyForNewNode);
+  // the new node has the lower half, so it goes between the node and the leaf before it
+  LeafNode newLeaf{*newNode};
+  LeafNode leaf{*node};
+  const PageId prev = leaf.getPrev();
+  newLeaf.setPrev(prev);
+  newLeaf.setSibling(node.id());
+  leaf.setPrev(newNode.id());
+  if (prev != 0)
+  {
+    ExclusivePage<BTreeHeader> before = pager.pinExclusive<BTreeHeader>(prev);
+    LeafNode(*before).setSibling(newNode.id());
+  }
+}
+
+template <typename K, typename V>
+void leafInsert(Pager &pager, PageId nodeId, Page<BTreeHeader> &node, const V &value)
+{
+  ExclusivePage<BTreeHeader> guard = pager.pinExclusive<BTreeHeader>(nodeId);
+  assert(&guard.page() == &node && "Node must be the cached page for its id");
+  UNUSED(node);
+  leafInsert<K>(pager, guard, value);
+}
+
+/* the leaf of the tree at `root` that `key` goes in. `upper` is set to the separator every key in
+ * the leaf is less than, or left empty if the leaf is the last one */
+template <typename K>
+PageId leafFor(Pager &pager, PageId root, const K &key, std::optional<K> &upper)
+{
+  upper.reset();
+  PageId id = root;
+  while (true)
+  {
+    const SlotHeader &slots = pager.readPage<BTreeHeader>(id).header()->slots;
+    if (pager.readPage<BTreeHeader>(id).header()->isLeaf())
+    {
+      return id;
+    }
+    const Slot &s = *slots.getSlot(InteriorNode::childSlot(slots, key));
+    const auto *cell = reinterpret_cast<const InteriorCell<K> *>(slots.readCell(s.cellOffset));
+    // the separators get tighter going down
+    if (!cell->isEnd())
+    {
+      upper = cell->cell.getPayload();
+    }
+    id = cell->leftChild;
+  }
+}
+
+/* put `keys`, which are sorted and all belong in `node`, into it. if they don't fit the leaf is
+ * split once into as many evenly filled leaves as it takes, instead of in half for every key that
+ * doesn't fit. the new leaves take the lower keys and go before `node`. their separators still go
+ * into the parent one at a time, so a full parent splits in half as it would for single inserts */
+template <typename K>
+void leafInsertSorted(Pager &pager, ExclusivePage<BTreeHeader> &node, std::span<const K> keys)
+{
+  const std::size_t order = btreeOrder(pager.pageSize());
+  const SlotNum count = node.header()->slots.entryCount();
+  if (count + keys.size() <= order)
+  {
+    for (const K &key : keys)
+    {
+      node.header()->slots.insertCell(LeafCell<K>(key));
+    }
+    return;
+  }
+
+  std::vector<K> all;
+  all.reserve(count + keys.size());
+  for (SlotNum slot{0}; slot < count; ++slot)
+  {
+    all.push_back(LeafNode::payloadAt<K>(node.header()->slots, slot));
+  }
+  // the keys already there come before equal new ones, as they would with one insert at a time
+  const auto middle = all.insert(all.end(), keys.begin(), keys.end());
+  std::inplace_merge(all.begin(), middle, all.end());
+
+  const std::size_t pieces = (all.size() + order - 1) / order;
+  const auto fill = [&all](ExclusivePage<BTreeHeader> &leaf, std::size_t from, std::size_t to)
+  {
+    for (std::size_t i = from; i < to; ++i)
+    {
+      const LeafCell<K> cell(all[i]);
+      std::memcpy(leaf.header()->slots.createNextSlotWithCell(sizeof(cell), nullptr), &cell,
+                  sizeof(cell));
+    }
+  };
+  const auto pieceStart = [&all, pieces](std::size_t piece)
+  {
+    return piece * (all.size() / pieces) + std::min(piece, all.size() % pieces);
+  };
+
+  if (node.header()->isRoot())
+  {
+    ExclusivePage<BTreeHeader> root = pager.pinNextFree<BTreeHeader>(PageType::Interior);
+    InteriorCell<K> endCell = InteriorCell<K>::End();
+    endCell.leftChild = node.id();
+    root.header()->slots.insertCell(endCell);
+    node.header()->parent = root.id();
+  }
+
+  // the node keeps the top piece, so its sibling and the separator above it stay the same
+  PageId before = LeafNode(*node).getPrev();
+  for (std::size_t piece{0}; piece + 1 < pieces; ++piece)
+  {
+    ExclusivePage<BTreeHeader> leaf = pager.pinNextFree<BTreeHeader>(PageType::Leaf);
+    fill(leaf, pieceStart(piece), pieceStart(piece + 1));
+    LeafNode(*leaf).setPrev(before);
+    LeafNode(*leaf).setSibling(node.id());
+    if (before != 0)
+    {
+      ExclusivePage<BTreeHeader> previous = pager.pinExclusive<BTreeHeader>(before);
+      LeafNode(*previous).setSibling(leaf.id());
+    }
+    before = leaf.id();
+
+    // the node's parent can change as the keys for the new leaves split it
+    leaf.header()->parent = node.header()->parent;
+    InteriorCell<K> key(all[pieceStart(piece + 1)]);
+    key.leftChild = leaf.id();
+    ExclusivePage<BTreeHeader> parent = pager.pinExclusive<BTreeHeader>(node.header()->parent);
+    interiorInsert<K>(pager, parent, key);
+  }
+  LeafNode(*node).setPrev(before);
+
+  node.header()->fit(pager.pageSize());
+  fill(node, pieceStart(pieces - 1), all.size());
+}
+
+/* insert every key in `keys` into the tree at `root`, returning the root afterwards. the keys are
+ * sorted first so those that go in the same leaf are next to each other, then each leaf is found
+ * with one descent and takes all of its keys at once. only the leaves are batched, the interior
+ * levels above them are updated one separator at a time */
+template <typename K> PageId insertBatch(Pager &pager, PageId root, std::vector<K> keys)
+{
+  std::sort(keys.begin(), keys.end());
+  std::optional<K> upper;
+  for (auto first = keys.begin(); first != keys.end();)
+  {
+    while (!pager.readPage<BTreeHeader>(root).header()->isRoot())
+    {
+      root = pager.readPage<BTreeHeader>(root).header()->parent;
+    }
+    ExclusivePage<BTreeHeader> leaf =
+        pager.pinExclusive<BTreeHeader>(leafFor(pager, root, *first, upper));
+    // a key equal to the separator goes in the leaf after it
+    const auto last = upper.has_value() ? std::lower_bound(first, keys.end(), *upper) : keys.end();
+    leafInsertSorted<K>(pager, leaf, std::span<const K>(first, last));
+    first = last;
+  }
+  while (!pager.readPage<BTreeHeader>(root).header()->isRoot())
+  {
+    root = pager.readPage<BTreeHeader>(root).header()->parent;
+  }
+  return root;
 }
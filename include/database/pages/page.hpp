@@ -0,0 +1,126 @@
+#pragma once
+
+#include "page_header.hpp"
+
+#include <cstddef>
+#include <span>
+
+/* The bytes of one page, sized at runtime to the page size of its database.
+ * A buffer either owns its memory or is a view of a page owned elsewhere, e.g. one mapped in place.
+ * Copying always copies the bytes, a view is never resized */
+class PageBuffer
+{
+public:
+  // owned buffers are aligned to their size, up to this, so they can be given straight to the OS
+  static constexpr u32 MAX_ALIGNMENT = 4096;
+
+  explicit PageBuffer(u32 size = DEFAULT_PAGE_SIZE);
+  static PageBuffer view(std::byte *data, u32 size) noexcept;
+  ~PageBuffer();
+
+  PageBuffer(const PageBuffer &other);
+  PageBuffer &operator=(const PageBuffer &other);
+  PageBuffer(PageBuffer &&other) noexcept;
+  PageBuffer &operator=(PageBuffer &&other);
+
+  std::byte *data() noexcept { return m_data; }
+  const std::byte *data() const noexcept { return m_data; }
+  u32 size() const noexcept { return m_size; }
+  std::byte *begin() noexcept { return m_data; }
+  std::byte *end() noexcept { return m_data + m_size; }
+  const std::byte *begin() const noexcept { return m_data; }
+  const std::byte *end() const noexcept { return m_data + m_size; }
+
+  std::byte &operator[](std::size_t i) noexcept { return m_data[i]; }
+  const std::byte &operator[](std::size_t i) const noexcept { return m_data[i]; }
+
+  operator std::span<std::byte>() noexcept { return {m_data, m_size}; }
+  operator std::span<const std::byte>() const noexcept { return {m_data, m_size}; }
+
+  void fill(std::byte value) noexcept;
+
+  friend bool operator==(const PageBuffer &a, const PageBuffer &b) noexcept;
+
+private:
+  PageBuffer(std::byte *data, u32 size, bool owned) noexcept
+      : m_data(data), m_size(size), m_owned(owned)
+  {
+  }
+  void free() noexcept;
+
+  std::byte *m_data;
+  u32 m_size;
+  bool m_owned;
+};
+
+/* the CRC32C of a page leaving out its stored checksum. never 0, so a page that was never written
+ * does not pass */
+u32 pageChecksum(std::span<const std::byte> page) noexcept;
+/* store the checksum in the page's common header, just before it is written */
+void sealPage(std::span<std::byte> page) noexcept;
+/* does the stored checksum match */
+bool verifyPage(std::span<const std::byte> page) noexcept;
+
+// template the header so that we can retrieve it easily
+template <typename Header = CommonHeader> struct Page
+{
+  PageBuffer buf;
+
+  Page() : Page(Leaf) {}
+
+  explicit Page(PageType type, u32 size = DEFAULT_PAGE_SIZE) : buf(size) { reset(type); }
+
+  /* a page over a buffer that already holds its contents */
+  explicit Page(PageBuffer buffer) : buf(std::move(buffer)) {}
+
+  /* clear the page and set up a fresh header */
+  void reset(PageType type)
+  {
+    buf.fill(static_cast<std::byte>(0));
+
+    // TODO: endianness
+
+    // setup the custom header
+
+    Header *h = header();
+    *h = Header();
+    // headers laid out relative to the end of the page, like slotted pages, size themselves to it
+    if constexpr (requires { h->fit(buf.size()); })
+    {
+      h->fit(buf.size());
+    }
+
+    // setup the common header
+    setType(type);
+  }
+
+  inline void setType(PageType type)
+  {
+    CommonHeader *ch = reinterpret_cast<CommonHeader *>(header());
+    ch->type = type;
+  }
+
+  // cast the current header to a different header type
+  // this is intended to be used when reading the page from disk and relying on the `type` value
+  /* return a pointer to the page, casted to a certain page header type */
+  template <typename H> // pointer to a page header type
+  constexpr Page<H> *as()
+  {
+    return reinterpret_cast<Page<H> *>(this);
+  }
+
+  // when header type is non pointer return a reference to the page instead
+  template <typename H> Page<H> &as_ref()
+  {
+    // return *std::launder(reinterpret_cast<Page<H>*>(this));
+    return reinterpret_cast<Page<H> &>(*this);
+  }
+
+  template <typename H> const Page<H> &as_const() const
+  {
+    return reinterpret_cast<const Page<H> &>(*this);
+  }
+
+  Header *header() noexcept { return reinterpret_cast<Header *>(buf.data()); }
+  const Header *header() const noexcept { return reinterpret_cast<const Header *>(buf.data()); }
+};
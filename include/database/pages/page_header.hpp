@@ -2,14 +2,33 @@
 
 #include "machine.hpp"
 
+#include <cstddef>
+
 using PageId = u32;
-const u32 PAGE_SIZE = 512;
+// a position in the write-ahead log, which only ever grows
+using Lsn = u64;
+
+// the page size is chosen when the database is created, a power of two within these bounds
+const u32 MIN_PAGE_SIZE = 512;
+const u32 MAX_PAGE_SIZE = 64 * 1024;
+const u32 DEFAULT_PAGE_SIZE = 4096;
+
+constexpr bool isValidPageSize(u32 size) noexcept
+{
+  return size >= MIN_PAGE_SIZE && size <= MAX_PAGE_SIZE && (size & (size - 1)) == 0;
+}
+
+// bumped whenever the layout of a page changes, files of any other version are refused.
+// 2: every page has a checksum and the lsn of its last change in its common header, the page
+//    size is stored
+const u16 DATABASE_VERSION = 2;
 
 // the header for the database file, stored in the first page
 struct DatabaseHeader
 {
-  u16 version = 1;
+  u16 version = DATABASE_VERSION;
   PageId freelist = 0; // when 0 no free pages, must be appended to file
+  u32 pageSize = 0;
 };
 
 enum PageType
@@ -25,4 +44,12 @@ enum PageType
 struct CommonHeader
 {
   PageType type;
+  // CRC32C of the page as last written, 0 if it was never written
+  u32 checksum = 0;
+  // the log record this version of the page came from, so recovery can skip records it already has
+  Lsn lsn = 0;
 };
+
+// the common header is at the same place in every page, changing it needs a new DATABASE_VERSION
+static_assert(offsetof(CommonHeader, checksum) == 4 && offsetof(CommonHeader, lsn) == 8 &&
+              sizeof(CommonHeader) == 16);
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "common.hpp"
+#include "machine.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <span>
+
+/* Where the pager keeps its pages. Offsets are in bytes from the start of the file.
+ * Reads and writes return false on failure, the caller knows which page it was for.
+ * Backends must be safe to call from the asynchronous I/O threads */
+class Storage
+{
+public:
+  // hints for how a range of the file is about to be used
+  enum class Access
+  {
+    Normal,
+    Sequential, // walking the leaf chain
+    Random,     // descending through interior nodes
+    WillNeed,   // start reading the range in now
+  };
+
+  virtual ~Storage() = default;
+
+  virtual u64 size() = 0;
+  [[nodiscard]] virtual bool read(u64 offset, std::span<std::byte> buf) = 0;
+  [[nodiscard]] virtual bool write(u64 offset, std::span<const std::byte> buf) = 0;
+  /* write the buffers one after the other starting at `offset`, in as few calls as the backend
+   * can. by default each buffer is a separate write */
+  [[nodiscard]] virtual bool writev(u64 offset, std::span<const std::span<const std::byte>> bufs)
+  {
+    for (const auto &buf : bufs)
+    {
+      if (!write(offset, buf))
+      {
+        return false;
+      }
+      offset += buf.size();
+    }
+    return true;
+  }
+  /* make everything written so far durable */
+  virtual bool sync() = 0;
+  /* cut the file down to `size` bytes. false if the backend can't shrink */
+  virtual bool truncate(u64 size)
+  {
+    UNUSED(size);
+    return false;
+  }
+  /* allocate disk space for a range ahead of writing it, without changing the size of the file.
+   * only a hint, false if the backend or file system can't */
+  virtual bool reserve(u64 offset, u64 length)
+  {
+    UNUSED(offset);
+    UNUSED(length);
+    return false;
+  }
+
+  /* backends that map the file return the bytes in place, so a read does not need a copy.
+   * the pointer stays valid for the lifetime of the storage. nullptr if the range can't be mapped */
+  virtual const std::byte *map(u64 offset, std::size_t length)
+  {
+    UNUSED(offset);
+    UNUSED(length);
+    return nullptr;
+  }
+  virtual void advise(u64 offset, std::size_t length, Access access)
+  {
+    UNUSED(offset);
+    UNUSED(length);
+    UNUSED(access);
+  }
+
+  /* the file descriptor for backends that are a plain file, so they can be used with io_uring */
+  virtual int fd() { return -1; }
+  /* what offsets, lengths and buffers of I/O made straight to `fd` must be a multiple of */
+  virtual u32 alignment() { return 1; }
+  /* a write was made straight to `fd`, bypassing `write` */
+  virtual void didWrite(u64 offset, std::size_t length)
+  {
+    UNUSED(offset);
+    UNUSED(length);
+  }
+};
+
+/* reads and writes through a stream, e.g. an fstream or an in memory stringstream */
+class StreamStorage : public Storage
+{
+public:
+  explicit StreamStorage(std::iostream &stream);
+
+  u64 size() override
+  {
+    std::lock_guard lock(m_mutex);
+    return m_size;
+  }
+  bool read(u64 offset, std::span<std::byte> buf) override;
+  bool write(u64 offset, std::span<const std::byte> buf) override;
+  bool sync() override;
+
+private:
+  // seeking and reading have to happen together
+  std::mutex m_mutex;
+  std::iostream &m_stream;
+  u64 m_size;
+};
+
+#ifndef _WIN32
+/* Reads and writes a file with positional I/O, so any number of threads can do I/O at once with no
+ * shared file position. With `direct` the file is opened with O_DIRECT and the OS page cache is
+ * bypassed, leaving the pager's buffer pool as the only cache. Direct I/O has to be aligned to the
+ * file system's block size, so the database's page size must be a multiple of `alignment`. Other
+ * I/O, like reading the header before the page size is known, goes through an aligned copy */
+class FileStorage : public Storage
+{
+public:
+  explicit FileStorage(const std::filesystem::path &path, bool direct = false);
+  ~FileStorage() override;
+
+  FileStorage(const FileStorage &) = delete;
+  FileStorage &operator=(const FileStorage &) = delete;
+
+  u64 size() override { return m_size; }
+  bool read(u64 offset, std::span<std::byte> buf) override;
+  bool write(u64 offset, std::span<const std::byte> buf) override;
+  bool writev(u64 offset, std::span<const std::span<const std::byte>> bufs) override;
+  bool sync() override;
+  bool truncate(u64 size) override;
+  bool reserve(u64 offset, u64 length) override;
+  void advise(u64 offset, std::size_t length, Access access) override;
+  int fd() override { return m_fd; }
+  u32 alignment() override { return m_alignment; }
+  void didWrite(u64 offset, std::size_t length) override;
+
+  bool direct() const noexcept { return m_direct; }
+
+private:
+  bool aligned(u64 offset, const std::byte *buf, std::size_t length) const noexcept;
+  /* do I/O that is not aligned for O_DIRECT through an aligned copy of the blocks it covers */
+  bool readUnaligned(u64 offset, std::span<std::byte> buf);
+  bool writeUnaligned(u64 offset, std::span<const std::byte> buf);
+  void grow(u64 end);
+
+  int m_fd = -1;
+  bool m_direct;
+  u32 m_alignment = 1;
+  // writes of part of a block read and write back the whole block, so they can't overlap
+  std::mutex m_unalignedMutex;
+  std::atomic<u64> m_size = 0;
+};
+
+/* Maps the whole file into memory so that reads come straight from the OS page cache.
+ * The mapping reserves `mapSize` bytes of address space up front and the file grows within it, so
+ * pointers returned by `map` are never moved. Writes copy into the mapping and become durable on
+ * `sync` */
+class MmapStorage : public Storage
+{
+public:
+  static constexpr u64 DEFAULT_MAP_SIZE = u64{1} << 30;
+
+  explicit MmapStorage(const std::filesystem::path &path, u64 mapSize = DEFAULT_MAP_SIZE);
+  ~MmapStorage() override;
+
+  MmapStorage(const MmapStorage &) = delete;
+  MmapStorage &operator=(const MmapStorage &) = delete;
+
+  u64 size() override { return m_size; }
+  bool read(u64 offset, std::span<std::byte> buf) override;
+  bool write(u64 offset, std::span<const std::byte> buf) override;
+  bool sync() override;
+  bool truncate(u64 size) override;
+  bool reserve(u64 offset, u64 length) override;
+  const std::byte *map(u64 offset, std::size_t length) override;
+  void advise(u64 offset, std::size_t length, Access access) override;
+  int fd() override { return m_fd; }
+  void didWrite(u64 offset, std::size_t length) override;
+
+private:
+  void grow(u64 end);
+
+  int m_fd = -1;
+  std::byte *m_map = nullptr;
+  u64 m_mapSize;
+  // only guards growing the file, reads go through the mapping
+  std::mutex m_growMutex;
+  std::atomic<u64> m_size = 0;
+};
+#endif
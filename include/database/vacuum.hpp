@@ -0,0 +1,89 @@
+#pragma once
+
+#include "pager.hpp"
+#include "pages/btree.hpp"
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// counters for what a vacuum has done
+struct VacuumStats
+{
+  u64 moves = 0;   // pages swapped into place
+  u64 plans = 0;   // times the tree was walked, again whenever it changed between steps
+  u64 dropped = 0; // pages cut off the end of the file
+};
+
+/* Compacts a database holding a B-tree, online and a few pages at a time.
+ *
+ * The tree's pages are moved to the start of the file, interior nodes first and then the leaves in
+ * key order, so that a scan along the leaves reads the file front to back. Each move swaps a page
+ * with the one in its place and rewrites every pointer to either of them: the parent's cell, the
+ * children's parent, the leaves either side of it in the sibling chain and the free list. Once the
+ * tree is in place the free list is rebuilt from the free pages left below the tree's end and the
+ * file is truncated after it.
+ *
+ * Pages that are neither in the tree nor free are left where they are. The tree is consistent
+ * between steps, so a vacuum can be stopped at any point and the database used in between, though
+ * not during a step. If the pager saw any changes since the last step the tree is walked again
+ * before carrying on. With a log, each move is committed on its own so the pages it changed can
+ * leave the cache, and the vacuum commits again before truncating */
+class Vacuum
+{
+public:
+  Vacuum(Pager &pager, PageId root);
+
+  /* move up to `maxMoves` pages into place. returns true once the vacuum is finished */
+  bool step(u32 maxMoves = 64);
+  bool done() const noexcept { return m_done; }
+  /* where the root is now */
+  PageId root() const noexcept;
+  const VacuumStats &stats() const noexcept { return m_stats; }
+
+private:
+  enum class Role
+  {
+    Interior,
+    Leaf,
+    Trunk, // of the free list
+    Free,  // listed in a trunk
+  };
+
+  // a page we know how to move, wherever it is at the moment
+  struct Node
+  {
+    Role role;
+    PageId at;
+    // in the tree, the parent and which of its slots points here
+    std::optional<u32> parent = {};
+    SlotNum slot = 0;
+    std::vector<u32> children = {};
+    // the leaves before and after in key order, or the trunks before and after in the free list
+    std::optional<u32> prev = {};
+    std::optional<u32> next = {};
+    u32 trunk = 0; // for free pages, the trunk listing it
+  };
+
+  void plan();
+  u32 walkTree(PageId id, std::optional<u32> parent, SlotNum slot, std::vector<u32> &interiors,
+               std::vector<u32> &leaves);
+  void walkFreelist();
+  void swap(u32 node, PageId target);
+  /* rewrite every pointer to the node after it moved from `from` */
+  void relink(u32 node, PageId from);
+  void finish();
+
+  Pager &m_pager;
+  PageId m_rootId;
+  u32 m_root = 0;
+  std::vector<Node> m_nodes;
+  std::unordered_map<PageId, u32> m_at;
+  // the tree's nodes in the order they should be laid out, and where
+  std::vector<u32> m_order;
+  std::vector<PageId> m_targets;
+  std::size_t m_placed = 0;
+  u64 m_changes = 0;
+  bool m_done = false;
+  VacuumStats m_stats;
+};
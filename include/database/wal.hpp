@@ -0,0 +1,146 @@
+#pragma once
+
+#include "storage.hpp"
+#include "pages/page_header.hpp"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// how much a commit does to survive a crash
+enum class Sync
+{
+  Full,   // the log is synced on every commit, which then survives losing power
+  Normal, // commits are written to the log but only synced before pages are written back, so the
+          // last few can be lost with the power but not when the process crashes
+  Off,    // nothing is ever synced, it is all left to the OS
+};
+
+// counters for what the log has done since it was opened
+struct WalStats
+{
+  u64 records = 0; // page records appended
+  u64 deltas = 0;  // of those, the ones that only had the bytes that changed
+  u64 commits = 0; // commit records appended
+  u64 syncs = 0;   // times the log was made durable, commits that arrive together share one
+  u64 bytes = 0;   // bytes written to the log
+};
+
+/* A write-ahead log of page changes in its own storage. Changes are appended as records and only
+ * count once a commit record after them is durable, so a crash can never leave half of a change in
+ * the database. Records are buffered in memory and written out on `flush`, and a commit that
+ * arrives while another thread is syncing waits and goes out with the next sync instead of paying
+ * for its own.
+ *
+ * A position in the log is an `Lsn`, which keeps growing across `reset` so an older page can never
+ * be mistaken for a newer one. Every record carries its own lsn and a checksum, and reading the log
+ * stops at the first one that doesn't match, which is where a crash cut it off.
+ *
+ * A page record is either the whole page or a delta, the byte ranges that changed since the page's
+ * previous record. A delta can only be redone on top of that record, so the first record for a
+ * page after a `reset` is always a whole image. A page torn by the crash is then rebuilt from there */
+class Wal
+{
+public:
+  enum class RecordType : u32
+  {
+    PageImage = 1, // the whole page after the change
+    Commit = 2,    // everything before it is part of the database
+    PageDelta = 3, // the ranges of the page that changed since its previous record
+  };
+
+  // a range of the page in a delta, followed by its bytes
+  struct DeltaRun
+  {
+    u32 offset;
+    u32 length;
+  };
+
+  struct RecordHeader
+  {
+    RecordType type;
+    u32 length; // of the data after the header
+    Lsn lsn;    // where the record starts
+    PageId page;
+    u32 checksum; // of the header with this set to 0, then the data
+  };
+
+  struct FileHeader
+  {
+    static constexpr u32 MAGIC = 0x4c415752; // "RWAL"
+
+    u32 magic = MAGIC;
+    u32 pageSize = 0;
+    Lsn start = 0; // the lsn of the first record
+  };
+
+  /* opens the log in `log`, or starts a new one if it is empty. the log must be for pages of
+   * `pageSize` */
+  Wal(std::unique_ptr<Storage> log, u32 pageSize);
+
+  Wal(const Wal &) = delete;
+  Wal &operator=(const Wal &) = delete;
+
+  /* add the image of a page to the log, returns the lsn just past it */
+  Lsn append(PageId pageNum, std::span<const std::byte> image);
+  /* add a delta made by `diff` against the page's previous record, returns the lsn just past it */
+  Lsn appendDelta(PageId pageNum, std::span<const std::byte> delta);
+  /* end the changes appended so far with a commit record, returns the lsn just past it.
+   * the commit only holds once the log is flushed up to there */
+  Lsn commit();
+  /* make the log durable up to `lsn`, sharing the sync with any commits that have come in.
+   * without `sync` the records are only handed to the storage */
+  void flush(Lsn lsn, bool sync = true);
+
+  Lsn end();
+  Lsn durable();
+  /* bytes of records since the last reset */
+  u64 size();
+  const WalStats &stats() const noexcept { return m_stats; }
+
+  // where a committed change to a page is in the log
+  struct RecordRef
+  {
+    Lsn lsn;
+    PageId page;
+  };
+
+  /* find every committed page record in the log, in log order, then drop anything after the last
+   * commit */
+  std::vector<RecordRef> recover();
+  /* apply the record at `lsn` to the page. safe to call from many threads, as long as the log is
+   * not reset meanwhile */
+  void redo(Lsn lsn, std::span<std::byte> page);
+  /* the delta that turns one image of a page into another. changed bytes closer together than a
+   * run header go in the same run */
+  static std::vector<std::byte> diff(std::span<const std::byte> before,
+                                     std::span<const std::byte> after);
+  /* apply a delta to a page, false if it is malformed or does not fit */
+  static bool patch(std::span<std::byte> page, std::span<const std::byte> delta);
+
+  /* start the log over. everything in it must already be in the synced database file.
+   * without `sync` the new header is only handed to the storage */
+  void reset(bool sync = true);
+
+private:
+  u64 offset(Lsn lsn) const noexcept { return sizeof(FileHeader) + (lsn - m_start); }
+  Lsn appendLocked(RecordType type, PageId pageNum, std::span<const std::byte> data);
+  /* read the record at `lsn`, false if it is not a whole record written for that lsn */
+  bool readRecord(Lsn lsn, RecordHeader &header, std::vector<std::byte> &data) const;
+  void writeHeader(bool sync = true);
+
+  std::mutex m_mutex;
+  std::condition_variable m_flushed;
+  std::unique_ptr<Storage> m_log;
+  u32 m_pageSize;
+  Lsn m_start;
+  Lsn m_end;      // past the last record appended
+  Lsn m_written;  // records before this are being written to the storage or have been
+  Lsn m_stored;   // records before this have been written to the storage
+  Lsn m_durable;  // records before this have been synced
+  bool m_flushing = false;
+  // the records from `m_written` to `m_end`
+  std::vector<std::byte> m_buffer;
+  WalStats m_stats;
+};
@@ -9,6 +9,7 @@
 using u8 = std::uint8_t;
 using u16 = std::uint16_t;
 using u32 = std::uint32_t;
+using u64 = std::uint64_t;
 
 inline void writeNetworku8(std::ostream &out, u8 v)
 {
@@ -0,0 +1,425 @@
+#include "database/async_io.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::unique_ptr<AsyncIO> AsyncIO::create(Storage &storage, u32 depth)
+{
+#ifdef __linux__
+  if (storage.fd() >= 0)
+  {
+    try
+    {
+      return std::make_unique<UringIO>(storage, storage.fd(), depth);
+    }
+    catch (const std::runtime_error &)
+    {
+      // io_uring may be disabled or unsupported, fall back to threads
+    }
+  }
+#endif
+  UNUSED(depth);
+  return std::make_unique<ThreadPoolIO>(storage);
+}
+
+ThreadPoolIO::ThreadPoolIO(Storage &storage, u32 threads) : m_storage(storage)
+{
+  for (u32 i{0}; i < threads; ++i)
+  {
+    m_threads.emplace_back([this] { work(); });
+  }
+}
+
+ThreadPoolIO::~ThreadPoolIO()
+{
+  submit();
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop = true;
+  }
+  m_workCv.notify_all();
+  for (auto &t : m_threads)
+  {
+    t.join();
+  }
+}
+
+AsyncIO::Ticket ThreadPoolIO::enqueue(const IORequest &request)
+{
+  std::lock_guard lock(m_mutex);
+  const Ticket ticket = ++m_nextTicket;
+  m_queued.emplace_back(ticket, request);
+  m_pending.insert(ticket);
+  return ticket;
+}
+
+void ThreadPoolIO::submit()
+{
+  {
+    std::lock_guard lock(m_mutex);
+    if (m_queued.empty())
+    {
+      return;
+    }
+    m_work.insert(m_work.end(), m_queued.begin(), m_queued.end());
+    m_queued.clear();
+  }
+  m_workCv.notify_all();
+}
+
+bool ThreadPoolIO::wait(Ticket ticket)
+{
+  submit();
+  std::unique_lock lock(m_mutex);
+  // never enqueued or already waited on, nothing will ever complete it
+  m_doneCv.wait(lock, [&] { return m_done.count(ticket) > 0 || m_pending.count(ticket) == 0; });
+  if (m_done.count(ticket) == 0)
+  {
+    return false;
+  }
+  const bool ok = m_done[ticket];
+  m_done.erase(ticket);
+  return ok;
+}
+
+bool ThreadPoolIO::done(Ticket ticket)
+{
+  std::lock_guard lock(m_mutex);
+  return m_done.count(ticket) > 0;
+}
+
+void ThreadPoolIO::work()
+{
+  while (true)
+  {
+    std::pair<Ticket, IORequest> item;
+    {
+      std::unique_lock lock(m_mutex);
+      // finish the queued work before stopping, its buffers are still waited on
+      m_workCv.wait(lock, [this] { return m_stop || !m_work.empty(); });
+      if (m_work.empty())
+      {
+        return;
+      }
+      item = m_work.front();
+      m_work.pop_front();
+    }
+
+    const auto &[ticket, request] = item;
+    bool ok = false;
+    if (request.kind == IORequest::Kind::Read)
+    {
+      ok = m_storage.read(request.offset, std::span(request.buf, request.length));
+    }
+    else if (!request.bufs.empty())
+    {
+      ok = m_storage.writev(request.offset, request.bufs);
+    }
+    else
+    {
+      ok = m_storage.write(request.offset, std::span<const std::byte>(request.buf, request.length));
+    }
+
+    {
+      std::lock_guard lock(m_mutex);
+      m_done[ticket] = ok;
+      m_pending.erase(ticket);
+    }
+    m_doneCv.notify_all();
+  }
+}
+
+#ifdef __linux__
+UringIO::UringIO(Storage &storage, int fd, u32 entries) : m_storage(storage), m_fd(fd)
+{
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  m_ring = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+  if (m_ring < 0)
+  {
+    throw std::runtime_error("Failed to set up io_uring.");
+  }
+  if (!supportsOps(m_ring))
+  {
+    ::close(m_ring);
+    throw std::runtime_error("The kernel's io_uring does not support plain reads and writes.");
+  }
+  m_entries = params.sq_entries;
+
+  m_sqMapSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+  m_cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (singleMap)
+  {
+    m_sqMapSize = m_cqMapSize = std::max(m_sqMapSize, m_cqMapSize);
+  }
+
+  m_sqMap = ::mmap(nullptr, m_sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring,
+                   IORING_OFF_SQ_RING);
+  if (m_sqMap == MAP_FAILED)
+  {
+    ::close(m_ring);
+    throw std::runtime_error("Failed to map io_uring submission ring.");
+  }
+  if (singleMap)
+  {
+    m_cqMap = m_sqMap;
+  }
+  else
+  {
+    m_cqMap = ::mmap(nullptr, m_cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     m_ring, IORING_OFF_CQ_RING);
+    if (m_cqMap == MAP_FAILED)
+    {
+      ::munmap(m_sqMap, m_sqMapSize);
+      ::close(m_ring);
+      throw std::runtime_error("Failed to map io_uring completion ring.");
+    }
+  }
+
+  m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  m_sqes = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring,
+                  IORING_OFF_SQES);
+  if (m_sqes == MAP_FAILED)
+  {
+    if (!singleMap)
+      ::munmap(m_cqMap, m_cqMapSize);
+    ::munmap(m_sqMap, m_sqMapSize);
+    ::close(m_ring);
+    throw std::runtime_error("Failed to map io_uring submission entries.");
+  }
+
+  auto *sq = static_cast<std::byte *>(m_sqMap);
+  m_sqTail = reinterpret_cast<u32 *>(sq + params.sq_off.tail);
+  m_sqMask = reinterpret_cast<u32 *>(sq + params.sq_off.ring_mask);
+  m_sqArray = reinterpret_cast<u32 *>(sq + params.sq_off.array);
+
+  auto *cq = static_cast<std::byte *>(m_cqMap);
+  m_cqHead = reinterpret_cast<u32 *>(cq + params.cq_off.head);
+  m_cqTail = reinterpret_cast<u32 *>(cq + params.cq_off.tail);
+  m_cqMask = reinterpret_cast<u32 *>(cq + params.cq_off.ring_mask);
+  m_cqes = cq + params.cq_off.cqes;
+}
+
+bool UringIO::supportsOps(int ring) noexcept
+{
+  // probing came in with IORING_OP_READ and IORING_OP_WRITE, so a kernel without it has neither
+  constexpr u32 OPS = 256;
+  std::vector<std::byte> buf(sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op));
+  auto *probe = reinterpret_cast<io_uring_probe *>(buf.data());
+  if (::syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe, OPS) < 0)
+  {
+    return false;
+  }
+  for (const u8 op : {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_WRITEV})
+  {
+    if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+UringIO::~UringIO()
+{
+  {
+    // the kernel may still be writing into buffers we don't own. what can't be submitted any more
+    // never starts, so only what is in flight has to be waited for, and nothing here throws
+    std::lock_guard lock(m_mutex);
+    UNUSED(trySubmitLocked());
+    while (m_inFlight > 0)
+    {
+      reap(true);
+    }
+  }
+  ::munmap(m_sqes, m_sqesSize);
+  if (m_cqMap != m_sqMap)
+  {
+    ::munmap(m_cqMap, m_cqMapSize);
+  }
+  ::munmap(m_sqMap, m_sqMapSize);
+  ::close(m_ring);
+}
+
+AsyncIO::Ticket UringIO::enqueue(const IORequest &request)
+{
+  std::lock_guard lock(m_mutex);
+  // make room in the rings
+  if (m_queued + m_inFlight >= m_entries)
+  {
+    while (m_queued + m_inFlight >= m_entries)
+    {
+      submitLocked();
+      reap(true);
+    }
+  }
+
+  const Ticket ticket = ++m_nextTicket;
+  if (!request.bufs.empty())
+  {
+    std::vector<iovec> &iov = m_iovecs[ticket];
+    for (const auto &buf : request.bufs)
+    {
+      iov.push_back({const_cast<std::byte *>(buf.data()), buf.size()});
+    }
+  }
+  m_requests[ticket] = request;
+  prepare(ticket, request);
+  return ticket;
+}
+
+void UringIO::prepare(Ticket ticket, const IORequest &request) noexcept
+{
+  // only this side writes the submission tail
+  const u32 tail = *m_sqTail;
+  const u32 index = tail & *m_sqMask;
+  auto *sqe = static_cast<io_uring_sqe *>(m_sqes) + index;
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = request.kind == IORequest::Kind::Read ? IORING_OP_READ : IORING_OP_WRITE;
+  sqe->fd = m_fd;
+  sqe->addr = reinterpret_cast<u64>(request.buf);
+  sqe->len = static_cast<u32>(request.length);
+  if (auto it = m_iovecs.find(ticket); it != m_iovecs.end())
+  {
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->addr = reinterpret_cast<u64>(it->second.data());
+    sqe->len = static_cast<u32>(it->second.size());
+  }
+  sqe->off = request.offset;
+  sqe->user_data = ticket;
+  m_sqArray[index] = index;
+  std::atomic_ref<u32>(*m_sqTail).store(tail + 1, std::memory_order_release);
+  m_queued++;
+}
+
+void UringIO::submit()
+{
+  std::lock_guard lock(m_mutex);
+  submitLocked();
+}
+
+void UringIO::submitLocked()
+{
+  if (!trySubmitLocked())
+  {
+    throw std::runtime_error("Failed to submit to io_uring.");
+  }
+}
+
+bool UringIO::trySubmitLocked() noexcept
+{
+  while (m_queued > 0)
+  {
+    const int n = static_cast<int>(::syscall(__NR_io_uring_enter, m_ring, m_queued, 0, 0, nullptr, 0));
+    if (n <= 0)
+    {
+      return false;
+    }
+    m_queued -= n;
+    m_inFlight += n;
+  }
+  return true;
+}
+
+void UringIO::reap(bool block)
+{
+  u32 head = *m_cqHead;
+  u32 tail = std::atomic_ref<u32>(*m_cqTail).load(std::memory_order_acquire);
+  if (head == tail && block && m_inFlight > 0)
+  {
+    ::syscall(__NR_io_uring_enter, m_ring, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    tail = std::atomic_ref<u32>(*m_cqTail).load(std::memory_order_acquire);
+  }
+
+  bool resubmit = false;
+  for (; head != tail; ++head)
+  {
+    const auto *cqe = static_cast<const io_uring_cqe *>(m_cqes) + (head & *m_cqMask);
+    const Ticket ticket = cqe->user_data;
+    IORequest &request = m_requests[ticket];
+    m_inFlight--;
+
+    const std::size_t done = cqe->res > 0 ? static_cast<std::size_t>(cqe->res) : 0;
+    if (done > 0 && request.kind == IORequest::Kind::Write)
+    {
+      m_storage.didWrite(request.offset, done);
+    }
+    if (done > 0 && done < request.length)
+    {
+      // a short read or write, carry on from where it stopped
+      advance(ticket, request, done);
+      prepare(ticket, request);
+      resubmit = true;
+      continue;
+    }
+
+    // nothing done at all is the end of the file or an error, either way it can't go further
+    m_done[ticket] = done > 0 && done == request.length;
+    m_requests.erase(ticket);
+    m_iovecs.erase(ticket);
+  }
+  std::atomic_ref<u32>(*m_cqHead).store(head, std::memory_order_release);
+  if (resubmit)
+  {
+    // if this fails the rest stays queued for the next submit
+    UNUSED(trySubmitLocked());
+  }
+}
+
+void UringIO::advance(Ticket ticket, IORequest &request, std::size_t done) noexcept
+{
+  request.offset += done;
+  request.length -= done;
+  request.buf += done;
+  auto it = m_iovecs.find(ticket);
+  if (it == m_iovecs.end())
+  {
+    return;
+  }
+  // drop the buffers that were written in full, and the written part of the one after them
+  std::vector<iovec> &iov = it->second;
+  auto first = iov.begin();
+  for (; done >= first->iov_len; ++first)
+  {
+    done -= first->iov_len;
+  }
+  first->iov_base = static_cast<std::byte *>(first->iov_base) + done;
+  first->iov_len -= done;
+  iov.erase(iov.begin(), first);
+}
+
+bool UringIO::wait(Ticket ticket)
+{
+  std::lock_guard lock(m_mutex);
+  while (m_done.count(ticket) == 0)
+  {
+    if (m_requests.count(ticket) == 0)
+    {
+      // never enqueued or already waited on, nothing will ever complete it
+      return false;
+    }
+    // reaping can queue the rest of a short request again
+    submitLocked();
+    reap(true);
+  }
+  const bool ok = m_done[ticket];
+  m_done.erase(ticket);
+  return ok;
+}
+
+bool UringIO::done(Ticket ticket)
+{
+  std::lock_guard lock(m_mutex);
+  reap(false);
+  return m_done.count(ticket) > 0;
+}
+#endif
@@ -0,0 +1,107 @@
+#include "database/buffer_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+BufferPool::BufferPool(std::size_t budgetBytes, u32 pageSize)
+    : m_pageSize(pageSize), m_capacity(std::max(budgetBytes / pageSize, MIN_FRAMES))
+{
+}
+
+Frame *BufferPool::find(PageId id) noexcept
+{
+  auto it = m_table.find(id);
+  if (it == m_table.end())
+  {
+    return nullptr;
+  }
+  return &m_frames[it->second];
+}
+
+BufferPool::Priority BufferPool::priority(const Frame &frame) noexcept
+{
+  if (frame.accesses < Frame::LRU_K)
+  {
+    return {false, frame.history[0], frame.index};
+  }
+  return {true, frame.history[Frame::LRU_K - 1], frame.index};
+}
+
+void BufferPool::touch(Frame &frame)
+{
+  m_order.erase(priority(frame));
+
+  std::copy_backward(frame.history.begin(), frame.history.end() - 1, frame.history.end());
+  frame.history[0] = ++m_clock;
+  frame.accesses = std::min(frame.accesses + 1, Frame::LRU_K);
+
+  m_order.insert(priority(frame));
+}
+
+Frame *BufferPool::victim() noexcept
+{
+  for (const auto &p : m_order)
+  {
+    Frame &frame = m_frames[std::get<FrameId>(p)];
+    if (frame.pins == 0 && !frame.uncommitted)
+    {
+      return &frame;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<Frame *> BufferPool::dirtyVictims(std::size_t max)
+{
+  std::vector<Frame *> frames;
+  for (auto it = m_order.begin(); it != m_order.end() && frames.size() < max; ++it)
+  {
+    Frame &frame = m_frames[std::get<FrameId>(*it)];
+    if (frame.pins == 0 && frame.dirty && !frame.uncommitted)
+    {
+      frames.push_back(&frame);
+    }
+  }
+  return frames;
+}
+
+Frame &BufferPool::insert(PageId id)
+{
+  assert(!full() && "Buffer pool must have a free frame to insert into");
+  assert(find(id) == nullptr && "Page is already resident");
+
+  FrameId index;
+  if (!m_unused.empty())
+  {
+    index = m_unused.back();
+    m_unused.pop_back();
+  }
+  else
+  {
+    index = static_cast<FrameId>(m_frames.size());
+    m_frames.emplace_back(index, m_pageSize);
+  }
+
+  Frame &frame = m_frames[index];
+  frame.id = id;
+  frame.pins = 0;
+  frame.dirty = false;
+  frame.uncommitted = false;
+  frame.lsn = 0;
+  // a different page, keep the capacity for its image
+  frame.logged.clear();
+  frame.history.fill(0);
+  frame.accesses = 0;
+  m_table[id] = index;
+
+  touch(frame);
+  return frame;
+}
+
+void BufferPool::erase(Frame &frame)
+{
+  assert(frame.pins == 0 && "Cannot evict a pinned frame");
+  m_order.erase(priority(frame));
+  m_table.erase(frame.id);
+  m_unused.push_back(frame.index);
+}
@@ -0,0 +1,116 @@
+#include "database/checksum.hpp"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define CRC32C_SSE42
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARM
+#endif
+
+namespace
+{
+constexpr u32 POLYNOMIAL = 0x82f63b78; // reversed
+
+constexpr std::array<u32, 256> makeTable()
+{
+  std::array<u32, 256> table{};
+  for (u32 i{0}; i < table.size(); ++i)
+  {
+    u32 crc = i;
+    for (int bit{0}; bit < 8; ++bit)
+    {
+      crc = (crc >> 1) ^ (crc & 1 ? POLYNOMIAL : 0);
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+constexpr std::array<u32, 256> TABLE = makeTable();
+
+u32 crc32cTable(const std::byte *p, std::size_t n, u32 crc) noexcept
+{
+  for (std::size_t i{0}; i < n; ++i)
+  {
+    crc = (crc >> 8) ^ TABLE[(crc ^ static_cast<u32>(p[i])) & 0xff];
+  }
+  return crc;
+}
+
+#if defined(CRC32C_SSE42)
+__attribute__((target("sse4.2"))) u32 crc32cHardware(const std::byte *p, std::size_t n,
+                                                     u32 crc) noexcept
+{
+  u64 crc64 = crc;
+  for (; n >= sizeof(u64); n -= sizeof(u64), p += sizeof(u64))
+  {
+    u64 word;
+    std::memcpy(&word, p, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = static_cast<u32>(crc64);
+  for (; n > 0; --n, ++p)
+  {
+    crc = _mm_crc32_u8(crc, static_cast<u8>(*p));
+  }
+  return crc;
+}
+
+// asked on first use, the CPU model __builtin_cpu_supports reads may not be set up yet during static
+// initialisation
+bool hardware() noexcept
+{
+  static const bool supported = []
+  {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") != 0;
+  }();
+  return supported;
+}
+#elif defined(CRC32C_ARM)
+u32 crc32cHardware(const std::byte *p, std::size_t n, u32 crc) noexcept
+{
+  for (; n >= sizeof(u64); n -= sizeof(u64), p += sizeof(u64))
+  {
+    u64 word;
+    std::memcpy(&word, p, sizeof(word));
+    crc = __crc32cd(crc, word);
+  }
+  for (; n > 0; --n, ++p)
+  {
+    crc = __crc32cb(crc, static_cast<u8>(*p));
+  }
+  return crc;
+}
+
+bool hardware() noexcept
+{
+  return true;
+}
+#else
+bool hardware() noexcept
+{
+  return false;
+}
+#endif
+} // namespace
+
+u32 crc32c(std::span<const std::byte> data, u32 crc) noexcept
+{
+  crc = ~crc;
+#if defined(CRC32C_SSE42) || defined(CRC32C_ARM)
+  if (hardware())
+  {
+    return ~crc32cHardware(data.data(), data.size(), crc);
+  }
+#endif
+  return ~crc32cTable(data.data(), data.size(), crc);
+}
+
+bool crc32cAccelerated() noexcept
+{
+  return hardware();
+}
@@ -0,0 +1,59 @@
+#include "database/cow_tree.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+std::pair<u32, u64> ReaderTable::enter(const std::atomic<u64> &current)
+{
+  for (u32 slot{0}; slot < MAX_READERS; ++slot)
+  {
+    u64 version = current.load();
+    u64 expected = 0;
+    if (!m_slots[slot].compare_exchange_strong(expected, version))
+    {
+      continue;
+    }
+    // the writer may have freed the pages of `version` before it saw the slot, so keep moving to
+    // the current version until it stays current after being put in the slot
+    for (u64 now = current.load(); now != version; now = current.load())
+    {
+      version = now;
+      m_slots[slot].store(version);
+    }
+    return {slot, version};
+  }
+  throw std::runtime_error("Too many readers.");
+}
+
+void ReaderTable::leave(u32 slot) noexcept
+{
+  m_slots[slot].store(0);
+}
+
+u64 ReaderTable::oldest(u64 current) const noexcept
+{
+  u64 oldest = current;
+  for (const auto &slot : m_slots)
+  {
+    const u64 version = slot.load();
+    if (version != 0)
+    {
+      oldest = std::min(oldest, version);
+    }
+  }
+  return oldest;
+}
+
+std::vector<u64> ReaderTable::active() const
+{
+  std::vector<u64> versions;
+  for (const auto &slot : m_slots)
+  {
+    if (const u64 version = slot.load(); version != 0)
+    {
+      versions.push_back(version);
+    }
+  }
+  std::sort(versions.begin(), versions.end());
+  return versions;
+}
@@ -3,11 +3,20 @@
 
 #include <sstream>
 
-Database::Database(std::iostream &stream)
-: pager(stream) {
+Database::Database(std::iostream &stream, u32 pageSize)
+: pager(stream, DEFAULT_CACHE_SIZE, pageSize) {
   // m_stream.open(file, std::ios::in | std::ios::out | std::ios::binary | std::ios::app);
 }
 
+Database::Database(std::unique_ptr<Storage> storage, u32 pageSize)
+: pager(std::move(storage), DEFAULT_CACHE_SIZE, pageSize) {
+}
+
+Database::Database(std::unique_ptr<Storage> storage, std::unique_ptr<Storage> log, u32 pageSize)
+: pager(std::move(storage), DEFAULT_CACHE_SIZE, pageSize) {
+  pager.useLog(std::move(log));
+}
+
 //
 // bool Row::serialise(std::ostream &stream) const noexcept
 // {
@@ -1,109 +1,1332 @@
 #include "database/pager.hpp"
 
-Pager::Pager(std::iostream &stream)
-    : m_stream(stream), m_pages()
+#include <algorithm>
+#include <cassert>
+#include <optional>
+
+Pager::Pager(std::iostream &stream, std::size_t cacheSize, u32 pageSize)
+    : Pager(std::make_unique<StreamStorage>(stream), cacheSize, pageSize)
 {
-  // m_stream.open(file, std::ios::in | std::ios::out | std::ios::binary | std::ios::app);
-  if (!m_stream)
-  {
-    throw std::runtime_error("Failed to open database file.");
-  }
+}
 
-  m_stream.seekg(0, std::ios::end);
-  m_fSize = m_stream.tellg();
-  if (!m_stream)
+Pager::Pager(std::unique_ptr<Storage> storage, std::size_t cacheSize, u32 pageSize)
+    : m_storage(std::move(storage)), m_pageSize(storedPageSize(*m_storage, pageSize)),
+      m_pool(cacheSize, m_pageSize)
+{
+  if (m_pageSize % m_storage->alignment() != 0)
   {
-    throw std::runtime_error("Failed to get size of database file.");
+    throw std::invalid_argument("Page size must be a multiple of the storage's I/O alignment.");
   }
+  m_fSize = m_storage->size();
 
   if (m_fSize == 0)
   {
     // new database, write the database header
-    m_pages[0] = Page<>();
-    Page<FirstPage::Header> &firstPage = m_pages[0].as_ref<FirstPage::Header>();
-    firstPage.header()->common.type = PageType::First;
+    Frame &frame = fetch(0, false);
+    Page<FirstPage::Header> &firstPage = frame.page.as_ref<FirstPage::Header>();
+    firstPage.reset(PageType::First);
+    firstPage.header()->db.pageSize = m_pageSize;
     flushPage(0, firstPage);
+    m_fSize = m_pageSize;
   }
+
+  // the first page is used by every allocation so it is never evicted
+  fetch(0, true).pins++;
 }
 
-template <typename H> // page header type
-Page<H> &Pager::getPage(PageId pageNum)
+Pager::~Pager()
+{
+  stopCheckpointer();
+  waitForRecovery();
+  try
+  {
+    if (m_wal != nullptr)
+    {
+      checkpoint();
+    }
+    else
+    {
+      flush();
+    }
+    for (auto &[id, prefetch] : m_prefetching)
+    {
+      UNUSED(m_io->wait(prefetch.ticket));
+    }
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "Failed to write back pages when closing: " << e.what() << std::endl;
+  }
+}
+
+u32 Pager::storedPageSize(Storage &storage, u32 pageSize)
+{
+  if (!isValidPageSize(pageSize))
+  {
+    throw std::invalid_argument("Page size must be a power of two from 512 B to 64 KiB.");
+  }
+  if (storage.size() == 0)
+  {
+    return pageSize;
+  }
+
+  // the header is at the start of the first page whatever its size
+  FirstPage::Header header;
+  if (!storage.read(0, std::as_writable_bytes(std::span(&header, 1))))
+  {
+    throw PageError(0, "Failed to read the database header");
+  }
+  // older files have their version elsewhere and 0 here, they are laid out differently throughout
+  if (header.db.version != DATABASE_VERSION)
+  {
+    throw PageError(0, "Unsupported database version, the file was written in another format");
+  }
+  if (!isValidPageSize(header.db.pageSize))
+  {
+    throw PageError(0, "Invalid page size in the database header");
+  }
+  return header.db.pageSize;
+}
+
+std::size_t Pager::dirtyPages()
+{
+  std::lock_guard lock(m_mutex);
+  std::size_t n = 0;
+  m_pool.forEach([&n](const Frame &frame) { n += frame.dirty; });
+  return n;
+}
+
+void Pager::flush()
+{
+  flush(m_sync != Sync::Off);
+}
+
+void Pager::flush(bool sync)
+{
+  std::lock_guard lock(m_mutex);
+  std::vector<Frame *> dirty;
+  m_pool.forEach(
+      [&dirty](Frame &frame)
+      {
+        if (!frame.dirty || frame.uncommitted)
+          return;
+        // don't wait on a writer, the page stays dirty for the next flush
+        if (!frame.latch.try_lock_shared())
+          return;
+        dirty.push_back(&frame);
+      });
+  writeBack(dirty);
+  for (Frame *frame : dirty)
+  {
+    frame->latch.unlock_shared();
+  }
+  if (sync && !m_storage->sync())
+  {
+    throw std::runtime_error("Failed to sync database file.");
+  }
+}
+
+void Pager::useLog(std::unique_ptr<Storage> log, u32 redoThreads)
+{
+  std::lock_guard lock(m_mutex);
+  m_wal = std::make_unique<Wal>(std::move(log), m_pageSize);
+
+  // the log is only reset once everything in it is in the file, so any of it may need redoing
+  for (const Wal::RecordRef &record : m_wal->recover())
+  {
+    m_redo[record.page].push_back(record.lsn);
+    m_fSize = std::max<u64>(m_fSize, static_cast<u64>(record.page + 1) * m_pageSize);
+  }
+
+  // cached pages, like the first, can't be redone behind the cache's back
+  std::vector<PageId> pages;
+  for (auto it = m_redo.begin(); it != m_redo.end();)
+  {
+    if (Frame *frame = m_pool.find(it->first))
+    {
+      redoInto(frame->page.buf, it->second);
+      redone(*frame, it->second);
+      it = m_redo.erase(it);
+      continue;
+    }
+    pages.push_back(it->first);
+    ++it;
+  }
+  if (pages.empty())
+  {
+    return;
+  }
+
+  // split the pages between the threads, each page's records are redone in order by one of them
+  std::sort(pages.begin(), pages.end());
+  if (redoThreads == 0)
+  {
+    redoThreads = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_REDO_THREADS);
+  }
+  redoThreads = std::min<u32>(redoThreads, pages.size());
+  std::vector<std::vector<PageId>> parts(redoThreads);
+  for (std::size_t i{0}; i < pages.size(); ++i)
+  {
+    parts[i % redoThreads].push_back(pages[i]);
+  }
+  std::lock_guard threadsLock(m_redoMutex);
+  for (auto &part : parts)
+  {
+    m_redoThreads.emplace_back([this, part = std::move(part)] { redoPages(part); });
+  }
+}
+
+void Pager::waitForRecovery()
+{
+  // the redo threads take the pager's lock, so this one is separate. a second caller waits for the
+  // first to finish joining them
+  std::lock_guard lock(m_redoMutex);
+  for (auto &t : m_redoThreads)
+  {
+    t.join();
+  }
+  m_redoThreads.clear();
+}
+
+bool Pager::recovering()
+{
+  std::lock_guard lock(m_mutex);
+  return !m_redo.empty();
+}
+
+void Pager::redoInto(PageBuffer &page, const std::vector<Lsn> &records)
+{
+  // a page torn by the crash has to come entirely from the log
+  Lsn applied = 0;
+  if (verifyPage(page))
+  {
+    applied = reinterpret_cast<const CommonHeader *>(page.data())->lsn;
+  }
+  u64 skipped = 0;
+  for (Lsn lsn : records)
+  {
+    if (lsn <= applied)
+    {
+      skipped++;
+      continue;
+    }
+    m_wal->redo(lsn, page);
+  }
+
+  std::lock_guard lock(m_mutex);
+  m_stats.redone++;
+  m_stats.redoSkipped += skipped;
+}
+
+void Pager::redoPages(const std::vector<PageId> &pages)
+{
+  for (PageId pageNum : pages)
+  {
+    try
+    {
+      std::vector<Lsn> records;
+      {
+        std::lock_guard lock(m_mutex);
+        auto it = m_redo.find(pageNum);
+        if (it == m_redo.end())
+        {
+          // already redone on demand
+          continue;
+        }
+        records = it->second;
+      }
+
+      // the I/O is done without holding the pager
+      PageBuffer page(m_pageSize);
+      readForRedo(pageNum, page);
+      redoInto(page, records);
+
+      std::lock_guard lock(m_mutex);
+      if (m_redo.erase(pageNum) == 0)
+      {
+        continue;
+      }
+      Frame &frame = fetch(pageNum, false);
+      frame.page.buf = page;
+      redone(frame, records);
+    }
+    catch (const std::exception &e)
+    {
+      // left for whoever reads the page next, which will see the error
+      std::cerr << "Failed to redo page " << pageNum << ": " << e.what() << std::endl;
+    }
+  }
+}
+
+void Pager::redone(Frame &frame, const std::vector<Lsn> &records)
+{
+  // until it is written back the page's committed state is only in the log, so the log can't be
+  // reset before the redone image is written, even if the page is changed again without a commit
+  frame.dirty = true;
+  frame.lsn = records.back();
+  frame.logged.assign(frame.page.buf.begin(), frame.page.buf.end());
+}
+
+void Pager::readForRedo(PageId pageNum, PageBuffer &page)
+{
+  const u64 offset = static_cast<u64>(pageNum) * m_pageSize;
+  if (offset + m_pageSize > m_storage->size() || !m_storage->read(offset, page))
+  {
+    // never written before the crash
+    page.fill(std::byte{0});
+  }
+}
+
+void Pager::modified(Frame &frame)
 {
+  m_changes++;
+  frame.dirty = true;
+  if (m_wal != nullptr && !frame.uncommitted)
+  {
+    frame.uncommitted = true;
+    frame.writer = std::this_thread::get_id();
+  }
+}
 
-  if (m_pages.count(pageNum))
+Lsn Pager::commit(Sync sync)
+{
+  if (m_wal == nullptr)
   {
-    return reinterpret_cast<Page<H> &>(m_pages[pageNum]);
+    flush(sync == Sync::Full);
+    return 0;
+  }
+
+  Lsn lsn;
+  {
+    std::lock_guard lock(m_mutex);
+    std::vector<Frame *> changed;
+    m_pool.forEach(
+        [&changed, self = std::this_thread::get_id()](Frame &frame)
+        {
+          if (frame.uncommitted && frame.writer == self)
+            changed.push_back(&frame);
+        });
+    std::sort(changed.begin(), changed.end(),
+              [](const Frame *a, const Frame *b) { return a->id < b->id; });
+
+    for (Frame *frame : changed)
+    {
+      // don't wait on a writer, its page goes with the next commit
+      if (!frame->latch.try_lock_shared())
+        continue;
+      // readers may be looking at the page, so the lsn goes into a copy. nothing else appends
+      // while the pager is locked, so this is where the record will start
+      std::vector<std::byte> image(frame->page.buf.begin(), frame->page.buf.end());
+      reinterpret_cast<CommonHeader *>(image.data())->lsn = m_wal->end();
+      std::vector<std::byte> delta;
+      if (!frame->logged.empty())
+        delta = Wal::diff(frame->logged, image);
+      // a delta only pays off while it is smaller than the page it would stand in for
+      if (!delta.empty() && delta.size() < m_pageSize)
+        frame->lsn = m_wal->appendDelta(frame->id, delta);
+      else
+        frame->lsn = m_wal->append(frame->id, image);
+      frame->logged = std::move(image);
+      frame->uncommitted = false;
+      frame->latch.unlock_shared();
+    }
+    lsn = m_wal->commit();
+  }
+
+  // wait outside of the pager so other threads can queue their commits behind this sync.
+  // without one the records still go to the storage, so they outlive the process
+  m_wal->flush(lsn, sync == Sync::Full);
+
+  if (m_checkpointer != nullptr && m_wal->size() > m_checkpointer->options.maxLogSize)
+  {
+    std::lock_guard cpLock(m_checkpointer->mutex);
+    m_checkpointer->wanted = true;
+    m_checkpointer->cv.notify_one();
+  }
+  return lsn;
+}
+
+void Pager::checkpoint()
+{
+  if (m_wal == nullptr)
+  {
+    flush();
+    return;
+  }
+
+  waitForRecovery();
+  PageId cursor = 0;
+  while (checkpointStep(cursor, WRITEBACK_BATCH))
+  {
+  }
+  UNUSED(finishCheckpoint());
+}
+
+bool Pager::checkpointStep(PageId &cursor, std::size_t batch)
+{
+  std::lock_guard lock(m_mutex);
+  std::vector<Frame *> frames;
+  m_pool.forEach(
+      [&](Frame &frame)
+      {
+        if (frame.dirty && !frame.uncommitted && frame.id >= cursor)
+          frames.push_back(&frame);
+      });
+  std::sort(frames.begin(), frames.end(),
+            [](const Frame *a, const Frame *b) { return a->id < b->id; });
+  const bool more = frames.size() > batch;
+  frames.resize(std::min(frames.size(), batch));
+  if (frames.empty())
+  {
+    return false;
+  }
+  cursor = frames.back()->id + 1;
+
+  // a page latched by a writer is left for the end
+  std::erase_if(frames, [](Frame *frame) { return !frame->latch.try_lock_shared(); });
+  const u64 writes = m_stats.writes;
+  try
+  {
+    writeBack(frames);
+  }
+  catch (...)
+  {
+    for (Frame *frame : frames)
+      frame->latch.unlock_shared();
+    throw;
+  }
+  for (Frame *frame : frames)
+  {
+    frame->latch.unlock_shared();
+  }
+  m_stats.checkpointWrites += m_stats.writes - writes;
+  return more;
+}
+
+bool Pager::finishCheckpoint()
+{
+  std::lock_guard lock(m_mutex);
+  const u64 writes = m_stats.writes;
+  flush();
+  writeLogged();
+  m_stats.checkpointWrites += m_stats.writes - writes;
+
+  // records still to be redone are only in the log
+  bool inLog = !m_redo.empty();
+  m_pool.forEach([&inLog](const Frame &frame) { inLog |= frame.lsn != 0; });
+  if (inLog)
+  {
+    // try again next time, by then nothing should be reading the page in place
+    return false;
+  }
+  m_wal->reset(m_sync != Sync::Off);
+  // the records deltas were made against are gone, so each page starts again with its image
+  m_pool.forEach([](Frame &frame) { frame.logged.clear(); });
+  m_stats.checkpoints++;
+  return true;
+}
+
+void Pager::writeLogged()
+{
+  std::vector<Frame *> frames;
+  Lsn lsn = 0;
+  m_pool.forEach(
+      [&](Frame &frame)
+      {
+        if (frame.lsn != 0 && !frame.logged.empty() && !readInPlace(frame.id))
+        {
+          frames.push_back(&frame);
+          lsn = std::max(lsn, frame.lsn);
+        }
+      });
+  if (frames.empty())
+  {
+    return;
+  }
+  m_wal->flush(lsn, m_sync != Sync::Off);
+
+  PageBuffer image(m_pageSize);
+  for (Frame *frame : frames)
+  {
+    std::copy(frame->logged.begin(), frame->logged.end(), image.begin());
+    sealPage(image);
+    if (!m_storage->write(static_cast<u64>(frame->id) * m_pageSize, image))
+    {
+      throw PageError(frame->id, "Failed to flush");
+    }
+    m_stats.writes++;
+    m_stats.writeCalls++;
+    // the page is still dirty with what it has changed since
+    frame->lsn = 0;
+  }
+  if (m_sync != Sync::Off && !m_storage->sync())
+  {
+    throw std::runtime_error("Failed to sync database file.");
+  }
+}
+
+void Pager::startCheckpointer(CheckpointOptions options)
+{
+  if (m_wal == nullptr)
+  {
+    throw std::runtime_error("Checkpointing needs a log.");
+  }
+  stopCheckpointer();
+  m_checkpointer = std::make_unique<Checkpointer>();
+  m_checkpointer->options = options;
+  m_checkpointer->thread = std::thread([this] { runCheckpointer(); });
+}
+
+void Pager::stopCheckpointer()
+{
+  if (m_checkpointer == nullptr)
+  {
+    return;
+  }
+  {
+    std::lock_guard lock(m_checkpointer->mutex);
+    m_checkpointer->stop = true;
+  }
+  m_checkpointer->cv.notify_one();
+  m_checkpointer->thread.join();
+  m_checkpointer.reset();
+}
+
+void Pager::runCheckpointer()
+{
+  Checkpointer &cp = *m_checkpointer;
+  const auto foregroundReads = [this]
+  {
+    std::lock_guard lock(m_mutex);
+    return m_stats.reads;
+  };
+
+  std::unique_lock lock(cp.mutex);
+  while (true)
+  {
+    cp.cv.wait_for(lock, cp.options.interval, [&cp] { return cp.stop || cp.wanted; });
+    if (cp.stop)
+    {
+      return;
+    }
+    cp.wanted = false;
+    if (m_wal->size() == 0)
+    {
+      continue;
+    }
+
+    lock.unlock();
+    try
+    {
+      PageId cursor = 0;
+      u64 reads = foregroundReads();
+      while (checkpointStep(cursor, cp.options.batch))
+      {
+        // back off while queries are waiting on reads
+        const u64 now = foregroundReads();
+        if (now != reads)
+        {
+          std::unique_lock pause(cp.mutex);
+          if (cp.cv.wait_for(pause, cp.options.throttle, [&cp] { return cp.stop; }))
+          {
+            return;
+          }
+        }
+        reads = now;
+      }
+      UNUSED(finishCheckpoint());
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "Failed to checkpoint: " << e.what() << std::endl;
+    }
+    lock.lock();
+  }
+}
+
+void Pager::advise(PageId first, u32 count, Storage::Access access)
+{
+  m_storage->advise(static_cast<u64>(first) * m_pageSize, static_cast<u64>(count) * m_pageSize,
+                    access);
+}
+
+const Page<> *Pager::findMapped(PageId pageNum)
+{
+  MappedView *view = findView(pageNum);
+  return view != nullptr ? &view->page : nullptr;
+}
+
+MappedView *Pager::findView(PageId pageNum)
+{
+  std::lock_guard lock(m_mutex);
+  if (m_pool.find(pageNum) != nullptr || m_redo.count(pageNum) > 0)
+  {
+    // the cached or recovered copy is newer
+    return nullptr;
+  }
+  auto it = m_mapped.find(pageNum);
+  if (it != m_mapped.end())
+  {
+    return &it->second;
+  }
+  const std::byte *data = m_storage->map(static_cast<u64>(pageNum) * m_pageSize, m_pageSize);
+  if (data == nullptr)
+  {
+    return nullptr;
+  }
+  verify(pageNum, std::span(data, m_pageSize));
+  // the view is only ever handed out as const
+  auto view = PageBuffer::view(const_cast<std::byte *>(data), m_pageSize);
+  return &m_mapped.try_emplace(pageNum, pageNum, Page<>(std::move(view))).first->second;
+}
+
+MappedView *Pager::pinMapped(PageId pageNum)
+{
+  std::lock_guard lock(m_mutex);
+  MappedView *view = findView(pageNum);
+  if (view != nullptr)
+  {
+    view->pins++;
+  }
+  return view;
+}
+
+void Pager::unpin(MappedView &view) noexcept
+{
+  std::lock_guard lock(m_mutex);
+  assert(view.pins > 0 && "Unpinning a view that is not pinned");
+  view.pins--;
+  // a frame read in for the page since holds a pin for each reader of the view
+  if (Frame *frame = m_pool.find(view.id))
+  {
+    frame->pins--;
+  }
+}
+
+bool Pager::readInPlace(PageId pageNum) const
+{
+  auto it = m_mapped.find(pageNum);
+  return it != m_mapped.end() && it->second.pins > 0;
+}
+
+Frame &Pager::pin(PageId pageNum, bool dirty)
+{
+  std::lock_guard lock(m_mutex);
+  Frame &frame = fetch(pageNum, true);
+  frame.pins++;
+  if (dirty)
+  {
+    modified(frame);
+  }
+  return frame;
+}
+
+void Pager::unpin(Frame &frame) noexcept
+{
+  std::lock_guard lock(m_mutex);
+  assert(frame.pins > 0 && "Unpinning a frame that is not pinned");
+  frame.pins--;
+}
+
+void Pager::writeBack(std::vector<Frame *> frames)
+{
+  // writing would change the mapping under a guard reading the page in place, so the page stays
+  // dirty until the guard is released
+  std::erase_if(frames, [this](const Frame *frame) { return readInPlace(frame->id); });
+  std::sort(frames.begin(), frames.end(),
+            [](const Frame *a, const Frame *b) { return a->id < b->id; });
+
+  if (m_wal != nullptr)
+  {
+    // a page can only reach the file after the log records for it
+    Lsn lsn = 0;
+    for (const Frame *frame : frames)
+    {
+      lsn = std::max(lsn, frame->lsn);
+    }
+    m_wal->flush(lsn, m_sync != Sync::Off);
+  }
+
+  // readers may be looking at the pages, so what is written is a sealed copy of each. a logged
+  // page carries the lsn of its last record, which only its copy in the log was given
+  std::vector<PageBuffer> sealed;
+  sealed.reserve(frames.size());
+  for (const Frame *frame : frames)
+  {
+    PageBuffer &copy = sealed.emplace_back(frame->page.buf);
+    if (!frame->logged.empty())
+    {
+      reinterpret_cast<CommonHeader *>(copy.data())->lsn =
+          reinterpret_cast<const CommonHeader *>(frame->logged.data())->lsn;
+    }
+    sealPage(copy);
+  }
+
+  // split the frames into runs of consecutive page ids
+  struct Run
+  {
+    std::size_t first;
+    std::size_t count;
+    std::vector<std::span<const std::byte>> bufs;
+  };
+  std::vector<Run> runs;
+  for (std::size_t i{0}; i < frames.size(); ++i)
+  {
+    if (runs.empty() || runs.back().count == MAX_WRITE_RUN ||
+        frames[i]->id != frames[i - 1]->id + 1)
+    {
+      runs.push_back({i, 0, {}});
+    }
+    runs.back().count++;
+    runs.back().bufs.push_back(sealed[i]);
+  }
+
+  std::vector<AsyncIO::Ticket> tickets;
+  if (m_io != nullptr)
+  {
+    // submit the whole batch before waiting on any of it
+    for (const Run &run : runs)
+    {
+      tickets.push_back(m_io->enqueue({IORequest::Kind::Write,
+                                       static_cast<u64>(frames[run.first]->id) * m_pageSize,
+                                       sealed[run.first].data(), run.count * m_pageSize,
+                                       run.bufs}));
+    }
+    m_io->submit();
+  }
+
+  std::optional<PageId> failed;
+  for (std::size_t r{0}; r < runs.size(); ++r)
+  {
+    const Run &run = runs[r];
+    const PageId first = frames[run.first]->id;
+    const bool ok = m_io != nullptr
+                        ? m_io->wait(tickets[r])
+                        : m_storage->writev(static_cast<u64>(first) * m_pageSize, run.bufs);
+    m_stats.writeCalls++;
+    if (!ok)
+    {
+      failed = failed.value_or(first);
+      continue;
+    }
+    for (std::size_t i{run.first}; i < run.first + run.count; ++i)
+    {
+      frames[i]->dirty = false;
+      frames[i]->lsn = 0;
+      if (m_knownGood.size() <= frames[i]->id)
+        m_knownGood.resize(frames[i]->id + 1);
+      m_knownGood[frames[i]->id] = true;
+    }
+    m_stats.writes += run.count;
+  }
+  if (failed.has_value())
+  {
+    throw PageError(*failed, "Failed to flush");
+  }
+}
+
+void Pager::useAsyncIO(std::unique_ptr<AsyncIO> io)
+{
+  std::lock_guard lock(m_mutex);
+  for (auto &[id, prefetch] : m_prefetching)
+  {
+    UNUSED(m_io->wait(prefetch.ticket));
+  }
+  m_prefetching.clear();
+  m_io = std::move(io);
+}
+
+void Pager::prefetch(std::span<const PageId> pages)
+{
+  std::lock_guard lock(m_mutex);
+  if (m_io == nullptr)
+  {
+    return;
+  }
+
+  bool queued = false;
+  for (PageId id : pages)
+  {
+    queued |= prefetchOne(id);
+  }
+
+  if (queued)
+  {
+    m_io->submit();
+  }
+}
+
+bool Pager::prefetchOne(PageId pageNum)
+{
+  if (m_prefetching.size() >= MAX_PREFETCH)
+  {
+    return false;
+  }
+
+  const u64 offset = static_cast<u64>(pageNum) * m_pageSize;
+  if (m_pool.find(pageNum) != nullptr || m_prefetching.count(pageNum) > 0 ||
+      m_redo.count(pageNum) > 0 ||
+      offset + m_pageSize > m_storage->size() || m_storage->map(offset, m_pageSize) != nullptr)
+  {
+    return false;
+  }
+
+  auto page = std::make_unique<Page<>>(PageType::Leaf, m_pageSize);
+  const auto ticket = m_io->enqueue({IORequest::Kind::Read, offset, page->buf.data(), m_pageSize});
+  m_prefetching.emplace(pageNum, Prefetch{ticket, std::move(page)});
+  m_stats.prefetched++;
+  return true;
+}
+
+void Pager::dropPrefetch(PageId pageNum)
+{
+  auto it = m_prefetching.find(pageNum);
+  if (it == m_prefetching.end())
+  {
+    return;
+  }
+  UNUSED(m_io->wait(it->second.ticket));
+  m_prefetching.erase(it);
+}
+
+const Page<> *Pager::loaded(PageId pageNum)
+{
+  if (const Frame *frame = m_pool.find(pageNum))
+  {
+    return &frame->page;
+  }
+  if (const Page<> *mapped = findMapped(pageNum))
+  {
+    return mapped;
+  }
+  auto it = m_prefetching.find(pageNum);
+  if (it != m_prefetching.end() && m_io->done(it->second.ticket))
+  {
+    return it->second.page.get();
+  }
+  return nullptr;
+}
+
+void Pager::readAhead(PageId pageNum, PageId (*next)(const Page<> &), ReadAhead &scan)
+{
+  std::lock_guard lock(m_mutex);
+  const Page<> *page = loaded(pageNum);
+  if (page == nullptr)
+  {
+    return;
+  }
+
+  if (scan.issued.erase(pageNum) > 0)
+  {
+    // the scan reached a page we read ahead, so it is worth reading further
+    scan.window = std::min(scan.window * 2, MAX_READAHEAD);
+  }
+  else if (pageNum != scan.expected && !scan.issued.empty())
+  {
+    // the scan jumped, so what we read ahead for it is wasted
+    abandon(scan);
+    scan.window = std::max(scan.window / 2, MIN_READAHEAD);
+  }
+
+  const PageId sibling = next(*page);
+  scan.expected = sibling;
+  if (sibling == 0)
+  {
+    return;
+  }
+
+  if (sibling == pageNum + 1)
+  {
+    // the leaves are laid out in order on disk, read the next window of pages by id
+    const u32 window = scan.window;
+    advise(sibling, window, Storage::Access::Sequential);
+    if (m_io == nullptr || findMapped(sibling) != nullptr)
+    {
+      // let the OS read them into its cache instead
+      advise(sibling, window, Storage::Access::WillNeed);
+      return;
+    }
+    bool queued = false;
+    for (PageId id = sibling; id < sibling + window; ++id)
+    {
+      if (prefetchOne(id))
+      {
+        scan.issued.insert(id);
+        m_stats.readAhead++;
+        queued = true;
+      }
+    }
+    if (queued)
+    {
+      m_io->submit();
+    }
+    return;
+  }
+
+  // otherwise the chain has to be followed, which we can only do through pages already in memory
+  if (m_io == nullptr)
+  {
+    return;
+  }
+  PageId id = sibling;
+  for (u32 ahead{0}; ahead < scan.window && id != 0; ++ahead)
+  {
+    const Page<> *p = loaded(id);
+    if (p == nullptr)
+    {
+      if (prefetchOne(id))
+      {
+        scan.issued.insert(id);
+        m_stats.readAhead++;
+        m_io->submit();
+      }
+      break;
+    }
+    id = next(*p);
+  }
+}
+
+void Pager::endScan(ReadAhead &scan) noexcept
+{
+  std::lock_guard lock(m_mutex);
+  try
+  {
+    abandon(scan);
+  }
+  catch (...)
+  {
+    // a prefetch that can't be waited for is left to whoever reads the page
+  }
+  scan.expected = 0;
+}
+
+void Pager::abandon(ReadAhead &scan)
+{
+  m_stats.readAheadWasted += scan.issued.size();
+  while (!scan.issued.empty())
+  {
+    const PageId id = *scan.issued.begin();
+    scan.issued.erase(scan.issued.begin());
+    if (m_io != nullptr)
+    {
+      dropPrefetch(id);
+    }
+  }
+}
+
+bool Pager::takePrefetch(PageId pageNum, Frame &frame, bool read)
+{
+  auto it = m_prefetching.find(pageNum);
+  if (it == m_prefetching.end())
+  {
+    return false;
+  }
+
+  // even if the page is not going to be read, the buffer has to outlive the request
+  const bool ok = m_io->wait(it->second.ticket);
+  auto page = std::move(it->second.page);
+  m_prefetching.erase(it);
+  if (!ok || !read)
+  {
+    return false;
+  }
+  try
+  {
+    verify(pageNum, page->buf);
+  }
+  catch (const PageError &)
+  {
+    m_pool.erase(frame);
+    throw;
+  }
+  frame.page = *page;
+  m_stats.prefetchHits++;
+  return true;
+}
+
+Frame &Pager::fetch(PageId pageNum, bool read)
+{
+  std::lock_guard lock(m_mutex);
+  if (Frame *frame = m_pool.find(pageNum))
+  {
+    m_pool.touch(*frame);
+    return *frame;
+  }
+
+  if (m_pool.full())
+  {
+    Frame *victim = m_pool.victim();
+    if (victim == nullptr)
+    {
+      throw PageError(pageNum, "No unpinned or committed frames left in the cache");
+    }
+    if (victim->dirty)
+    {
+      // other dirty pages are likely to be evicted soon too, so write them in the same pass
+      writeBack(m_pool.dirtyVictims(WRITEBACK_BATCH));
+    }
+    m_pool.erase(*victim);
+  }
+
+  Frame &frame = m_pool.insert(pageNum);
+  const auto ready = [this](Frame &fetched) -> Frame &
+  {
+    // guards still reading the page in place keep the copy from being evicted, as it can't be
+    // written back until they are done
+    if (auto it = m_mapped.find(fetched.id); it != m_mapped.end())
+    {
+      fetched.pins += it->second.pins;
+    }
+    return fetched;
+  };
+  if (auto it = m_redo.find(pageNum); it != m_redo.end())
+  {
+    // recovery has not got to the page yet, so redo it now
+    try
+    {
+      readForRedo(pageNum, frame.page.buf);
+      redoInto(frame.page.buf, it->second);
+    }
+    catch (...)
+    {
+      m_pool.erase(frame);
+      throw;
+    }
+    redone(frame, it->second);
+    m_redo.erase(it);
+    return ready(frame);
+  }
+  if (takePrefetch(pageNum, frame, read) || !read)
+  {
+    return ready(frame);
   }
 
   // read the page and create it in cache
   // TODO: convert the endianness using page type to know the data inside
   // TODO: read the type bytes manually then call the appropiate deserialise on that type
-  if (!m_stream.seekg(pageNum * PAGE_SIZE))
+  if (!m_storage->read(static_cast<u64>(pageNum) * m_pageSize, frame.page.buf))
+  {
+    m_pool.erase(frame);
+    throw PageError(pageNum, "Failed to read");
+  }
+  m_stats.reads++;
+  try
   {
-    throw PageError(pageNum, "Failed in seeking to read");
+    verify(pageNum, frame.page.buf);
   }
-  if (!m_stream.read(reinterpret_cast<char *>(m_pages[pageNum].buf.data()), m_pages[pageNum].buf.size()))
+  catch (const PageError &)
   {
-    throw PageError(pageNum, "Failed to read");
+    m_pool.erase(frame);
+    throw;
+  }
+
+  return ready(frame);
+}
+
+void Pager::verify(PageId pageNum, std::span<const std::byte> page)
+{
+  const bool known = pageNum < m_knownGood.size() && m_knownGood[pageNum];
+  if (m_verify == Verify::Never || (m_verify == Verify::Once && known))
+  {
+    return;
+  }
+  m_stats.verified++;
+  if (!verifyPage(page))
+  {
+    throw PageError(pageNum, "Checksum does not match, the page is corrupt");
+  }
+  if (!known)
+  {
+    if (m_knownGood.size() <= pageNum)
+      m_knownGood.resize(pageNum + 1);
+    m_knownGood[pageNum] = true;
+  }
+}
+
+void Pager::writePage(PageId pageNum, const Page<> &page)
+{
+  std::lock_guard lock(m_mutex);
+  PageBuffer sealed = page.buf;
+  sealPage(sealed);
+  if (!m_storage->write(static_cast<u64>(pageNum) * m_pageSize, sealed))
+  {
+    throw PageError(pageNum, "Failed to flush");
   }
+  m_stats.writes++;
+  m_stats.writeCalls++;
 
-  return reinterpret_cast<Page<H> &>(m_pages[pageNum]);
+  // the cached copy now matches the disk
+  Frame *frame = m_pool.find(pageNum);
+  if (frame != nullptr && &frame->page == &page)
+  {
+    frame->dirty = false;
+  }
 }
+
+template <typename H> // page header type
+Page<H> &Pager::getPage(PageId pageNum)
+{
+  Frame &frame = fetch(pageNum, true);
+  // we can't see writes through the reference so assume there will be one
+  modified(frame);
+  return frame.page.as_ref<H>();
+}
+template Page<CommonHeader> &Pager::getPage(PageId);
 template Page<BTreeHeader> &Pager::getPage(PageId);
 template Page<FirstPage::Header> &Pager::getPage(PageId);
+template Page<FreelistPage::Header> &Pager::getPage(PageId);
 
-void Pager::setPage(PageId pageNum, const Page<> &page) noexcept
+template <typename H> // page header type
+const Page<H> &Pager::readPage(PageId pageNum)
 {
-  m_pages[pageNum] = page;
+  if (const Page<> *mapped = findMapped(pageNum))
+  {
+    return mapped->as_const<H>();
+  }
+  return fetch(pageNum, true).page.as_const<H>();
 }
+template const Page<CommonHeader> &Pager::readPage(PageId);
+template const Page<BTreeHeader> &Pager::readPage(PageId);
+template const Page<FirstPage::Header> &Pager::readPage(PageId);
+template const Page<FreelistPage::Header> &Pager::readPage(PageId);
 
-PageId Pager::nextFree(PageType type)
+void Pager::setPage(PageId pageNum, const Page<> &page)
 {
-  // check the firstPage for the free list, otherwise append to file
-  Page<FirstPage::Header> &firstPage = m_pages[0].as_ref<FirstPage::Header>();
-  PageId freelist = firstPage.header()->db.freelist;
-  if (freelist != 0)
+  if (page.buf.size() != m_pageSize)
   {
-    Page<> &next = getPage(freelist);
+    throw PageError(pageNum, "Page is not the size of the database's pages");
+  }
+  Frame &frame = fetch(pageNum, false);
+  frame.page = page;
+  modified(frame);
+}
 
-    if (next.header()->type == PageType::Freelist)
-    {
-      // update the head of the linked list
-      firstPage.header()->db.freelist = next.as<FreelistPage::Header>()->header()->next;
-      return freelist;
-    }
+void Pager::markDirty(PageId pageNum)
+{
+  modified(fetch(pageNum, true));
+}
 
+Page<FreelistPage::Header> *Pager::freelistHead()
+{
+  Page<FirstPage::Header> &firstPage = getPage<FirstPage::Header>(0);
+  const PageId head = firstPage.header()->db.freelist;
+  if (head == 0)
+  {
+    return nullptr;
+  }
+
+  Page<FreelistPage::Header> &trunk = getPage<FreelistPage::Header>(head);
+  if (trunk.header()->common.type != PageType::Freelist)
+  {
     // remove the bad free list pointer
     // TODO: we now could have dangling freelist pages
-    std::cerr << "Expected freelist page when updating freelist, instead saw " << next.header()->type << std::endl;
+    std::cerr << "Expected freelist page when updating freelist, instead saw "
+              << trunk.header()->common.type << std::endl;
     firstPage.header()->db.freelist = 0;
-    // continue to create a new page
+    return nullptr;
   }
+  return &trunk;
+}
 
-  // append to file instead
-  if (!m_stream.seekp(0, std::ios::end))
+Frame &Pager::allocate(PageId pageNum, PageType type)
+{
+  Frame &frame = fetch(pageNum, false);
+  frame.page.reset(type);
+  modified(frame);
+  return frame;
+}
+
+PageId Pager::nextFree(PageType type)
+{
+  std::lock_guard lock(m_mutex);
+  // check the free list, otherwise append to file
+  if (Page<FreelistPage::Header> *trunk = freelistHead())
   {
-    throw std::runtime_error("Failed to get file size for new page");
+    FreelistPage::Header *h = trunk->header();
+    PageId pageNum;
+    if (h->count > 0)
+    {
+      // the head trunk is used by every allocation so it stays cached, and the page we hand out
+      // never has to be read
+      pageNum = FreelistPage::ids(*trunk).back();
+      h->count--;
+    }
+    else
+    {
+      // hand out the empty trunk itself and move on to the next
+      Page<FirstPage::Header> &firstPage = getPage<FirstPage::Header>(0);
+      pageNum = firstPage.header()->db.freelist;
+      firstPage.header()->db.freelist = h->next;
+    }
+    allocate(pageNum, type);
+    return pageNum;
   }
-  m_fSize = m_stream.tellp();
-  PageId nextId = m_fSize / PAGE_SIZE;
-  Page<CommonHeader> newPage(type);
-  setPage(nextId, newPage);
-  flushPage(nextId, newPage); // write it to disk now
-  m_fSize += PAGE_SIZE; // the file size has increased
+
+  // append to file instead. the page is only written once it is evicted or flushed
+  reserveNext();
+  PageId nextId = static_cast<PageId>(m_fSize / m_pageSize);
+  allocate(nextId, type);
+  m_fSize += m_pageSize; // the file size has increased
   return nextId;
 }
 
+PageId Pager::nextFreeRun(u32 count, PageType type)
+{
+  return allocateRun(count, type, false);
+}
+
+PageId Pager::allocateRun(u32 count, PageType type, bool pin)
+{
+  std::lock_guard lock(m_mutex);
+  if (count <= 1)
+  {
+    const PageId id = nextFree(type);
+    if (pin)
+    {
+      m_pool.find(id)->pins++;
+    }
+    return id;
+  }
+
+  if (Page<FreelistPage::Header> *trunk = freelistHead())
+  {
+    // descending, so a run of adjacent pages is a run of ids each one less than the last
+    std::span<PageId> ids = FreelistPage::ids(*trunk);
+    std::size_t start = 0;
+    for (std::size_t i{1}; i < ids.size() && i - start + 1 <= count; ++i)
+    {
+      if (ids[i] + 1 != ids[i - 1])
+      {
+        start = i;
+      }
+      if (i - start + 1 == count)
+      {
+        const PageId first = ids[i];
+        std::copy(ids.begin() + i + 1, ids.end(), ids.begin() + start);
+        trunk->header()->count -= count;
+        for (PageId id = first; id < first + count; ++id)
+        {
+          allocate(id, type).pins += pin;
+        }
+        return first;
+      }
+    }
+  }
+
+  const PageId first = static_cast<PageId>(m_fSize / m_pageSize);
+  for (u32 i{0}; i < count; ++i)
+  {
+    reserveNext();
+    allocate(first + i, type).pins += pin;
+    m_fSize += m_pageSize;
+  }
+  return first;
+}
+
+void Pager::reserveNext()
+{
+  const u64 end = m_fSize + m_pageSize;
+  if (m_extentSize == 0 || end <= m_reserved)
+  {
+    return;
+  }
+
+  // reserve whole extents of whole pages
+  const u64 pages = std::max<u64>((m_extentSize + m_pageSize - 1) / m_pageSize, 1);
+  const u64 extent = pages * m_pageSize;
+  const u64 start = std::max<u64>(m_reserved, m_fSize);
+  const u64 reserved = (end + extent - 1) / extent * extent;
+  // when the storage can't reserve space the pages are simply written as they come
+  if (m_storage->reserve(start, reserved - start))
+  {
+    m_stats.extents++;
+  }
+  m_reserved = reserved;
+}
+
 void Pager::freePage(PageId pageNum)
 {
-  Page<FirstPage::Header> &firstPage = m_pages[0].as_ref<FirstPage::Header>();
-  Page<FreelistPage::Header> &page = getPage<FreelistPage::Header>(pageNum);
-  page.header()->common.type = Freelist;
+  std::lock_guard lock(m_mutex);
+  Page<FreelistPage::Header> *trunk = freelistHead();
+  if (trunk != nullptr && trunk->header()->count < FreelistPage::capacity(m_pageSize))
+  {
+    // keep the ids in descending order
+    trunk->header()->count++;
+    std::span<PageId> ids = FreelistPage::ids(*trunk);
+    auto at = std::upper_bound(ids.begin(), ids.end() - 1, pageNum, std::greater<PageId>());
+    std::copy_backward(at, ids.end() - 1, ids.end());
+    *at = pageNum;
+    return;
+  }
 
-  // update the linked list
+  // the page becomes the new head trunk, what was in it doesn't matter any more
+  Page<FirstPage::Header> &firstPage = getPage<FirstPage::Header>(0);
+  allocate(pageNum, PageType::Freelist);
+  Page<FreelistPage::Header> &page = getPage<FreelistPage::Header>(pageNum);
   page.header()->next = firstPage.header()->db.freelist;
   firstPage.header()->db.freelist = pageNum;
-  // TODO: do we need to flush these now?
-  // flushPage(pageNum, page);
-  // flushPage(0, firstPage);
+}
+
+bool Pager::truncate(PageId pageCount)
+{
+  // the checkpoint below waits for the redo threads, which can't finish while the pager is locked
+  waitForRecovery();
+  std::lock_guard lock(m_mutex);
+  const u64 size = static_cast<u64>(std::max<PageId>(pageCount, 1)) * m_pageSize;
+  if (size >= m_fSize)
+  {
+    return size == m_fSize;
+  }
+  if (m_wal != nullptr)
+  {
+    // a page past the new end must not come back from the log
+    checkpoint();
+    if (m_wal->size() != 0)
+    {
+      return false;
+    }
+  }
+
+  std::vector<Frame *> dropped;
+  bool pinned = false;
+  m_pool.forEach(
+      [&](Frame &frame)
+      {
+        if (static_cast<u64>(frame.id) * m_pageSize < size)
+          return;
+        pinned |= frame.pins > 0;
+        dropped.push_back(&frame);
+      });
+  // a guard reading a page in place would fault once the file no longer covers it
+  for (const auto &[id, view] : m_mapped)
+  {
+    pinned |= static_cast<u64>(id) * m_pageSize >= size && view.pins > 0;
+  }
+  if (pinned)
+  {
+    return false;
+  }
+  for (PageId id = static_cast<PageId>(size / m_pageSize); id < m_fSize / m_pageSize; ++id)
+  {
+    if (m_io != nullptr)
+    {
+      dropPrefetch(id);
+    }
+    m_mapped.erase(id);
+    m_readAhead.issued.erase(id);
+  }
+  if (m_storage->size() > size && !m_storage->truncate(size))
+  {
+    return false;
+  }
+
+  // whatever was in them is gone with the file
+  for (Frame *frame : dropped)
+  {
+    m_pool.erase(*frame);
+  }
+  m_knownGood.resize(std::min<std::size_t>(m_knownGood.size(), size / m_pageSize));
+  m_fSize = size;
+  m_reserved = std::min(m_reserved, size);
+  return true;
 }
@@ -3,25 +3,35 @@
 Page<BTreeHeader> &BTreeHeader::split(Pager &pager, PageId *retPageId)
 {
   // these are 1-indexed
-  const auto K = slots.entryCount(); // BTREE_ORDER;
+  const auto K = slots.entryCount(); // the order of the tree;
   const decltype(K) half = (K / 2) + (K & 1);
 
-  Page<BTreeHeader> &newPage = pager.fromNextFree<BTreeHeader>(this->common.type, retPageId);
-  newPage.header()->parent = this->parent;
-
-  // move the bottom half of this node to the new node
-  for (u16 i{0}; i < half; ++i)
+  PageId newPageId = 0;
   {
-    const Slot *s1 = slots.getSlot(0); // always read 0 as we pop it afterwards
-    const std::byte *c1 = slots.readCell(s1->cellOffset);
-    SlotNum s2Num = 0;
+    ExclusivePage<BTreeHeader> newPage = pager.pinNextFree<BTreeHeader>(this->common.type);
+    newPageId = newPage.id();
+    newPage.header()->parent = this->parent;
+
+    // move the bottom half of this node to the new node
+    for (u16 i{0}; i < half; ++i)
+    {
+      const Slot *s1 = slots.getSlot(0); // always read 0 as we pop it afterwards
+      const std::byte *c1 = slots.readCell(s1->cellOffset);
+      SlotNum s2Num = 0;
 
-    std::byte *c2 = reinterpret_cast<std::byte *>(
-        newPage.header()->slots.createNextSlotWithCell(s1->cellSize, &s2Num));
-    std::memcpy(c2, c1, s1->cellSize);
-    // TODO: we are doing memmove repeatedly here :(
-    slots.deleteSlot(static_cast<SlotNum>(0));
+      std::byte *c2 = reinterpret_cast<std::byte *>(
+          newPage.header()->slots.createNextSlotWithCell(s1->cellSize, &s2Num));
+      std::memcpy(c2, c1, s1->cellSize);
+      // TODO: we are doing memmove repeatedly here :(
+      slots.deleteSlot(static_cast<SlotNum>(0));
+    }
   }
+  // reclaim the space of the cells that moved
+  slots.compact(slotsSize(pager.pageSize()));
 
-  return newPage;
+  if (retPageId != nullptr)
+  {
+    *retPageId = newPageId;
+  }
+  return pager.getPage<BTreeHeader>(newPageId);
 }
@@ -0,0 +1,118 @@
+#include "database/pages/page.hpp"
+#include "database/checksum.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace
+{
+constexpr std::size_t CHECKSUM_OFFSET = offsetof(CommonHeader, checksum);
+constexpr std::size_t CHECKSUM_END = CHECKSUM_OFFSET + sizeof(CommonHeader::checksum);
+
+std::align_val_t alignmentFor(u32 size)
+{
+  return std::align_val_t{std::min(std::bit_ceil(size), PageBuffer::MAX_ALIGNMENT)};
+}
+
+std::byte *allocate(u32 size)
+{
+  return static_cast<std::byte *>(::operator new(size, alignmentFor(size)));
+}
+} // namespace
+
+PageBuffer::PageBuffer(u32 size) : PageBuffer(allocate(size), size, true)
+{
+}
+
+PageBuffer PageBuffer::view(std::byte *data, u32 size) noexcept
+{
+  return PageBuffer(data, size, false);
+}
+
+PageBuffer::~PageBuffer()
+{
+  free();
+}
+
+void PageBuffer::free() noexcept
+{
+  if (m_owned && m_data != nullptr)
+  {
+    ::operator delete(m_data, alignmentFor(m_size));
+  }
+  m_data = nullptr;
+}
+
+PageBuffer::PageBuffer(const PageBuffer &other) : PageBuffer(other.m_size)
+{
+  std::memcpy(m_data, other.m_data, m_size);
+}
+
+PageBuffer &PageBuffer::operator=(const PageBuffer &other)
+{
+  if (this == &other)
+  {
+    return *this;
+  }
+  if (m_size != other.m_size)
+  {
+    assert(m_owned && "A view cannot change size");
+    std::byte *data = allocate(other.m_size);
+    free();
+    m_data = data;
+    m_size = other.m_size;
+  }
+  std::memcpy(m_data, other.m_data, m_size);
+  return *this;
+}
+
+PageBuffer::PageBuffer(PageBuffer &&other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)), m_size(other.m_size), m_owned(other.m_owned)
+{
+}
+
+PageBuffer &PageBuffer::operator=(PageBuffer &&other)
+{
+  // a view stays where it is, so the bytes are copied into it instead
+  if (!m_owned || !other.m_owned)
+  {
+    return *this = static_cast<const PageBuffer &>(other);
+  }
+  std::swap(m_data, other.m_data);
+  std::swap(m_size, other.m_size);
+  return *this;
+}
+
+void PageBuffer::fill(std::byte value) noexcept
+{
+  std::memset(m_data, static_cast<int>(value), m_size);
+}
+
+bool operator==(const PageBuffer &a, const PageBuffer &b) noexcept
+{
+  return a.m_size == b.m_size && std::memcmp(a.m_data, b.m_data, a.m_size) == 0;
+}
+
+u32 pageChecksum(std::span<const std::byte> page) noexcept
+{
+  const u32 crc = crc32c(page.subspan(CHECKSUM_END), crc32c(page.first(CHECKSUM_OFFSET)));
+  return crc == 0 ? 1 : crc;
+}
+
+void sealPage(std::span<std::byte> page) noexcept
+{
+  const u32 crc = pageChecksum(page);
+  std::memcpy(page.data() + CHECKSUM_OFFSET, &crc, sizeof(crc));
+}
+
+bool verifyPage(std::span<const std::byte> page) noexcept
+{
+  u32 stored;
+  std::memcpy(&stored, page.data() + CHECKSUM_OFFSET, sizeof(stored));
+  return stored == pageChecksum(page);
+}
@@ -0,0 +1,569 @@
+#include "database/storage.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+StreamStorage::StreamStorage(std::iostream &stream) : m_stream(stream)
+{
+  if (!m_stream)
+  {
+    throw std::runtime_error("Failed to open database file.");
+  }
+
+  m_stream.seekg(0, std::ios::end);
+  m_size = m_stream.tellg();
+  if (!m_stream)
+  {
+    throw std::runtime_error("Failed to get size of database file.");
+  }
+}
+
+bool StreamStorage::read(u64 offset, std::span<std::byte> buf)
+{
+  std::lock_guard lock(m_mutex);
+  if (!m_stream.seekg(offset))
+  {
+    return false;
+  }
+  return static_cast<bool>(m_stream.read(reinterpret_cast<char *>(buf.data()), buf.size()));
+}
+
+bool StreamStorage::write(u64 offset, std::span<const std::byte> buf)
+{
+  std::lock_guard lock(m_mutex);
+  // streams can't seek past their end, so fill any gap with zeros first
+  if (offset > m_size)
+  {
+    static const std::array<char, 512> zeros = {0};
+    if (!m_stream.seekp(m_size))
+    {
+      return false;
+    }
+    while (m_size < offset)
+    {
+      const u64 n = std::min<u64>(zeros.size(), offset - m_size);
+      if (!m_stream.write(zeros.data(), n))
+      {
+        return false;
+      }
+      m_size += n;
+    }
+  }
+
+  if (!m_stream.seekp(offset))
+  {
+    return false;
+  }
+  if (!m_stream.write(reinterpret_cast<const char *>(buf.data()), buf.size()))
+  {
+    return false;
+  }
+  m_size = std::max(m_size, offset + buf.size());
+  return true;
+}
+
+bool StreamStorage::sync()
+{
+  std::lock_guard lock(m_mutex);
+  return static_cast<bool>(m_stream.flush());
+}
+
+#ifndef _WIN32
+namespace
+{
+// used when the file system can't tell us its direct I/O alignment
+constexpr u32 FALLBACK_ALIGNMENT = 4096;
+
+struct AlignedDelete
+{
+  std::align_val_t alignment;
+  void operator()(std::byte *p) const noexcept { ::operator delete(p, alignment); }
+};
+using AlignedBuffer = std::unique_ptr<std::byte[], AlignedDelete>;
+
+AlignedBuffer allocateAligned(std::size_t length, u32 alignment)
+{
+  const std::align_val_t a{alignment};
+  return AlignedBuffer(static_cast<std::byte *>(::operator new(length, a)), AlignedDelete{a});
+}
+
+/* read until the buffer is full or the file ends. returns how much was read, or -1 on error */
+ssize_t preadAll(int fd, std::byte *buf, std::size_t length, u64 offset)
+{
+  std::size_t done = 0;
+  while (done < length)
+  {
+    const ssize_t n = ::pread(fd, buf + done, length - done, offset + done);
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n < 0)
+    {
+      return -1;
+    }
+    if (n == 0)
+    {
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+bool pwriteAll(int fd, const std::byte *buf, std::size_t length, u64 offset)
+{
+  std::size_t done = 0;
+  while (done < length)
+  {
+    const ssize_t n = ::pwrite(fd, buf + done, length - done, offset + done);
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
+
+/* write every buffer, carrying on from wherever a short write stopped */
+bool pwritevAll(int fd, std::vector<iovec> iov, u64 offset)
+{
+  std::size_t first = 0;
+  while (first < iov.size())
+  {
+    const int count = static_cast<int>(std::min<std::size_t>(iov.size() - first, IOV_MAX));
+    ssize_t n = ::pwritev(fd, iov.data() + first, count, offset);
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      return false;
+    }
+    offset += n;
+    // skip the buffers that were written and trim the one that was cut short
+    while (first < iov.size() && static_cast<std::size_t>(n) >= iov[first].iov_len)
+    {
+      n -= iov[first].iov_len;
+      ++first;
+    }
+    if (n > 0)
+    {
+      iov[first].iov_base = static_cast<std::byte *>(iov[first].iov_base) + n;
+      iov[first].iov_len -= n;
+    }
+  }
+  return true;
+}
+
+/* allocate the blocks for a range, keeping the file size as it is */
+bool allocateKeepSize(int fd, u64 offset, u64 length)
+{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+  return ::fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, length) == 0;
+#else
+  UNUSED(fd);
+  UNUSED(offset);
+  UNUSED(length);
+  return false;
+#endif
+}
+
+u32 directAlignment(int fd)
+{
+#if defined(__linux__) && defined(STATX_DIOALIGN)
+  struct statx stx;
+  if (::statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN) &&
+      stx.stx_dio_offset_align > 0)
+  {
+    return std::max(stx.stx_dio_offset_align, stx.stx_dio_mem_align);
+  }
+#endif
+  UNUSED(fd);
+  return FALLBACK_ALIGNMENT;
+}
+} // namespace
+
+FileStorage::FileStorage(const std::filesystem::path &path, bool direct) : m_direct(direct)
+{
+  int flags = O_RDWR | O_CREAT;
+#ifdef O_DIRECT
+  if (direct)
+  {
+    flags |= O_DIRECT;
+  }
+#endif
+  m_fd = ::open(path.c_str(), flags, 0644);
+  if (m_fd < 0)
+  {
+    if (direct && errno == EINVAL)
+    {
+      throw std::runtime_error("The file system does not support direct I/O.");
+    }
+    throw std::runtime_error("Failed to open database file.");
+  }
+
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+  if (direct && ::fcntl(m_fd, F_NOCACHE, 1) != 0)
+  {
+    ::close(m_fd);
+    throw std::runtime_error("The file system does not support direct I/O.");
+  }
+#endif
+
+  struct stat st;
+  if (::fstat(m_fd, &st) != 0)
+  {
+    ::close(m_fd);
+    throw std::runtime_error("Failed to get size of database file.");
+  }
+  m_size = st.st_size;
+
+  if (direct)
+  {
+    m_alignment = directAlignment(m_fd);
+  }
+}
+
+FileStorage::~FileStorage()
+{
+  ::close(m_fd);
+}
+
+bool FileStorage::aligned(u64 offset, const std::byte *buf, std::size_t length) const noexcept
+{
+  return offset % m_alignment == 0 && length % m_alignment == 0 &&
+         reinterpret_cast<std::uintptr_t>(buf) % m_alignment == 0;
+}
+
+bool FileStorage::read(u64 offset, std::span<std::byte> buf)
+{
+  if (!aligned(offset, buf.data(), buf.size()))
+  {
+    return readUnaligned(offset, buf);
+  }
+  return preadAll(m_fd, buf.data(), buf.size(), offset) == static_cast<ssize_t>(buf.size());
+}
+
+bool FileStorage::write(u64 offset, std::span<const std::byte> buf)
+{
+  if (!aligned(offset, buf.data(), buf.size()))
+  {
+    return writeUnaligned(offset, buf);
+  }
+  if (!pwriteAll(m_fd, buf.data(), buf.size(), offset))
+  {
+    return false;
+  }
+  grow(offset + buf.size());
+  return true;
+}
+
+bool FileStorage::writev(u64 offset, std::span<const std::span<const std::byte>> bufs)
+{
+  std::vector<iovec> iov;
+  iov.reserve(bufs.size());
+  u64 end = offset;
+  for (const auto &buf : bufs)
+  {
+    if (!aligned(end, buf.data(), buf.size()))
+    {
+      return Storage::writev(offset, bufs);
+    }
+    iov.push_back({const_cast<std::byte *>(buf.data()), buf.size()});
+    end += buf.size();
+  }
+
+  if (!pwritevAll(m_fd, std::move(iov), offset))
+  {
+    return false;
+  }
+  grow(end);
+  return true;
+}
+
+bool FileStorage::readUnaligned(u64 offset, std::span<std::byte> buf)
+{
+  const u64 start = offset - offset % m_alignment;
+  const u64 end = (offset + buf.size() + m_alignment - 1) / m_alignment * m_alignment;
+  AlignedBuffer block = allocateAligned(end - start, m_alignment);
+
+  // the last block may be cut short by the end of the file
+  const ssize_t n = preadAll(m_fd, block.get(), end - start, start);
+  if (n < 0 || static_cast<u64>(n) < offset - start + buf.size())
+  {
+    return false;
+  }
+  std::memcpy(buf.data(), block.get() + (offset - start), buf.size());
+  return true;
+}
+
+bool FileStorage::writeUnaligned(u64 offset, std::span<const std::byte> buf)
+{
+  std::lock_guard lock(m_unalignedMutex);
+  const u64 start = offset - offset % m_alignment;
+  const u64 end = (offset + buf.size() + m_alignment - 1) / m_alignment * m_alignment;
+  AlignedBuffer block = allocateAligned(end - start, m_alignment);
+
+  const ssize_t n = preadAll(m_fd, block.get(), end - start, start);
+  if (n < 0)
+  {
+    return false;
+  }
+  std::memset(block.get() + n, 0, end - start - n);
+  std::memcpy(block.get() + (offset - start), buf.data(), buf.size());
+  if (!pwriteAll(m_fd, block.get(), end - start, start))
+  {
+    return false;
+  }
+
+  // writing whole blocks may have gone past the end, which is not part of the file
+  const u64 size = std::max<u64>(m_size, offset + buf.size());
+  if (end > size && ::ftruncate(m_fd, size) != 0)
+  {
+    return false;
+  }
+  grow(size);
+  return true;
+}
+
+void FileStorage::grow(u64 end)
+{
+  u64 size = m_size;
+  while (size < end && !m_size.compare_exchange_weak(size, end))
+  {
+  }
+}
+
+void FileStorage::didWrite(u64 offset, std::size_t length)
+{
+  grow(offset + length);
+}
+
+bool FileStorage::sync()
+{
+#ifdef __linux__
+  return ::fdatasync(m_fd) == 0;
+#else
+  return ::fsync(m_fd) == 0;
+#endif
+}
+
+bool FileStorage::truncate(u64 size)
+{
+  if (::ftruncate(m_fd, size) != 0)
+  {
+    return false;
+  }
+  m_size = size;
+  return true;
+}
+
+bool FileStorage::reserve(u64 offset, u64 length)
+{
+  return allocateKeepSize(m_fd, offset, length);
+}
+
+void FileStorage::advise(u64 offset, std::size_t length, Access access)
+{
+#ifdef POSIX_FADV_NORMAL
+  // direct I/O does not go through the page cache, so there is nothing to hint
+  if (m_direct)
+  {
+    return;
+  }
+
+  int advice = POSIX_FADV_NORMAL;
+  switch (access)
+  {
+  case Access::Normal:
+    advice = POSIX_FADV_NORMAL;
+    break;
+  case Access::Sequential:
+    advice = POSIX_FADV_SEQUENTIAL;
+    break;
+  case Access::Random:
+    advice = POSIX_FADV_RANDOM;
+    break;
+  case Access::WillNeed:
+    advice = POSIX_FADV_WILLNEED;
+    break;
+  }
+  // only a hint, there is nothing to do if it is refused
+  UNUSED(::posix_fadvise(m_fd, offset, length, advice));
+#else
+  UNUSED(offset);
+  UNUSED(length);
+  UNUSED(access);
+#endif
+}
+
+MmapStorage::MmapStorage(const std::filesystem::path &path, u64 mapSize) : m_mapSize(mapSize)
+{
+  m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (m_fd < 0)
+  {
+    throw std::runtime_error("Failed to open database file.");
+  }
+
+  struct stat st;
+  if (::fstat(m_fd, &st) != 0)
+  {
+    ::close(m_fd);
+    throw std::runtime_error("Failed to get size of database file.");
+  }
+  m_size = st.st_size;
+  if (m_size > m_mapSize)
+  {
+    ::close(m_fd);
+    throw std::runtime_error("Database file is larger than the map size.");
+  }
+
+  // the mapping can extend past the end of the file, we only touch what has been written
+  void *p = ::mmap(nullptr, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (p == MAP_FAILED)
+  {
+    ::close(m_fd);
+    throw std::runtime_error("Failed to map database file.");
+  }
+  m_map = static_cast<std::byte *>(p);
+
+  // most accesses are point lookups through the interior nodes
+  advise(0, m_mapSize, Access::Random);
+}
+
+MmapStorage::~MmapStorage()
+{
+  ::munmap(m_map, m_mapSize);
+  ::close(m_fd);
+}
+
+bool MmapStorage::read(u64 offset, std::span<std::byte> buf)
+{
+  if (offset + buf.size() > m_size)
+  {
+    return false;
+  }
+  std::memcpy(buf.data(), m_map + offset, buf.size());
+  return true;
+}
+
+bool MmapStorage::write(u64 offset, std::span<const std::byte> buf)
+{
+  const u64 end = offset + buf.size();
+  if (end > m_mapSize)
+  {
+    return false;
+  }
+  if (end > m_size)
+  {
+    std::lock_guard lock(m_growMutex);
+    if (end > m_size && ::ftruncate(m_fd, end) != 0)
+    {
+      return false;
+    }
+    grow(end);
+  }
+  std::memcpy(m_map + offset, buf.data(), buf.size());
+  return true;
+}
+
+void MmapStorage::grow(u64 end)
+{
+  u64 size = m_size;
+  while (size < end && !m_size.compare_exchange_weak(size, end))
+  {
+  }
+}
+
+void MmapStorage::didWrite(u64 offset, std::size_t length)
+{
+  // the file was extended by the write itself
+  grow(std::min(offset + length, m_mapSize));
+}
+
+bool MmapStorage::sync()
+{
+  return ::msync(m_map, m_size, MS_SYNC) == 0;
+}
+
+bool MmapStorage::truncate(u64 size)
+{
+  std::lock_guard lock(m_growMutex);
+  // the mapping stays, pages past the end just can't be touched until the file grows again
+  if (::ftruncate(m_fd, size) != 0)
+  {
+    return false;
+  }
+  m_size = size;
+  return true;
+}
+
+bool MmapStorage::reserve(u64 offset, u64 length)
+{
+  // growing into reserved blocks can't fail for lack of space while writing to the mapping
+  return allocateKeepSize(m_fd, offset, std::min(offset + length, m_mapSize) - offset);
+}
+
+const std::byte *MmapStorage::map(u64 offset, std::size_t length)
+{
+  if (offset + length > m_size)
+  {
+    return nullptr;
+  }
+  return m_map + offset;
+}
+
+void MmapStorage::advise(u64 offset, std::size_t length, Access access)
+{
+  int advice = MADV_NORMAL;
+  switch (access)
+  {
+  case Access::Normal:
+    advice = MADV_NORMAL;
+    break;
+  case Access::Sequential:
+    advice = MADV_SEQUENTIAL;
+    break;
+  case Access::Random:
+    advice = MADV_RANDOM;
+    break;
+  case Access::WillNeed:
+    advice = MADV_WILLNEED;
+    break;
+  }
+
+  // madvise wants the start aligned to the system page
+  static const u64 systemPage = ::sysconf(_SC_PAGESIZE);
+  const u64 start = offset - (offset % systemPage);
+  const u64 end = std::min(offset + length, m_mapSize);
+  if (start >= end)
+  {
+    return;
+  }
+  // only a hint, there is nothing to do if it is refused
+  UNUSED(::madvise(m_map + start, end - start, advice));
+}
+#endif
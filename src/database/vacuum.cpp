@@ -0,0 +1,287 @@
+#include "database/vacuum.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+// every interior cell starts with its child, whatever the key type
+PageId &childOf(Page<BTreeHeader> &page, SlotNum slot)
+{
+  SlotHeader &slots = page.header()->slots;
+  return *reinterpret_cast<PageId *>(slots.getCell(slots.getSlot(slot)->cellOffset));
+}
+} // namespace
+
+Vacuum::Vacuum(Pager &pager, PageId root) : m_pager(pager), m_rootId(root)
+{
+  plan();
+}
+
+PageId Vacuum::root() const noexcept
+{
+  return m_nodes.empty() ? m_rootId : m_nodes[m_root].at;
+}
+
+u32 Vacuum::walkTree(PageId id, std::optional<u32> parent, SlotNum slot,
+                     std::vector<u32> &interiors, std::vector<u32> &leaves)
+{
+  const u32 node = static_cast<u32>(m_nodes.size());
+  std::vector<PageId> children;
+  {
+    const Page<BTreeHeader> &page = m_pager.readPage<BTreeHeader>(id);
+    const bool leaf = page.header()->isLeaf();
+    m_nodes.push_back(
+        {.role = leaf ? Role::Leaf : Role::Interior, .at = id, .parent = parent, .slot = slot});
+    if (!leaf)
+    {
+      const SlotHeader &slots = page.header()->slots;
+      for (const Slot &s : slots)
+      {
+        children.push_back(*reinterpret_cast<const PageId *>(slots.readCell(s.cellOffset)));
+      }
+    }
+  }
+  m_at[id] = node;
+
+  if (m_nodes[node].role == Role::Leaf)
+  {
+    leaves.push_back(node);
+    return node;
+  }
+  interiors.push_back(node);
+  for (SlotNum i{0}; i < children.size(); ++i)
+  {
+    const u32 child = walkTree(children[i], node, i, interiors, leaves);
+    m_nodes[node].children.push_back(child);
+  }
+  return node;
+}
+
+void Vacuum::walkFreelist()
+{
+  std::optional<u32> prev;
+  PageId id = m_pager.readPage<FirstPage::Header>(0).header()->db.freelist;
+  while (id != 0)
+  {
+    const u32 trunk = static_cast<u32>(m_nodes.size());
+    m_nodes.push_back({.role = Role::Trunk, .at = id});
+    m_nodes[trunk].prev = prev;
+    if (prev.has_value())
+    {
+      m_nodes[*prev].next = trunk;
+    }
+    m_at[id] = trunk;
+    prev = trunk;
+
+    const Page<FreelistPage::Header> &page = m_pager.readPage<FreelistPage::Header>(id);
+    const PageId next = page.header()->next;
+    for (PageId free : FreelistPage::ids(page))
+    {
+      m_at[free] = static_cast<u32>(m_nodes.size());
+      m_nodes.push_back({.role = Role::Free, .at = free, .trunk = trunk});
+    }
+    id = next;
+  }
+}
+
+void Vacuum::plan()
+{
+  const PageId root = this->root();
+  m_nodes.clear();
+  m_at.clear();
+  m_placed = 0;
+
+  std::vector<u32> interiors, leaves;
+  m_root = walkTree(root, std::nullopt, 0, interiors, leaves);
+  for (std::size_t i{1}; i < leaves.size(); ++i)
+  {
+    m_nodes[leaves[i - 1]].next = leaves[i];
+    m_nodes[leaves[i]].prev = leaves[i - 1];
+  }
+  walkFreelist();
+
+  m_order = std::move(interiors);
+  m_order.insert(m_order.end(), leaves.begin(), leaves.end());
+  // fill the file from the start, stepping over the first page and any page we don't know
+  m_targets.clear();
+  for (PageId id{1}; m_targets.size() < m_order.size(); ++id)
+  {
+    if (m_at.count(id) > 0)
+    {
+      m_targets.push_back(id);
+    }
+  }
+
+  m_stats.plans++;
+  m_changes = m_pager.changes();
+}
+
+bool Vacuum::step(u32 maxMoves)
+{
+  if (m_done)
+  {
+    return true;
+  }
+  if (m_pager.changes() != m_changes)
+  {
+    plan();
+  }
+
+  for (u32 moves{0}; moves < maxMoves && m_placed < m_order.size(); ++m_placed)
+  {
+    const u32 node = m_order[m_placed];
+    if (m_nodes[node].at != m_targets[m_placed])
+    {
+      swap(node, m_targets[m_placed]);
+      moves++;
+      // uncommitted pages can't be evicted, so a step could otherwise fill the cache
+      if (m_pager.wal() != nullptr)
+      {
+        UNUSED(m_pager.commit());
+      }
+    }
+  }
+  if (m_placed == m_order.size())
+  {
+    finish();
+  }
+  m_changes = m_pager.changes();
+  return m_done;
+}
+
+void Vacuum::swap(u32 node, PageId target)
+{
+  const PageId from = m_nodes[node].at;
+  const u32 other = m_at.at(target);
+
+  const Page<> moving = m_pager.readPage(from);
+  const Page<> displaced = m_pager.readPage(target);
+  m_pager.setPage(target, moving);
+  m_pager.setPage(from, displaced);
+
+  m_nodes[node].at = target;
+  m_nodes[other].at = from;
+  m_at[target] = node;
+  m_at[from] = other;
+  relink(node, from);
+  relink(other, target);
+  m_stats.moves++;
+}
+
+void Vacuum::relink(u32 id, PageId from)
+{
+  const Node &node = m_nodes[id];
+  switch (node.role)
+  {
+  case Role::Interior:
+  case Role::Leaf:
+    if (node.parent.has_value())
+    {
+      childOf(m_pager.getPage<BTreeHeader>(m_nodes[*node.parent].at), node.slot) = node.at;
+    }
+    m_pager.getPage<BTreeHeader>(node.at).header()->parent =
+        node.parent.has_value() ? m_nodes[*node.parent].at : 0;
+    for (u32 child : node.children)
+    {
+      m_pager.getPage<BTreeHeader>(m_nodes[child].at).header()->parent = node.at;
+    }
+    if (node.role == Role::Leaf)
+    {
+      if (node.prev.has_value())
+      {
+        LeafNode(m_pager.getPage<BTreeHeader>(m_nodes[*node.prev].at)).setSibling(node.at);
+      }
+      if (node.next.has_value())
+      {
+        LeafNode(m_pager.getPage<BTreeHeader>(m_nodes[*node.next].at)).setPrev(node.at);
+      }
+      LeafNode leaf(m_pager.getPage<BTreeHeader>(node.at));
+      leaf.setSibling(node.next.has_value() ? m_nodes[*node.next].at : 0);
+      leaf.setPrev(node.prev.has_value() ? m_nodes[*node.prev].at : 0);
+    }
+    break;
+  case Role::Trunk:
+    if (node.prev.has_value())
+    {
+      m_pager.getPage<FreelistPage::Header>(m_nodes[*node.prev].at).header()->next = node.at;
+    }
+    else
+    {
+      m_pager.getPage<FirstPage::Header>(0).header()->db.freelist = node.at;
+    }
+    break;
+  case Role::Free:
+  {
+    std::span<PageId> ids =
+        FreelistPage::ids(m_pager.getPage<FreelistPage::Header>(m_nodes[node.trunk].at));
+    std::replace(ids.begin(), ids.end(), from, node.at);
+    std::sort(ids.begin(), ids.end(), std::greater<PageId>());
+    break;
+  }
+  }
+}
+
+void Vacuum::finish()
+{
+  // links that were already wrong before we started, e.g. a sibling chain broken by a split
+  for (u32 id : m_order)
+  {
+    const Node &node = m_nodes[id];
+    const Page<> &page = m_pager.readPage(node.at);
+    const PageId parent = node.parent.has_value() ? m_nodes[*node.parent].at : 0;
+    const PageId sibling = node.next.has_value() ? m_nodes[*node.next].at : 0;
+    const PageId prev = node.prev.has_value() ? m_nodes[*node.prev].at : 0;
+    if (reinterpret_cast<const BTreeHeader *>(page.buf.data())->parent != parent ||
+        (node.role == Role::Leaf &&
+         (LeafNode::siblingOf(page) != sibling || LeafNode::prevOf(page) != prev)))
+    {
+      relink(id, node.at);
+    }
+  }
+
+  // the file has to keep the tree and any page we don't know about
+  const PageId pages = static_cast<PageId>(m_pager.fsize() / m_pager.pageSize());
+  PageId end = m_targets.empty() ? 1 : m_targets.back() + 1;
+  for (PageId id = end; id < pages; ++id)
+  {
+    if (m_at.count(id) == 0)
+    {
+      end = id + 1;
+    }
+  }
+
+  std::vector<PageId> kept, dropped;
+  for (const Node &node : m_nodes)
+  {
+    if (node.role == Role::Trunk || node.role == Role::Free)
+    {
+      (node.at < end ? kept : dropped).push_back(node.at);
+    }
+  }
+
+  // rebuild the free list from what is left below the end, the highest page becoming the trunk
+  m_pager.getPage<FirstPage::Header>(0).header()->db.freelist = 0;
+  std::sort(kept.begin(), kept.end(), std::greater<PageId>());
+  for (PageId id : kept)
+  {
+    m_pager.freePage(id);
+  }
+  if (m_pager.wal() != nullptr)
+  {
+    UNUSED(m_pager.commit());
+  }
+  if (m_pager.truncate(end))
+  {
+    m_stats.dropped += pages - end;
+  }
+  else
+  {
+    std::sort(dropped.begin(), dropped.end(), std::greater<PageId>());
+    for (PageId id : dropped)
+    {
+      m_pager.freePage(id);
+    }
+  }
+  m_done = true;
+}
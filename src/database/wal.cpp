@@ -0,0 +1,291 @@
+#include "database/wal.hpp"
+#include "database/checksum.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+u32 recordChecksum(Wal::RecordHeader header, std::span<const std::byte> data)
+{
+  header.checksum = 0;
+  return crc32c(data, crc32c(std::as_bytes(std::span(&header, 1))));
+}
+} // namespace
+
+Wal::Wal(std::unique_ptr<Storage> log, u32 pageSize) : m_log(std::move(log)), m_pageSize(pageSize)
+{
+  FileHeader header;
+  if (m_log->size() < sizeof(FileHeader))
+  {
+    // a new log, lsns start where the first record is so they are offsets until the first reset
+    m_start = sizeof(FileHeader);
+    writeHeader();
+  }
+  else
+  {
+    if (!m_log->read(0, std::as_writable_bytes(std::span(&header, 1))))
+    {
+      throw std::runtime_error("Failed to read the log header.");
+    }
+    if (header.magic != FileHeader::MAGIC)
+    {
+      throw std::runtime_error("Not a write-ahead log.");
+    }
+    if (header.pageSize != m_pageSize)
+    {
+      throw std::runtime_error("The log is for a different page size.");
+    }
+    m_start = header.start;
+  }
+  m_end = m_written = m_stored = m_durable = m_start;
+}
+
+void Wal::writeHeader(bool sync)
+{
+  FileHeader header;
+  header.pageSize = m_pageSize;
+  header.start = m_start;
+  if (!m_log->write(0, std::as_bytes(std::span(&header, 1))) || (sync && !m_log->sync()))
+  {
+    throw std::runtime_error("Failed to write the log header.");
+  }
+}
+
+Lsn Wal::appendLocked(RecordType type, PageId pageNum, std::span<const std::byte> data)
+{
+  RecordHeader header{type, static_cast<u32>(data.size()), m_end, pageNum, 0};
+  header.checksum = recordChecksum(header, data);
+
+  const auto bytes = std::as_bytes(std::span(&header, 1));
+  m_buffer.insert(m_buffer.end(), bytes.begin(), bytes.end());
+  m_buffer.insert(m_buffer.end(), data.begin(), data.end());
+  m_end += bytes.size() + data.size();
+  return m_end;
+}
+
+Lsn Wal::append(PageId pageNum, std::span<const std::byte> image)
+{
+  std::lock_guard lock(m_mutex);
+  m_stats.records++;
+  return appendLocked(RecordType::PageImage, pageNum, image);
+}
+
+Lsn Wal::appendDelta(PageId pageNum, std::span<const std::byte> delta)
+{
+  std::lock_guard lock(m_mutex);
+  m_stats.records++;
+  m_stats.deltas++;
+  return appendLocked(RecordType::PageDelta, pageNum, delta);
+}
+
+Lsn Wal::commit()
+{
+  std::lock_guard lock(m_mutex);
+  m_stats.commits++;
+  return appendLocked(RecordType::Commit, 0, {});
+}
+
+void Wal::flush(Lsn lsn, bool sync)
+{
+  std::unique_lock lock(m_mutex);
+  while ((sync ? m_durable : m_stored) < lsn)
+  {
+    if (m_flushing)
+    {
+      // the sync in progress may not cover us, but the next one will
+      m_flushed.wait(lock);
+      continue;
+    }
+
+    // take everything appended so far, including other threads' commits
+    m_flushing = true;
+    const std::vector<std::byte> buf = std::exchange(m_buffer, {});
+    const u64 at = offset(m_written);
+    const Lsn end = m_end;
+    m_written = end;
+
+    lock.unlock();
+    // a sync may only be needed for records an earlier flush wrote without one
+    const bool ok = (buf.empty() || m_log->write(at, buf)) && (!sync || m_log->sync());
+    lock.lock();
+
+    m_flushing = false;
+    m_flushed.notify_all();
+    if (!ok)
+    {
+      throw std::runtime_error("Failed to write the log.");
+    }
+    m_stored = end;
+    if (sync)
+    {
+      m_durable = end;
+      m_stats.syncs++;
+    }
+    m_stats.bytes += buf.size();
+  }
+}
+
+Lsn Wal::end()
+{
+  std::lock_guard lock(m_mutex);
+  return m_end;
+}
+
+u64 Wal::size()
+{
+  std::lock_guard lock(m_mutex);
+  return m_end - m_start;
+}
+
+Lsn Wal::durable()
+{
+  std::lock_guard lock(m_mutex);
+  return m_durable;
+}
+
+bool Wal::readRecord(Lsn lsn, RecordHeader &header, std::vector<std::byte> &data) const
+{
+  const u64 at = offset(lsn);
+  if (at + sizeof(RecordHeader) > m_log->size() ||
+      !m_log->read(at, std::as_writable_bytes(std::span(&header, 1))))
+  {
+    return false;
+  }
+  // stale records from before the last reset have older lsns
+  if (header.lsn != lsn || at + sizeof(RecordHeader) + header.length > m_log->size())
+  {
+    return false;
+  }
+  switch (header.type)
+  {
+  case RecordType::PageImage:
+    if (header.length != m_pageSize)
+      return false;
+    break;
+  case RecordType::Commit:
+    if (header.length != 0)
+      return false;
+    break;
+  case RecordType::PageDelta:
+    // a delta is only logged when it is smaller than the page
+    if (header.length == 0 || header.length >= m_pageSize)
+      return false;
+    break;
+  default:
+    return false;
+  }
+  data.resize(header.length);
+  if (!m_log->read(at + sizeof(RecordHeader), data))
+  {
+    return false;
+  }
+  return header.checksum == recordChecksum(header, data);
+}
+
+std::vector<Wal::RecordRef> Wal::recover()
+{
+  std::lock_guard lock(m_mutex);
+  RecordHeader header;
+  std::vector<std::byte> data;
+
+  // anything after the last commit never happened
+  std::vector<RecordRef> records;
+  std::size_t committedRecords = 0;
+  Lsn committed = m_start;
+  for (Lsn lsn = m_start; readRecord(lsn, header, data); lsn += sizeof(header) + header.length)
+  {
+    if (header.type == RecordType::Commit)
+    {
+      committed = lsn + sizeof(header);
+      committedRecords = records.size();
+    }
+    else
+    {
+      records.push_back({lsn, header.page});
+    }
+  }
+  records.resize(committedRecords);
+
+  m_buffer.clear();
+  m_end = m_written = m_stored = m_durable = committed;
+  return records;
+}
+
+void Wal::redo(Lsn lsn, std::span<std::byte> page)
+{
+  RecordHeader header;
+  std::vector<std::byte> data;
+  if (!readRecord(lsn, header, data) || header.type == RecordType::Commit)
+  {
+    throw std::runtime_error("Failed to reread the log.");
+  }
+  if (header.type == RecordType::PageImage)
+  {
+    std::copy(data.begin(), data.end(), page.begin());
+  }
+  else if (!patch(page, data))
+  {
+    throw std::runtime_error("Malformed delta in the log.");
+  }
+}
+
+std::vector<std::byte> Wal::diff(std::span<const std::byte> before,
+                                 std::span<const std::byte> after)
+{
+  std::vector<std::byte> delta;
+  const std::size_t size = std::min(before.size(), after.size());
+  std::size_t i = 0;
+  while (i < size)
+  {
+    if (before[i] == after[i])
+    {
+      ++i;
+      continue;
+    }
+    // a gap shorter than a run header is cheaper to send than to start a new run after
+    std::size_t last = i;
+    for (std::size_t j = i + 1; j < size && j - last <= sizeof(DeltaRun); ++j)
+    {
+      if (before[j] != after[j])
+        last = j;
+    }
+    const DeltaRun run{static_cast<u32>(i), static_cast<u32>(last + 1 - i)};
+    const auto bytes = std::as_bytes(std::span(&run, 1));
+    delta.insert(delta.end(), bytes.begin(), bytes.end());
+    delta.insert(delta.end(), after.begin() + i, after.begin() + last + 1);
+    i = last + 1;
+  }
+  return delta;
+}
+
+bool Wal::patch(std::span<std::byte> page, std::span<const std::byte> delta)
+{
+  std::size_t at = 0;
+  while (at < delta.size())
+  {
+    DeltaRun run;
+    if (delta.size() - at < sizeof(run))
+      return false;
+    std::memcpy(&run, delta.data() + at, sizeof(run));
+    at += sizeof(run);
+    if (run.length > delta.size() - at || run.offset > page.size() ||
+        run.length > page.size() - run.offset)
+      return false;
+    std::memcpy(page.data() + run.offset, delta.data() + at, run.length);
+    at += run.length;
+  }
+  return true;
+}
+
+void Wal::reset(bool sync)
+{
+  std::unique_lock lock(m_mutex);
+  m_flushed.wait(lock, [this] { return !m_flushing; });
+  m_buffer.clear();
+  m_start = m_end;
+  m_written = m_stored = m_durable = m_end;
+  writeHeader(sync);
+}
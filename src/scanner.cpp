@@ -1,5 +1,6 @@
 #include "scanner.hpp"
 #include <string>
+#include <tuple>
 
 char Scanner::get() noexcept
 {
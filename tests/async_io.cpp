@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include "database_fixture.hpp"
+#include "database/database.hpp"
+#include "database/pages/btree.hpp"
+
+namespace
+{
+std::vector<std::byte> pattern(std::size_t n, u8 seed)
+{
+  std::vector<std::byte> data(n);
+  for (std::size_t i{0}; i < n; ++i)
+  {
+    data[i] = static_cast<std::byte>(seed + i);
+  }
+  return data;
+}
+
+/* write a batch of pages and read them back in another batch */
+void roundTrip(AsyncIO &io, std::size_t pages)
+{
+  std::vector<std::vector<std::byte>> written;
+  std::vector<AsyncIO::Ticket> tickets;
+  for (std::size_t i{0}; i < pages; ++i)
+  {
+    written.push_back(pattern(DEFAULT_PAGE_SIZE, static_cast<u8>(i)));
+    tickets.push_back(
+        io.enqueue({IORequest::Kind::Write, i * DEFAULT_PAGE_SIZE, written.back().data(), DEFAULT_PAGE_SIZE}));
+  }
+  io.submit();
+  for (auto t : tickets)
+  {
+    ASSERT_TRUE(io.wait(t));
+  }
+
+  std::vector<std::vector<std::byte>> read(pages, std::vector<std::byte>(DEFAULT_PAGE_SIZE));
+  tickets.clear();
+  for (std::size_t i{0}; i < pages; ++i)
+  {
+    tickets.push_back(io.enqueue({IORequest::Kind::Read, i * DEFAULT_PAGE_SIZE, read[i].data(), DEFAULT_PAGE_SIZE}));
+  }
+  for (auto t : tickets)
+  {
+    ASSERT_TRUE(io.wait(t));
+  }
+  EXPECT_EQ(written, read);
+
+  // a ticket that was already waited on, or never handed out, has nothing to wait for
+  EXPECT_FALSE(io.wait(tickets.back()));
+  EXPECT_FALSE(io.wait(tickets.back() + 1000));
+
+  // reading past the end is a short read
+  std::vector<std::byte> past(DEFAULT_PAGE_SIZE);
+  EXPECT_FALSE(io.wait(io.enqueue({IORequest::Kind::Read, pages * DEFAULT_PAGE_SIZE, past.data(), DEFAULT_PAGE_SIZE})));
+}
+} // namespace
+
+TEST(AsyncIO, ThreadPool)
+{
+  std::stringstream ss;
+  StreamStorage storage(ss);
+  ThreadPoolIO io(storage);
+  roundTrip(io, 16);
+  EXPECT_EQ(16 * DEFAULT_PAGE_SIZE, storage.size());
+}
+
+/* more requests than ring entries, and the storage is told about the writes */
+TEST_F(TempFileFixture, AsyncIOUring)
+{
+  MmapStorage storage(path);
+  auto io = AsyncIO::create(storage, 8);
+  if (dynamic_cast<UringIO *>(io.get()) == nullptr)
+  {
+    GTEST_SKIP() << "io_uring is not available";
+  }
+  roundTrip(*io, 20);
+  EXPECT_EQ(20 * DEFAULT_PAGE_SIZE, storage.size());
+
+  // a read that runs into the end of the file is carried on past what the kernel did read, then
+  // fails when there is nothing more
+  std::vector<std::byte> across(DEFAULT_PAGE_SIZE);
+  const u64 offset = 20 * DEFAULT_PAGE_SIZE - DEFAULT_PAGE_SIZE / 2;
+  EXPECT_FALSE(io->wait(
+      io->enqueue({IORequest::Kind::Read, offset, across.data(), DEFAULT_PAGE_SIZE})));
+  const std::vector<std::byte> last = pattern(DEFAULT_PAGE_SIZE, 19);
+  EXPECT_TRUE(std::equal(last.begin() + DEFAULT_PAGE_SIZE / 2, last.end(), across.begin()));
+}
+
+/* prefetched pages are used instead of reading on a miss */
+TEST(Pager, Prefetch)
+{
+  std::stringstream ss;
+  std::vector<PageId> ids;
+  {
+    Pager pager(ss);
+    for (u8 i{0}; i < 10; ++i)
+    {
+      ids.push_back(pager.nextFree());
+      pager.getPage(ids.back()).buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(i);
+    }
+  }
+
+  Pager pager(ss);
+  pager.useAsyncIO(AsyncIO::create(pager.storage()));
+  const u64 reads = pager.stats().reads;
+  pager.prefetch(ids);
+  EXPECT_EQ(ids.size(), pager.stats().prefetched);
+
+  for (u8 i{0}; i < ids.size(); ++i)
+  {
+    EXPECT_EQ(static_cast<std::byte>(i), pager.readPage(ids[i]).buf[DEFAULT_PAGE_SIZE - 1]);
+  }
+  EXPECT_EQ(ids.size(), pager.stats().prefetchHits);
+  EXPECT_EQ(reads, pager.stats().reads);
+
+  // cached pages are not prefetched again
+  pager.prefetch(ids);
+  EXPECT_EQ(ids.size(), pager.stats().prefetched);
+}
+
+/* the children of an interior node can be read in together */
+TEST(Pager, PrefetchChildren)
+{
+  std::stringstream ss;
+  PageId rootId{};
+  {
+    Pager pager(ss);
+    PageId leafId{};
+    Page<BTreeHeader> &leaf = pager.fromNextFree<BTreeHeader>(PageType::Leaf, &leafId);
+    for (u32 i{0}; i <= btreeOrder(pager.pageSize()); ++i)
+    {
+      leafInsert<u32>(pager, leafId, leaf, i);
+    }
+    rootId = leaf.header()->parent;
+  }
+
+  Pager pager(ss);
+  pager.useAsyncIO(AsyncIO::create(pager.storage()));
+  InteriorNode root{pager.getPage<BTreeHeader>(rootId)};
+  ASSERT_EQ(2, root.page.header()->slots.entryCount());
+  root.prefetchChildren(pager);
+  EXPECT_EQ(2, pager.stats().prefetched);
+
+  UNUSED(root.searchGetLeaf(pager, static_cast<u32>(0)));
+  EXPECT_EQ(1, pager.stats().prefetchHits);
+}
+
+/* adjacent dirty pages go out as one gathered write, through io_uring when the file has one */
+TEST_F(TempFileFixture, AsyncCoalescedWriteBack)
+{
+  {
+    Database db(std::make_unique<FileStorage>(path));
+    db.pager.useAsyncIO(AsyncIO::create(db.pager.storage()));
+    const PagerStats before = db.pager.stats();
+    for (u8 i{1}; i <= 20; ++i)
+    {
+      const PageId id = db.pager.nextFree(PageType::Leaf);
+      db.pager.getPage(id).buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(i);
+    }
+    db.pager.flush();
+    EXPECT_EQ(before.writes + 21, db.pager.stats().writes);
+    EXPECT_EQ(before.writeCalls + 1, db.pager.stats().writeCalls);
+  }
+
+  Database db(std::make_unique<FileStorage>(path));
+  for (u8 i{1}; i <= 20; ++i)
+  {
+    EXPECT_EQ(static_cast<std::byte>(i), db.pager.readPage(i).buf[DEFAULT_PAGE_SIZE - 1]);
+  }
+}
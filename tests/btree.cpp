@@ -8,9 +8,9 @@ TEST(Slots, AddSlotsAndCellsUpdatesFreePointers)
 {
   // test cells in the slots
   std::array<std::byte, 128> page = {static_cast<std::byte>(0)};
-  constexpr std::size_t bufsize = page.size() - sizeof(SlotHeader<0>);
-  SlotHeader<bufsize> &sh = *reinterpret_cast<SlotHeader<bufsize> *>(page.data());
-  sh = SlotHeader<bufsize>();
+  constexpr std::size_t bufsize = page.size() - sizeof(SlotHeader);
+  SlotHeader &sh = *reinterpret_cast<SlotHeader *>(page.data());
+  sh = SlotHeader(bufsize);
 
   // the slot header lives inside the page, so create a span to exclude the header
   std::span<std::byte> buf =
@@ -46,9 +46,9 @@ TEST(Slots, AddThenRead)
 {
   // test cells in the slots
   std::array<std::byte, 128> page = {static_cast<std::byte>(0)};
-  constexpr std::size_t bufsize = page.size() - sizeof(SlotHeader<0>);
-  SlotHeader<bufsize> &sh = *reinterpret_cast<SlotHeader<bufsize> *>(page.data());
-  sh = SlotHeader<bufsize>();
+  constexpr std::size_t bufsize = page.size() - sizeof(SlotHeader);
+  SlotHeader &sh = *reinterpret_cast<SlotHeader *>(page.data());
+  sh = SlotHeader(bufsize);
 
   // the slot header lives inside the page, so create a span to exclude the header
   std::span<std::byte> buf =
@@ -79,9 +79,9 @@ TEST(Slots, AddThenRead)
 TEST(Slots, OutOfBounds)
 {
   std::array<std::byte, 128> buf = {static_cast<std::byte>(0)};
-  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader<0>);
-  SlotHeader<bufsize> &sh = *reinterpret_cast<SlotHeader<bufsize> *>(buf.data());
-  sh = SlotHeader<bufsize>();
+  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader);
+  SlotHeader &sh = *reinterpret_cast<SlotHeader *>(buf.data());
+  sh = SlotHeader(bufsize);
 
   // allow getting the slot on the boundary of freeStart as that's how we get new cells
   ASSERT_NO_THROW({ sh.getSlot(0); });
@@ -94,9 +94,9 @@ TEST(Slots, OutOfBounds)
 TEST(Slots, Insertion)
 {
   std::array<std::byte, 128> buf = {static_cast<std::byte>(0)};
-  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader<0>);
-  SlotHeader<bufsize> &sh = *reinterpret_cast<SlotHeader<bufsize> *>(buf.data());
-  sh = SlotHeader<bufsize>();
+  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader);
+  SlotHeader &sh = *reinterpret_cast<SlotHeader *>(buf.data());
+  sh = SlotHeader(bufsize);
 
   struct Cell
   {
@@ -140,9 +140,9 @@ TEST(Slots, Insertion)
 TEST(Slots, InsertAfterDelete)
 {
   std::array<std::byte, 128> buf = {static_cast<std::byte>(0)};
-  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader<0>);
-  SlotHeader<bufsize> &sh = *reinterpret_cast<SlotHeader<bufsize> *>(buf.data());
-  sh = SlotHeader<bufsize>();
+  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader);
+  SlotHeader &sh = *reinterpret_cast<SlotHeader *>(buf.data());
+  sh = SlotHeader(bufsize);
 
   struct Cell
   {
@@ -255,7 +255,7 @@ TEST(BTree, SearchGetLeaf)
 
   {
     // search for 2, should return the `left` leaf node.
-    Page<BTreeHeader> &res = root.searchGetLeaf(pager, static_cast<u32>(2));
+    const Page<BTreeHeader> &res = root.searchGetLeaf(pager, static_cast<u32>(2));
     ASSERT_TRUE(res.header()->isLeaf());
     EXPECT_EQ(rootId, res.header()->parent);
 
@@ -270,8 +270,34 @@ TEST(BTree, SearchGetLeaf)
     EXPECT_EQ(res.header()->slots.end(), it);
 
     // check the sibling link is there still
-    LeafNode leafRes {res};
-    EXPECT_EQ(rightId, leafRes.getSibling());
+    EXPECT_EQ(rightId, LeafNode::siblingOf(res.as_const<CommonHeader>()));
+  }
+}
+
+/* the child for a key is the first cell with a greater key, or the end cell past the last */
+TEST(BTree, InteriorChildFor)
+{
+  std::stringstream mockStream;
+  Pager pager(mockStream);
+  InteriorNode node{pager.fromNextFree<BTreeHeader>(PageType::Interior)};
+  SlotHeader &slots = node.page.header()->slots;
+
+  // keys 10, 20, ... with the child for the keys below each at the key itself
+  constexpr u32 KEYS = 40;
+  for (u32 i{1}; i <= KEYS; ++i)
+  {
+    InteriorCell cell(i * 10);
+    cell.leftChild = i * 10;
+    slots.insertCell(cell);
+  }
+  InteriorCell end = InteriorCell<u32>::End();
+  end.leftChild = 1;
+  slots.insertCell(end);
+
+  for (u32 key{0}; key <= KEYS * 10 + 5; ++key)
+  {
+    const PageId expected = key >= KEYS * 10 ? 1 : (key / 10 + 1) * 10;
+    EXPECT_EQ(expected, InteriorNode::childFor(slots, key)) << key;
   }
 }
 
@@ -292,6 +318,51 @@ TEST(BTree, SearchInLeafGetSlot)
   EXPECT_EQ(sizeof(LeafCell<u32>), pSlot->cellSize);
 }
 
+/* the ordered searches give the insert position on a miss and handle repeated keys */
+TEST(BTree, LeafBounds)
+{
+  std::stringstream mockStream;
+  Pager pager(mockStream);
+  LeafNode l{pager.fromNextFree<BTreeHeader>(PageType::Leaf)};
+  SlotHeader &slots = l.page.header()->slots;
+  for (u32 key : {10, 20, 20, 20, 30})
+  {
+    slots.insertCell(LeafCell(key));
+  }
+
+  EXPECT_EQ(std::pair(SlotNum{1}, SlotNum{4}), LeafNode::equalRange<u32>(slots, 20u));
+  EXPECT_EQ(std::pair(SlotNum{0}, true), l.find<u32>(10u));
+  EXPECT_EQ(std::pair(SlotNum{1}, false), l.find<u32>(15u));
+  EXPECT_EQ(std::pair(SlotNum{5}, false), l.find<u32>(31u));
+  EXPECT_EQ(0, LeafNode::upperBound<u32>(slots, 9u));
+  EXPECT_FALSE(l.searchGetSlot(LeafCell(25u)).has_value());
+  EXPECT_EQ(30, l.searchGetSlot(LeafCell(30u))->second->getPayload());
+}
+
+/* a search can compare by part of the stored key */
+TEST(BTree, LeafBoundsByPrefix)
+{
+  using Entry = std::pair<u32, u32>;
+  struct ByFirst
+  {
+    bool operator()(const Entry &a, u32 b) const { return a.first < b; }
+    bool operator()(u32 a, const Entry &b) const { return a < b.first; }
+  };
+
+  std::stringstream mockStream;
+  Pager pager(mockStream);
+  LeafNode l{pager.fromNextFree<BTreeHeader>(PageType::Leaf)};
+  SlotHeader &slots = l.page.header()->slots;
+  for (const Entry &entry : {Entry{1, 5}, Entry{2, 1}, Entry{2, 9}, Entry{3, 0}})
+  {
+    slots.insertCell(LeafCell(entry));
+  }
+
+  EXPECT_EQ(std::pair(SlotNum{1}, SlotNum{3}),
+            LeafNode::equalRange<Entry>(slots, u32{2}, ByFirst{}));
+  EXPECT_EQ(std::pair(SlotNum{4}, false), l.find<Entry>(u32{4}, ByFirst{}));
+}
+
 TEST(BTree, SplitNode)
 {
   std::stringstream mockStream;
@@ -369,11 +440,12 @@ TEST(BTree, NodeCanFit_BTREE_ORDER_Cells)
                 "sizeof(MaxCell) struct should be the maximum cell size");
 
   auto comparitor = std::function([](const MaxCell &a, const MaxCell &b) { return a.i < b.i; });
-  for (std::size_t i{0}; i < BTREE_ORDER; ++i)
+  const std::size_t order = btreeOrder(node.buf.size());
+  for (std::size_t i{0}; i < order; ++i)
   {
     node.header()->slots.insertCell(MaxCell(i), comparitor);
   }
-  EXPECT_EQ(BTREE_ORDER, node.header()->slots.entryCount());
+  EXPECT_EQ(order, node.header()->slots.entryCount());
 
   std::size_t numSlots{0};
   for (const auto &slot : node.header()->slots)
@@ -382,7 +454,7 @@ TEST(BTree, NodeCanFit_BTREE_ORDER_Cells)
     EXPECT_EQ(numSlots, cell->i);
     ++numSlots;
   }
-  EXPECT_EQ(BTREE_ORDER, numSlots);
+  EXPECT_EQ(order, numSlots);
   // there should not be enough space to fit another cell+slot
   EXPECT_GT(MAX_CELL_SIZE + sizeof(Slot), node.header()->slots.freeLength);
 }
@@ -401,7 +473,8 @@ TEST(BTree, LeafNodeFromExistingPage)
 TEST(BTree, SplitRoot)
 {
   std::stringstream mockStream;
-  Pager pager(mockStream);
+  // small pages keep the tree printable
+  Pager pager(mockStream, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
   PageId originalRootId{};
   LeafNode originalRoot(pager.fromNextFree<BTreeHeader>(PageType::Leaf, &originalRootId));
 
@@ -409,14 +482,14 @@ TEST(BTree, SplitRoot)
   ASSERT_TRUE(originalRoot.page.header()->isLeaf());
   ASSERT_EQ(0, originalRoot.page.header()->slots.entryCount());
 
-  for (std::size_t i{}; i < BTREE_ORDER; ++i)
+  for (std::size_t i{}; i < btreeOrder(pager.pageSize()); ++i)
   {
     leafInsert<u32>(pager, originalRootId, originalRoot.page, static_cast<u32>(123));
   }
 
   EXPECT_TRUE(originalRoot.page.header()->isRoot());
   EXPECT_TRUE(originalRoot.page.header()->isLeaf());
-  EXPECT_EQ(BTREE_ORDER, originalRoot.page.header()->slots.entryCount());
+  EXPECT_EQ(btreeOrder(pager.pageSize()), originalRoot.page.header()->slots.entryCount());
 
   std::stringstream tree{};
   printTree<u32>(tree, pager, originalRoot.page);
@@ -460,3 +533,60 @@ TEST(BTree, SplitRoot)
   printTree<u32>(tree, pager, newRoot);
   ASSERT_STREQ("(123 [123 123 123 ] END [123 123 123 123 ] )", tree.str().c_str());
 }
+
+/* larger pages hold more cells before the root has to split */
+TEST(BTree, OrderFollowsPageSize)
+{
+  for (u32 pageSize : {MIN_PAGE_SIZE, DEFAULT_PAGE_SIZE, MAX_PAGE_SIZE})
+  {
+    std::stringstream mockStream;
+    Pager pager(mockStream, DEFAULT_CACHE_SIZE, pageSize);
+    PageId rootId{};
+    LeafNode root(pager.fromNextFree<BTreeHeader>(PageType::Leaf, &rootId));
+    EXPECT_EQ(BTreeHeader::slotsSize(pageSize), root.page.header()->slots.freeLength);
+
+    const std::size_t order = btreeOrder(pageSize);
+    for (u32 i{0}; i < order; ++i)
+    {
+      leafInsert<u32>(pager, rootId, root.page, i);
+    }
+    EXPECT_TRUE(root.page.header()->isRoot());
+    EXPECT_EQ(order, root.page.header()->slots.entryCount());
+
+    leafInsert<u32>(pager, rootId, root.page, static_cast<u32>(order));
+    EXPECT_FALSE(root.page.header()->isRoot());
+  }
+  EXPECT_LE(8 * btreeOrder(MIN_PAGE_SIZE), btreeOrder(DEFAULT_PAGE_SIZE));
+}
+
+/* looking keys up only reads the pages on the way down, so nothing is left to write back */
+TEST(BTree, SearchDoesNotDirty)
+{
+  std::stringstream mockStream;
+  Pager pager(mockStream);
+  PageId leafId{};
+  UNUSED(pager.fromNextFree<BTreeHeader>(PageType::Leaf, &leafId));
+  const u32 keys = static_cast<u32>(btreeOrder(DEFAULT_PAGE_SIZE)) * 4;
+  for (u32 key{0}; key < keys; ++key)
+  {
+    leafInsert<u32>(pager, leafId, pager.getPage<BTreeHeader>(leafId), key);
+  }
+  PageId root = leafId;
+  while (!pager.readPage<BTreeHeader>(root).header()->isRoot())
+  {
+    root = pager.readPage<BTreeHeader>(root).header()->parent;
+  }
+  pager.flush();
+  ASSERT_EQ(0, pager.dirtyPages());
+
+  const u64 writes = pager.stats().writes;
+  for (u32 key{0}; key < keys; key += 7)
+  {
+    const Page<BTreeHeader> &leaf = InteriorNode::searchGetLeaf(pager, root, key);
+    const auto [first, last] = LeafNode::equalRange<u32>(leaf.header()->slots, key);
+    EXPECT_LT(first, last) << key;
+  }
+  EXPECT_EQ(0, pager.dirtyPages());
+  pager.flush();
+  EXPECT_EQ(writes, pager.stats().writes);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include "database/btree_cursor.hpp"
+
+#include <algorithm>
+#include <vector>
+
+// how many pages a checked tree has, and how many of those are leaves
+struct TreeShape
+{
+  u32 pages = 0;
+  u32 leaves = 0;
+};
+
+/* every child points back at its parent and every interior node ends with its end cell */
+inline TreeShape checkParents(Pager &pager, PageId id)
+{
+  if (pager.readPage<BTreeHeader>(id).header()->isLeaf())
+  {
+    return {1, 1};
+  }
+  std::vector<PageId> children;
+  const auto &slots = pager.readPage<BTreeHeader>(id).header()->slots;
+  for (const Slot &s : slots)
+  {
+    children.push_back(
+        reinterpret_cast<const InteriorCell<u32> *>(slots.readCell(s.cellOffset))->leftChild);
+  }
+  EXPECT_TRUE(reinterpret_cast<const InteriorCell<u32> *>(
+                  slots.readCell(slots.getSlot(slots.entryCount() - 1)->cellOffset))
+                  ->isEnd());
+  TreeShape shape{1, 0};
+  for (PageId child : children)
+  {
+    EXPECT_EQ(id, pager.readPage<BTreeHeader>(child).header()->parent);
+    const TreeShape below = checkParents(pager, child);
+    shape.pages += below.pages;
+    shape.leaves += below.leaves;
+  }
+  return shape;
+}
+
+/* insert the key into the leaf found by descending from the root, returns the root after any
+ * splits */
+inline PageId insertKey(Pager &pager, PageId root, u32 key)
+{
+  PageId leaf = root;
+  while (!pager.readPage<BTreeHeader>(leaf).header()->isLeaf())
+  {
+    leaf = InteriorNode::childFor(pager.readPage<BTreeHeader>(leaf).header()->slots, key);
+  }
+  leafInsert<u32>(pager, leaf, pager.getPage<BTreeHeader>(leaf), key);
+  while (!pager.readPage<BTreeHeader>(root).header()->isRoot())
+  {
+    root = pager.readPage<BTreeHeader>(root).header()->parent;
+  }
+  return root;
+}
+
+/* a new tree with the keys inserted one at a time in the order given. returns the root */
+inline PageId build(Pager &pager, const std::vector<u32> &keys)
+{
+  PageId root{};
+  UNUSED(pager.fromNextFree<BTreeHeader>(PageType::Leaf, &root));
+  for (u32 key : keys)
+  {
+    root = insertKey(pager, root, key);
+  }
+  return root;
+}
+
+/* every child points back at its parent and the keys are in order in both directions */
+inline void checkTree(Pager &pager, PageId root, std::vector<u32> expected)
+{
+  checkParents(pager, root);
+
+  std::sort(expected.begin(), expected.end());
+  BTreeCursor<u32> cursor(pager, root);
+  std::vector<u32> forward;
+  for (bool on = cursor.first(); on; on = cursor.next())
+  {
+    forward.push_back(cursor.key());
+  }
+  EXPECT_EQ(expected, forward);
+  std::vector<u32> backward;
+  for (bool on = cursor.last(); on; on = cursor.prev())
+  {
+    backward.push_back(cursor.key());
+  }
+  std::reverse(backward.begin(), backward.end());
+  EXPECT_EQ(expected, backward);
+}
@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+
+#include "database/buffer_pool.hpp"
+#include "database/pager.hpp"
+
+/* the capacity is the byte budget in pages, but never below the minimum */
+TEST(BufferPool, Capacity)
+{
+  EXPECT_EQ(64, BufferPool(64 * DEFAULT_PAGE_SIZE).capacity());
+  EXPECT_EQ(BufferPool::MIN_FRAMES, BufferPool(0).capacity());
+}
+
+/* pages only seen once are evicted before pages seen twice, in least recently used order */
+TEST(BufferPool, ScanResistant)
+{
+  BufferPool pool(0);
+  Frame &hot = pool.insert(1);
+  pool.touch(hot);
+
+  for (PageId id = 2; !pool.full(); ++id)
+  {
+    pool.insert(id);
+  }
+
+  // a scan over many pages only ever replaces the pages it brought in
+  for (PageId id = 100; id < 200; ++id)
+  {
+    Frame *victim = pool.victim();
+    ASSERT_NE(nullptr, victim);
+    EXPECT_NE(1, victim->id);
+    pool.erase(*victim);
+    pool.insert(id);
+  }
+  EXPECT_NE(nullptr, pool.find(1));
+}
+
+TEST(BufferPool, PinnedFramesAreNotVictims)
+{
+  BufferPool pool(0);
+  while (!pool.full())
+  {
+    pool.insert(static_cast<PageId>(pool.size())).pins++;
+  }
+  EXPECT_EQ(nullptr, pool.victim());
+
+  Frame *f = pool.find(3);
+  ASSERT_NE(nullptr, f);
+  f->pins--;
+  EXPECT_EQ(f, pool.victim());
+}
+
+/* the pager keeps no more pages than the budget allows and writes back what it evicts */
+TEST(Pager, BoundedCache)
+{
+  std::stringstream ss;
+  Pager pager(ss, 0);
+  const std::size_t capacity = pager.cacheCapacity();
+
+  std::vector<PageId> ids;
+  for (std::size_t i{0}; i < capacity * 4; ++i)
+  {
+    PageId id = pager.nextFree(PageType::Leaf);
+    pager.getPage(id).buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(i);
+    ids.push_back(id);
+    EXPECT_LE(pager.cachedPages(), capacity);
+  }
+
+  for (std::size_t i{0}; i < ids.size(); ++i)
+  {
+    EXPECT_EQ(static_cast<std::byte>(i), pager.getPage(ids[i]).buf[DEFAULT_PAGE_SIZE - 1]);
+  }
+  EXPECT_LE(pager.cachedPages(), capacity);
+
+  // the first page stays put
+  EXPECT_EQ(PageType::First, pager.getPage(0).header()->type);
+}
+
+/* allocating and modifying pages does not touch the stream until the pager is flushed */
+TEST(Pager, DirtyPagesWrittenOnFlush)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  ASSERT_EQ(DEFAULT_PAGE_SIZE, ss.str().size());
+
+  for (u8 i{1}; i <= 3; ++i)
+  {
+    PageId id = pager.nextFree(PageType::Leaf);
+    pager.getPage(id).buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(i);
+  }
+  EXPECT_EQ(DEFAULT_PAGE_SIZE, ss.str().size());
+  EXPECT_EQ(4 * DEFAULT_PAGE_SIZE, pager.fsize());
+  EXPECT_LE(3, pager.dirtyPages());
+
+  pager.flush();
+  EXPECT_EQ(0, pager.dirtyPages());
+  const std::string contents = ss.str();
+  ASSERT_EQ(4 * DEFAULT_PAGE_SIZE, contents.size());
+  for (u8 i{1}; i <= 3; ++i)
+  {
+    EXPECT_EQ(i, static_cast<u8>(contents[(i + 1) * DEFAULT_PAGE_SIZE - 1]));
+  }
+
+  // reading does not dirty the page again
+  EXPECT_EQ(static_cast<std::byte>(2), pager.readPage(2).buf[DEFAULT_PAGE_SIZE - 1]);
+  EXPECT_EQ(0, pager.dirtyPages());
+  pager.markDirty(2);
+  EXPECT_EQ(1, pager.dirtyPages());
+}
+
+/* dirty pages are written back when the pager is closed */
+TEST(Pager, DirtyPagesWrittenOnClose)
+{
+  std::stringstream ss;
+  PageId id{};
+  {
+    Pager pager(ss);
+    id = pager.nextFree(PageType::Interior);
+    pager.getPage(id).buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(42);
+  }
+
+  Pager pager(ss);
+  EXPECT_EQ(2 * DEFAULT_PAGE_SIZE, pager.fsize());
+  EXPECT_EQ(PageType::Interior, pager.readPage(id).header()->type);
+  EXPECT_EQ(static_cast<std::byte>(42), pager.readPage(id).buf[DEFAULT_PAGE_SIZE - 1]);
+}
+
+/* runs of adjacent dirty pages are written back in one call each */
+TEST(Pager, CoalescedWriteBack)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  const PagerStats before = pager.stats();
+  for (u8 i{1}; i <= 10; ++i)
+  {
+    UNUSED(pager.nextFree(PageType::Leaf));
+  }
+  pager.flush();
+  EXPECT_EQ(before.writes + 11, pager.stats().writes);
+  EXPECT_EQ(before.writeCalls + 1, pager.stats().writeCalls);
+
+  for (PageId id : {2, 3, 4, 7, 8})
+  {
+    pager.getPage(id).buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(id);
+  }
+  pager.flush();
+  EXPECT_EQ(before.writes + 16, pager.stats().writes);
+  EXPECT_EQ(before.writeCalls + 3, pager.stats().writeCalls);
+
+  const std::string contents = ss.str();
+  for (PageId id : {2, 3, 4, 7, 8})
+  {
+    EXPECT_EQ(id, static_cast<u8>(contents[(id + 1) * DEFAULT_PAGE_SIZE - 1]));
+  }
+}
+
+/* a pinned page keeps its frame while everything else is evicted around it */
+TEST(PageGuard, PinnedPageStaysResident)
+{
+  std::stringstream ss;
+  Pager pager(ss, 0);
+  ExclusivePage<> pinned = pager.pinNextFree<CommonHeader>(PageType::Leaf);
+  const PageId pinnedId = pinned.id();
+  pinned->buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(7);
+  const Page<> *address = &pinned.page();
+
+  for (std::size_t i{0}; i < pager.cacheCapacity() * 2; ++i)
+  {
+    UNUSED(pager.getPage(pager.nextFree()));
+  }
+
+  EXPECT_EQ(address, &pager.readPage(pinnedId));
+  EXPECT_EQ(static_cast<std::byte>(7), pinned->buf[DEFAULT_PAGE_SIZE - 1]);
+}
+
+/* only exclusive guards mark the page as dirty */
+TEST(PageGuard, ExclusiveMarksDirty)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  const PageId id = pager.nextFree();
+  pager.flush();
+  ASSERT_EQ(0, pager.dirtyPages());
+
+  {
+    SharedPage<> shared = pager.pinShared(id);
+    SharedPage<> shared2 = pager.pinShared(id);
+    EXPECT_EQ(&shared.page(), &shared2.page());
+  }
+  EXPECT_EQ(0, pager.dirtyPages());
+
+  {
+    ExclusivePage<> exclusive = pager.pinExclusive(id);
+    exclusive->buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(1);
+  }
+  EXPECT_EQ(1, pager.dirtyPages());
+}
+
+/* moving a guard moves the pin, releasing it lets the frame be evicted again */
+TEST(PageGuard, MoveAndRelease)
+{
+  std::stringstream ss;
+  Pager pager(ss, 0);
+
+  std::vector<ExclusivePage<>> guards;
+  // the first page is always pinned, so one frame less is available
+  for (std::size_t i{1}; i < pager.cacheCapacity(); ++i)
+  {
+    guards.push_back(pager.pinNextFree<CommonHeader>(PageType::Leaf));
+  }
+  EXPECT_THROW({ UNUSED(pager.nextFree()); }, PageError);
+
+  ExclusivePage<> moved = std::move(guards.back());
+  guards.pop_back();
+  EXPECT_TRUE(moved);
+  EXPECT_THROW({ UNUSED(pager.nextFree()); }, PageError);
+
+  moved.release();
+  EXPECT_FALSE(moved);
+  EXPECT_NO_THROW({ UNUSED(pager.nextFree()); });
+}
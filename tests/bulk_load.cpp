@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include "btree_fixture.hpp"
+#include "database/btree_cursor.hpp"
+#include "database/bulk_load.hpp"
+
+namespace
+{
+PageId load(Pager &pager, u32 keys, BulkLoadOptions options = {})
+{
+  BulkLoader<u32> loader(pager, options);
+  for (u32 key{0}; key < keys; ++key)
+  {
+    loader.add(key);
+  }
+  EXPECT_EQ(keys, loader.keys());
+  return loader.finish();
+}
+} // namespace
+
+/* the loaded tree has every key, full leaves laid out in order, and can be searched and scanned */
+TEST(BulkLoad, BuildsPackedTree)
+{
+  constexpr u32 KEYS = 20000;
+  std::stringstream ss;
+  // small enough that the leaves are written back while loading
+  Pager pager(ss, 64 * DEFAULT_PAGE_SIZE);
+  const PageId root = load(pager, KEYS);
+  // no page was written back before it was finished. the first page can be written again when
+  // the leaves the last run didn't need go on the free list
+  pager.flush();
+  EXPECT_LE(pager.stats().writes, pager.fsize() / DEFAULT_PAGE_SIZE + 1);
+  EXPECT_TRUE(pager.readPage<BTreeHeader>(root).header()->isRoot());
+
+  const u32 order = btreeOrder(DEFAULT_PAGE_SIZE);
+  EXPECT_EQ((KEYS + order - 1) / order, checkParents(pager, root).leaves);
+
+  for (u32 key : {0u, 1u, order - 1, order, KEYS / 2, KEYS - 1})
+  {
+    const Page<BTreeHeader> &leaf = InteriorNode::searchGetLeaf(pager, root, key);
+    const auto [first, last] = LeafNode::equalRange<u32>(leaf.header()->slots, key);
+    EXPECT_LT(first, last) << key;
+  }
+
+  BTreeCursor<u32> cursor(pager, root);
+  u32 expected = 0;
+  u32 adjacent = 0;
+  PageId leaf = 0;
+  for (bool on = cursor.first(); on; on = cursor.next())
+  {
+    EXPECT_EQ(expected++, cursor.key());
+    if (cursor.leaf() != leaf)
+    {
+      adjacent += cursor.leaf() == leaf + 1;
+      leaf = cursor.leaf();
+    }
+  }
+  EXPECT_EQ(KEYS, expected);
+  // only the start of each run of leaves is not next to the one before
+  EXPECT_GE(adjacent, KEYS / order * 9 / 10);
+  EXPECT_EQ(KEYS - 1, cursor.last() ? cursor.key() : 0);
+}
+
+/* a lower fill factor leaves room in each node, and the tree takes inserts afterwards */
+TEST(BulkLoad, FillFactor)
+{
+  constexpr u32 KEYS = 5000;
+  std::stringstream ss;
+  Pager pager(ss);
+  const PageId root = load(pager, KEYS, {.fill = 0.5});
+  const u32 perLeaf = btreeOrder(DEFAULT_PAGE_SIZE) / 2;
+  EXPECT_EQ((KEYS + perLeaf - 1) / perLeaf, checkParents(pager, root).leaves);
+
+  for (u32 key{1}; key < KEYS; key += 10)
+  {
+    EXPECT_EQ(root, insertKey(pager, root, key));
+  }
+  // there was room for all of them without a split
+  EXPECT_TRUE(pager.readPage<BTreeHeader>(root).header()->isRoot());
+  BTreeCursor<u32> cursor(pager, root);
+  std::vector<u32> keys;
+  cursor.range(std::nullopt, std::nullopt, [&keys](u32 key) { keys.push_back(key); });
+  EXPECT_EQ(KEYS + KEYS / 10, keys.size());
+  EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
+
+/* keys have to arrive in order, and an empty load is an empty leaf */
+TEST(BulkLoad, OrderAndEmpty)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  {
+    BulkLoader<u32> loader(pager);
+    loader.add(5);
+    loader.add(5);
+    EXPECT_THROW(loader.add(4), std::invalid_argument);
+    UNUSED(loader.finish());
+    EXPECT_THROW(loader.add(6), std::logic_error);
+  }
+  EXPECT_THROW(BulkLoader<u32>(pager, {.fill = 0}), std::invalid_argument);
+
+  const PageId root = load(pager, 0);
+  EXPECT_TRUE(pager.readPage<BTreeHeader>(root).header()->isLeaf());
+  EXPECT_TRUE(pager.readPage<BTreeHeader>(root).header()->slots.isEmpty());
+}
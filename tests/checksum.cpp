@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include "database/checksum.hpp"
+#include "database/pager.hpp"
+
+#include <algorithm>
+#include <string_view>
+
+namespace
+{
+std::span<const std::byte> bytes(std::string_view s)
+{
+  return std::as_bytes(std::span(s.data(), s.size()));
+}
+} // namespace
+
+/* the standard check value, whichever implementation is used */
+TEST(Checksum, Crc32c)
+{
+  EXPECT_EQ(0xe3069283, crc32c(bytes("123456789")));
+  EXPECT_EQ(0, crc32c({}));
+  EXPECT_EQ(crc32c(bytes("123456789")), crc32c(bytes("6789"), crc32c(bytes("12345"))));
+}
+
+TEST(Checksum, Page)
+{
+  Page<> page(PageType::Leaf, MIN_PAGE_SIZE);
+  // a page that was never sealed has no checksum
+  EXPECT_FALSE(verifyPage(page.buf));
+
+  sealPage(page.buf);
+  EXPECT_NE(0, page.header()->checksum);
+  EXPECT_TRUE(verifyPage(page.buf));
+
+  page.buf[MIN_PAGE_SIZE - 1] = std::byte{1};
+  EXPECT_FALSE(verifyPage(page.buf));
+}
+
+/* a page corrupted on disk is caught when it is read in, unless verification is off */
+TEST(Checksum, CorruptPage)
+{
+  std::stringstream ss;
+  PageId id;
+  {
+    Pager pager(ss);
+    id = pager.nextFree(PageType::Leaf);
+    pager.getPage(id).buf[100] = std::byte{1};
+  }
+  std::string contents = ss.str();
+  contents[id * DEFAULT_PAGE_SIZE + 200] = 1;
+
+  std::stringstream corrupt(contents);
+  {
+    Pager pager(corrupt);
+    const u64 verified = pager.stats().verified;
+    EXPECT_THROW(UNUSED(pager.readPage(id)), PageError);
+    EXPECT_EQ(verified + 1, pager.stats().verified);
+  }
+  {
+    Pager pager(corrupt);
+    pager.setVerify(Verify::Never);
+    const u64 verified = pager.stats().verified;
+    EXPECT_EQ(std::byte{1}, pager.readPage(id).buf[200]);
+    EXPECT_EQ(verified, pager.stats().verified);
+  }
+}
+
+/* a page whose checksum was zeroed is corrupt */
+TEST(Checksum, MissingChecksum)
+{
+  std::stringstream ss;
+  PageId id;
+  {
+    Pager pager(ss);
+    id = pager.nextFree(PageType::Leaf);
+    pager.getPage(id).buf[100] = std::byte{1};
+  }
+  const auto clear = [](std::string &contents, std::size_t offset, std::size_t size)
+  {
+    std::fill_n(contents.begin() + offset, size, '\0');
+  };
+  std::string contents = ss.str();
+  clear(contents, id * DEFAULT_PAGE_SIZE + offsetof(CommonHeader, checksum), sizeof(u32));
+  std::stringstream zeroed(contents);
+  Pager pager(zeroed);
+  EXPECT_THROW(UNUSED(pager.readPage(id)), PageError);
+}
+
+/* with Verify::Once a page is only checked the first time it is read */
+TEST(Checksum, VerifyOnce)
+{
+  std::stringstream ss;
+  Pager pager(ss, 0);
+  std::vector<PageId> ids;
+  for (std::size_t i{0}; i < 2 * pager.cacheCapacity(); ++i)
+  {
+    ids.push_back(pager.nextFree(PageType::Leaf));
+  }
+  pager.flush();
+
+  // the pages were all written by this pager, so none of them need checking
+  const u64 verified = pager.stats().verified;
+  for (PageId id : ids)
+  {
+    UNUSED(pager.readPage(id));
+  }
+  EXPECT_EQ(verified, pager.stats().verified);
+
+  pager.setVerify(Verify::Always);
+  for (PageId id : ids)
+  {
+    UNUSED(pager.readPage(id));
+  }
+  EXPECT_LT(verified, pager.stats().verified);
+}
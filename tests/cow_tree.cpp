@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include "database/cow_tree.hpp"
+
+#include <map>
+#include <thread>
+
+namespace
+{
+std::vector<u32> keysOf(const CowTree<u32>::Snapshot &snapshot)
+{
+  std::vector<u32> keys;
+  snapshot.forEach([&](u32 key) { keys.push_back(key); });
+  return keys;
+}
+
+struct Image
+{
+  PageBuffer page;
+  u32 checksum;
+};
+
+/* copy every page reachable from `id` */
+void imageOf(Pager &pager, PageId id, std::map<PageId, Image> &pages)
+{
+  const Page<BTreeHeader> &node = pager.readPage<BTreeHeader>(id);
+  pages.emplace(id, Image{node.buf, node.header()->common.checksum});
+  if (node.header()->isLeaf())
+  {
+    return;
+  }
+  std::vector<PageId> children;
+  for (const Slot &s : node.header()->slots)
+  {
+    children.push_back(
+        *reinterpret_cast<const PageId *>(node.header()->slots.readCell(s.cellOffset)));
+  }
+  for (PageId child : children)
+  {
+    imageOf(pager, child, pages);
+  }
+}
+} // namespace
+
+/* a snapshot keeps seeing the tree as it was, and its pages are only reused once it is released */
+TEST(CowTree, SnapshotIsolation)
+{
+  std::stringstream ss;
+  Pager pager(ss, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  CowTree<u32> tree(pager);
+  for (u32 key{0}; key < 500; ++key)
+  {
+    tree.insert(key * 2);
+  }
+
+  CowTree<u32>::Snapshot before = tree.snapshot();
+  const u64 freed = tree.stats().freed;
+  for (u32 key{0}; key < 500; ++key)
+  {
+    tree.insert(key * 2 + 1);
+  }
+  EXPECT_EQ(freed, tree.stats().freed);
+  EXPECT_NE(before.root(), tree.root());
+
+  const std::vector<u32> old = keysOf(before);
+  ASSERT_EQ(500, old.size());
+  for (u32 i{0}; i < old.size(); ++i)
+  {
+    EXPECT_EQ(i * 2, old[i]);
+  }
+  EXPECT_TRUE(before.contains(998));
+  EXPECT_FALSE(before.contains(999));
+
+  before.release();
+  tree.reclaim();
+  EXPECT_GT(tree.stats().freed, freed);
+
+  const CowTree<u32>::Snapshot after = tree.snapshot();
+  const std::vector<u32> keys = keysOf(after);
+  ASSERT_EQ(1000, keys.size());
+  for (u32 i{0}; i < keys.size(); ++i)
+  {
+    EXPECT_EQ(i, keys[i]);
+  }
+  // every page replaced so far went back to the pager, so the file holds a few copies at most
+  EXPECT_EQ(tree.stats().copies, tree.stats().freed);
+}
+
+/* readers running alongside the writer always see every key inserted before their snapshot */
+TEST(CowTree, ConcurrentReaders)
+{
+  constexpr u32 keys = 1500;
+  std::stringstream ss;
+  Pager pager(ss, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  CowTree<u32> tree(pager);
+
+  std::atomic<bool> done = false;
+  std::atomic<u32> failures = 0;
+  std::vector<std::thread> readers;
+  for (u32 t{0}; t < 4; ++t)
+  {
+    readers.emplace_back(
+        [&]
+        {
+          while (!done)
+          {
+            const CowTree<u32>::Snapshot snapshot = tree.snapshot();
+            const std::vector<u32> seen = keysOf(snapshot);
+            // keys go in ascending, so a whole version is a prefix of them
+            for (u32 i{0}; i < seen.size(); ++i)
+            {
+              if (seen[i] != i)
+              {
+                failures++;
+                break;
+              }
+            }
+            if (!seen.empty() && !snapshot.contains(seen.back()))
+            {
+              failures++;
+            }
+          }
+        });
+  }
+
+  for (u32 key{0}; key < keys; ++key)
+  {
+    tree.insert(key);
+  }
+  done = true;
+  for (auto &t : readers)
+  {
+    t.join();
+  }
+  EXPECT_EQ(0, failures);
+  EXPECT_EQ(keys, keysOf(tree.snapshot()).size());
+}
+
+/* erased keys are gone from new snapshots, and lower bounds step over empty leaves */
+TEST(CowTree, EraseAndLowerBound)
+{
+  std::stringstream ss;
+  Pager pager(ss, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  CowTree<u32> tree(pager);
+  for (u32 key{0}; key < 300; ++key)
+  {
+    tree.insert(key * 10);
+  }
+  for (u32 key{100}; key < 200; ++key)
+  {
+    ASSERT_TRUE(tree.erase(key * 10));
+  }
+  EXPECT_FALSE(tree.erase(5));
+
+  const CowTree<u32>::Snapshot snapshot = tree.snapshot();
+  EXPECT_EQ(200, keysOf(snapshot).size());
+  EXPECT_FALSE(snapshot.contains(1500));
+  EXPECT_EQ(0, snapshot.lowerBound(0));
+  EXPECT_EQ(20, snapshot.lowerBound(11));
+  EXPECT_EQ(2000, snapshot.lowerBound(991));
+  EXPECT_EQ(std::nullopt, snapshot.lowerBound(2991));
+}
+
+/* splitting interior nodes never writes to pages an older version can still reach */
+TEST(CowTree, SplitsLeaveSnapshotPages)
+{
+  std::stringstream ss;
+  Pager pager(ss, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  CowTree<u32> tree(pager);
+  for (u32 key{0}; key < 3000; ++key)
+  {
+    tree.insert(key * 4);
+  }
+
+  const CowTree<u32>::Snapshot before = tree.snapshot();
+  std::map<PageId, Image> pages;
+  imageOf(pager, before.root(), pages);
+  // deep enough that the inserts below split interior nodes
+  const PageId child =
+      InteriorNode::childFor(pager.readPage<BTreeHeader>(before.root()).header()->slots, 0u);
+  ASSERT_FALSE(pager.readPage<BTreeHeader>(child).header()->isLeaf());
+  // more than fits in the half full leaves, and downwards so the lower half of a split node still
+  // has children the snapshot shares
+  for (u32 key{3000}; key > 0; --key)
+  {
+    tree.insert(key * 4 - 1);
+    tree.insert(key * 4 - 2);
+  }
+
+  for (const auto &[id, image] : pages)
+  {
+    PageBuffer now = pager.readPage(id).buf;
+    // the checksum is set again whenever the page is written back
+    reinterpret_cast<CommonHeader *>(now.data())->checksum = image.checksum;
+    EXPECT_EQ(image.page, now) << id;
+  }
+  EXPECT_EQ(3000, keysOf(before).size());
+}
@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+
+#include "btree_fixture.hpp"
+#include "database/btree_cursor.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+using Bound = BTreeCursor<u32>::Bound;
+
+std::vector<u32> shuffled(u32 n)
+{
+  std::vector<u32> keys;
+  for (u32 i{0}; i < n; ++i)
+  {
+    keys.push_back(i * 2);
+  }
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+  return keys;
+}
+
+std::vector<u32> collect(BTreeCursor<u32> &cursor, const std::optional<Bound> &lower,
+                         const std::optional<Bound> &upper, bool reverse = false)
+{
+  std::vector<u32> keys;
+  const auto add = [&keys](u32 key) { keys.push_back(key); };
+  const std::size_t n =
+      reverse ? cursor.reverseRange(lower, upper, add) : cursor.range(lower, upper, add);
+  EXPECT_EQ(n, keys.size());
+  return keys;
+}
+} // namespace
+
+/* splits keep both sibling links right, so the chain holds every key in order either way */
+TEST(Cursor, ChainBothWays)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  const std::vector<u32> keys = shuffled(1000);
+  const PageId root = build(pager, keys);
+  ASSERT_FALSE(pager.readPage<BTreeHeader>(root).header()->isLeaf());
+
+  std::vector<u32> sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+
+  BTreeCursor<u32> cursor(pager, root);
+  std::vector<u32> forward;
+  for (bool on = cursor.first(); on; on = cursor.next())
+  {
+    forward.push_back(cursor.key());
+  }
+  EXPECT_EQ(sorted, forward);
+
+  std::vector<u32> backward;
+  for (bool on = cursor.last(); on; on = cursor.prev())
+  {
+    backward.push_back(cursor.key());
+  }
+  std::reverse(backward.begin(), backward.end());
+  EXPECT_EQ(sorted, backward);
+}
+
+/* seeking lands on the first key at or after the one asked for, and stepping turns around */
+TEST(Cursor, SeekAndStep)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  const PageId root = build(pager, shuffled(1000));
+  BTreeCursor<u32> cursor(pager, root);
+
+  for (u32 key : {0u, 1u, 500u, 777u, 1997u})
+  {
+    ASSERT_TRUE(cursor.seek(key)) << key;
+    EXPECT_EQ((key + 1) / 2 * 2, cursor.key());
+    ASSERT_TRUE(cursor.seekAfter(key)) << key;
+    EXPECT_EQ(key / 2 * 2 + 2, cursor.key());
+    if (cursor.prev())
+    {
+      EXPECT_EQ(key / 2 * 2, cursor.key());
+    }
+  }
+  EXPECT_FALSE(cursor.seek(1999));
+  EXPECT_FALSE(cursor.valid());
+  EXPECT_FALSE(cursor.seekAfter(1998));
+
+  ASSERT_TRUE(cursor.first());
+  EXPECT_FALSE(cursor.prev());
+  EXPECT_FALSE(cursor.next());
+}
+
+/* each end of a range can be open, inclusive or exclusive, in either direction */
+TEST(Cursor, Ranges)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  const PageId root = build(pager, shuffled(1000));
+  BTreeCursor<u32> cursor(pager, root);
+
+  const auto expected = [](u32 from, u32 to)
+  {
+    std::vector<u32> keys;
+    for (u32 key = from; key <= to; key += 2)
+    {
+      keys.push_back(key);
+    }
+    return keys;
+  };
+
+  EXPECT_EQ(expected(100, 200), collect(cursor, Bound{100}, Bound{200}));
+  EXPECT_EQ(expected(102, 198), collect(cursor, Bound{100, false}, Bound{200, false}));
+  EXPECT_EQ(expected(102, 200), collect(cursor, Bound{101}, Bound{201, false}));
+  EXPECT_EQ(expected(0, 10), collect(cursor, std::nullopt, Bound{10}));
+  EXPECT_EQ(expected(1990, 1998), collect(cursor, Bound{1990}, std::nullopt));
+  EXPECT_TRUE(collect(cursor, Bound{300}, Bound{300, false}).empty());
+
+  std::vector<u32> down = expected(102, 200);
+  std::reverse(down.begin(), down.end());
+  EXPECT_EQ(down, collect(cursor, Bound{100, false}, Bound{200}, true));
+  down = expected(0, 1998);
+  std::reverse(down.begin(), down.end());
+  EXPECT_EQ(down, collect(cursor, std::nullopt, std::nullopt, true));
+  EXPECT_EQ(std::vector<u32>{1998}, collect(cursor, Bound{1997}, Bound{5000}, true));
+}
+
+/* a key repeated over many leaves is found from its first copy, whichever way and bounds a range
+ * takes */
+TEST(Cursor, RepeatedKeys)
+{
+  std::vector<u32> keys(600, 10);
+  keys.insert(keys.end(), 50, 5);
+  keys.insert(keys.end(), 50, 20);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+  std::stringstream ss;
+  Pager pager(ss);
+  const PageId root = build(pager, keys);
+  BTreeCursor<u32> cursor(pager, root);
+  std::sort(keys.begin(), keys.end());
+
+  // the keys of the sorted reference that fall between the bounds
+  const auto expected = [&keys](const std::optional<Bound> &lower, const std::optional<Bound> &upper,
+                                bool reverse)
+  {
+    std::vector<u32> in;
+    for (u32 key : keys)
+    {
+      if ((!lower.has_value() || (lower->inclusive ? lower->key <= key : lower->key < key)) &&
+          (!upper.has_value() || (upper->inclusive ? key <= upper->key : key < upper->key)))
+      {
+        in.push_back(key);
+      }
+    }
+    if (reverse)
+    {
+      std::reverse(in.begin(), in.end());
+    }
+    return in;
+  };
+
+  const auto describe = [](const std::optional<Bound> &bound)
+  {
+    return !bound.has_value() ? std::string("open")
+                              : std::to_string(bound->key) + (bound->inclusive ? "]" : ")");
+  };
+  std::vector<std::optional<Bound>> bounds{std::nullopt};
+  for (u32 key : {0u, 5u, 7u, 10u, 15u, 20u, 30u})
+  {
+    bounds.push_back(Bound{key});
+    bounds.push_back(Bound{key, false});
+  }
+  for (const std::optional<Bound> &lower : bounds)
+  {
+    for (const std::optional<Bound> &upper : bounds)
+    {
+      for (bool reverse : {false, true})
+      {
+        EXPECT_EQ(expected(lower, upper, reverse), collect(cursor, lower, upper, reverse))
+            << describe(lower) << " " << describe(upper) << " " << reverse;
+      }
+    }
+  }
+}
+
+/* an empty tree has nothing to walk */
+TEST(Cursor, Empty)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  const PageId root = build(pager, {});
+  BTreeCursor<u32> cursor(pager, root);
+  EXPECT_FALSE(cursor.first());
+  EXPECT_FALSE(cursor.last());
+  EXPECT_FALSE(cursor.seek(0));
+  EXPECT_TRUE(collect(cursor, std::nullopt, std::nullopt).empty());
+}
@@ -69,9 +69,9 @@ TEST(Database, InMemory)
   EXPECT_EQ(PageType::First, p.header()->type);
 }
 
-/* the database free list is a linked list of the entirely free pages on disk.
- * marking a page as free sets it as the head of the linked list and sets its pointer to the
- * previous head */
+/* the database free list is a chain of trunk pages listing the free pages on disk.
+ * freeing a page with no trunk to put it in makes it the new head trunk, and allocating from an
+ * empty trunk hands out the trunk itself */
 TEST_F(TempFileFixture, Freelist)
 {
   std::fstream f;
@@ -82,33 +82,35 @@ TEST_F(TempFileFixture, Freelist)
   EXPECT_EQ(0, firstPage.header()->db.freelist);
   PageId a = db.pager.nextFree();
   EXPECT_EQ(1, a);
-  EXPECT_EQ(PAGE_SIZE * 2, db.pager.fsize());
+  EXPECT_EQ(DEFAULT_PAGE_SIZE * 2, db.pager.fsize());
 
   PageId b = db.pager.nextFree();
   EXPECT_EQ(2, b);
-  EXPECT_EQ(PAGE_SIZE * 3, db.pager.fsize());
+  EXPECT_EQ(DEFAULT_PAGE_SIZE * 3, db.pager.fsize());
 
-  // freeing a page marks it as free and sets the linked list
+  // freeing a page with no trunk makes it the head trunk
   Page<> &pageA = db.pager.getPage(a);
   pageA.header()->type = PageType::Interior;
   db.pager.freePage(a);
   EXPECT_EQ(PageType::Freelist, pageA.header()->type);
   EXPECT_EQ(a, firstPage.header()->db.freelist);
 
-  // reuse previously freed page
-  a = db.pager.nextFree();
+  // reuse previously freed page, reset to the type asked for
+  a = db.pager.nextFree(PageType::Interior);
   EXPECT_EQ(1, a);
   EXPECT_EQ(0, firstPage.header()->db.freelist);
-  EXPECT_EQ(PAGE_SIZE * 3, db.pager.fsize());
-  const Page<> &freeA = db.pager.getPage(a);
-  EXPECT_EQ(PageType::Freelist, freeA.header()->type);
-
+  EXPECT_EQ(DEFAULT_PAGE_SIZE * 3, db.pager.fsize());
+  EXPECT_EQ(PageType::Interior, db.pager.readPage(a).header()->type);
 
   db.pager.freePage(a);
   db.pager.freePage(b);
 
-  // the list should be in reverse order
-  EXPECT_EQ(b, firstPage.header()->db.freelist);
+  // b is listed in a, which is handed out last
+  EXPECT_EQ(a, firstPage.header()->db.freelist);
+  auto &trunk = db.pager.getPage<FreelistPage::Header>(a);
+  ASSERT_EQ(1, trunk.header()->count);
+  EXPECT_EQ(b, FreelistPage::ids(trunk)[0]);
+
   b = db.pager.nextFree();
   EXPECT_EQ(2, b);
   EXPECT_EQ(a, firstPage.header()->db.freelist);
@@ -116,3 +118,111 @@ TEST_F(TempFileFixture, Freelist)
   EXPECT_EQ(1, a);
   EXPECT_EQ(0, firstPage.header()->db.freelist);
 }
+
+/* pages in a trunk are handed out lowest first without reading them */
+TEST(Database, FreelistNoReads)
+{
+  std::stringstream ss;
+  Pager pager(ss, 0);
+  std::vector<PageId> ids;
+  for (u32 i{0}; i < 4 * pager.cacheCapacity(); ++i)
+  {
+    ids.push_back(pager.nextFree());
+  }
+  for (PageId id : ids)
+  {
+    pager.freePage(id);
+  }
+  pager.flush();
+
+  const u64 reads = pager.stats().reads;
+  // the first id became the trunk
+  for (std::size_t i{1}; i < ids.size(); ++i)
+  {
+    EXPECT_EQ(ids[i], pager.nextFree());
+  }
+  EXPECT_EQ(ids[0], pager.nextFree());
+  EXPECT_EQ(reads, pager.stats().reads);
+}
+
+/* runs of adjacent pages come from the free list when it has one, otherwise the end of the file */
+TEST(Database, FreelistRun)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  for (u32 i{0}; i < 10; ++i)
+  {
+    UNUSED(pager.nextFree());
+  }
+  for (PageId id : {1, 3, 5, 6, 7, 9})
+  {
+    pager.freePage(id);
+  }
+
+  EXPECT_EQ(5, pager.nextFreeRun(3));
+  EXPECT_EQ(11, pager.nextFreeRun(2, PageType::Interior));
+  EXPECT_EQ(13 * DEFAULT_PAGE_SIZE, pager.fsize());
+  EXPECT_EQ(PageType::Interior, pager.readPage(12).header()->type);
+  EXPECT_EQ(3, pager.nextFree());
+  EXPECT_EQ(9, pager.nextFree());
+  EXPECT_EQ(1, pager.nextFree());
+}
+
+/* the page size is chosen when the database is created and read back from its header after */
+TEST(Database, PageSizeStoredInHeader)
+{
+  std::stringstream ss;
+  {
+    Database db(ss, 16 * 1024);
+    EXPECT_EQ(16 * 1024, db.pager.pageSize());
+    EXPECT_EQ(16 * 1024, db.pager.fsize());
+    EXPECT_EQ(16 * 1024, db.pager.readPage<FirstPage::Header>(0).header()->db.pageSize);
+    PageId id = db.pager.nextFree(PageType::Interior);
+    db.pager.getPage(id).buf[16 * 1024 - 1] = static_cast<std::byte>(5);
+  }
+  ASSERT_EQ(2 * 16 * 1024, ss.str().size());
+
+  // the page size asked for is ignored for an existing database
+  Database db(ss, MIN_PAGE_SIZE);
+  EXPECT_EQ(16 * 1024, db.pager.pageSize());
+  EXPECT_EQ(PageType::Interior, db.pager.readPage(1).header()->type);
+  EXPECT_EQ(static_cast<std::byte>(5), db.pager.readPage(1).buf[16 * 1024 - 1]);
+}
+
+TEST(Database, InvalidPageSize)
+{
+  std::stringstream ss;
+  EXPECT_THROW({ Database db(ss, 256); }, std::invalid_argument);
+  EXPECT_THROW({ Database db(ss, 1000); }, std::invalid_argument);
+  EXPECT_THROW({ Database db(ss, 2 * MAX_PAGE_SIZE); }, std::invalid_argument);
+}
+
+/* a file written before the format was versioned, in its own byte layout, is refused */
+TEST(Database, BaselineFile)
+{
+  // 512 byte pages, the first holding a 4 byte type, a u16 version of 1 and a u32 free list
+  std::string contents(2 * MIN_PAGE_SIZE, '\0');
+  const u32 first = PageType::First;
+  const u16 version = 1;
+  std::memcpy(contents.data(), &first, sizeof(first));
+  std::memcpy(contents.data() + 4, &version, sizeof(version));
+  std::stringstream ss(contents);
+
+  EXPECT_THROW({ Database db(ss); }, PageError);
+}
+
+/* a file from another version of the format is refused rather than misread */
+TEST(Database, OtherVersion)
+{
+  std::stringstream ss;
+  {
+    Database db(ss);
+  }
+  std::string contents = ss.str();
+  const u16 version = DATABASE_VERSION + 1;
+  std::memcpy(contents.data() + offsetof(FirstPage::Header, db) + offsetof(DatabaseHeader, version),
+              &version, sizeof(version));
+  std::stringstream other(contents);
+
+  EXPECT_THROW({ Database db(other); }, PageError);
+}
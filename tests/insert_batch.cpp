@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include "btree_fixture.hpp"
+#include "database/btree_cursor.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+PageId emptyTree(Pager &pager)
+{
+  PageId root{};
+  UNUSED(pager.fromNextFree<BTreeHeader>(PageType::Leaf, &root));
+  return root;
+}
+
+std::vector<u32> randomKeys(u32 n, u32 seed, u32 range)
+{
+  std::mt19937 rng(seed);
+  std::vector<u32> keys(n);
+  for (u32 &key : keys)
+  {
+    key = rng() % range;
+  }
+  return keys;
+}
+} // namespace
+
+/* a batch into an empty tree splits its one leaf into as many as it needs at once */
+TEST(InsertBatch, IntoEmptyTree)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  const u32 order = btreeOrder(DEFAULT_PAGE_SIZE);
+  const std::vector<u32> keys = randomKeys(order * 5 + 3, 1, 1u << 30);
+  const PageId root = insertBatch(pager, emptyTree(pager), keys);
+
+  // one parent over six leaves, evenly filled
+  ASSERT_FALSE(pager.readPage<BTreeHeader>(root).header()->isLeaf());
+  const auto &slots = pager.readPage<BTreeHeader>(root).header()->slots;
+  EXPECT_EQ(6, slots.entryCount());
+  for (const Slot &s : slots)
+  {
+    const PageId leaf =
+        reinterpret_cast<const InteriorCell<u32> *>(slots.readCell(s.cellOffset))->leftChild;
+    const SlotNum count = pager.readPage<BTreeHeader>(leaf).header()->slots.entryCount();
+    EXPECT_GE(count, order * 5 / 6);
+    EXPECT_LE(count, order);
+  }
+  checkTree(pager, root, keys);
+}
+
+/* batches land in a tree that already has several levels, including keys it already has */
+TEST(InsertBatch, IntoExistingTree)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  PageId root = emptyTree(pager);
+  std::vector<u32> all;
+  for (u32 batch{0}; batch < 20; ++batch)
+  {
+    const std::vector<u32> keys = randomKeys(batch * 500 + 1, batch, 20000);
+    root = insertBatch(pager, root, keys);
+    all.insert(all.end(), keys.begin(), keys.end());
+    EXPECT_TRUE(pager.readPage<BTreeHeader>(root).header()->isRoot());
+  }
+  checkTree(pager, root, all);
+
+  for (u32 key : {all.front(), all[all.size() / 2], all.back()})
+  {
+    const Page<BTreeHeader> &leaf = InteriorNode::searchGetLeaf(pager, root, key);
+    const auto [first, last] = LeafNode::equalRange<u32>(leaf.header()->slots, key);
+    EXPECT_LT(first, last) << key;
+  }
+}
+
+/* single inserts and batches build the same set of keys, and interior splits keep the parents */
+TEST(InsertBatch, MatchesSingleInserts)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  const std::vector<u32> keys = randomKeys(30000, 9, 1u << 20);
+
+  const PageId single = build(pager, keys);
+  checkTree(pager, single, keys);
+
+  PageId batched = emptyTree(pager);
+  for (std::size_t from{0}; from < keys.size(); from += 3000)
+  {
+    batched = insertBatch(
+        pager, batched,
+        std::vector<u32>(keys.begin() + from, keys.begin() + std::min(from + 3000, keys.size())));
+  }
+  checkTree(pager, batched, keys);
+}
+
+/* an empty batch leaves the tree alone */
+TEST(InsertBatch, Empty)
+{
+  std::stringstream ss;
+  Pager pager(ss);
+  const PageId root = emptyTree(pager);
+  EXPECT_EQ(root, insertBatch<u32>(pager, root, {}));
+  EXPECT_TRUE(pager.readPage<BTreeHeader>(root).header()->slots.isEmpty());
+}
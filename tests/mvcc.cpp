@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+
+#include "database/mvcc.hpp"
+
+#include <random>
+#include <thread>
+
+using Store = MvccStore<u32, u32>;
+
+/* a transaction reads the store as it was when it began, plus its own writes */
+TEST(Mvcc, SnapshotIsolation)
+{
+  std::stringstream ss;
+  Pager pager(ss, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  Store store(pager);
+
+  Store::Transaction setup = store.begin();
+  setup.put(1, 10);
+  setup.put(2, 20);
+  EXPECT_EQ(10, setup.get(1));
+  ASSERT_TRUE(setup.commit());
+
+  Store::Transaction reader = store.begin();
+  Store::Transaction writer = store.begin();
+  writer.put(1, 11);
+  writer.erase(2);
+  writer.put(3, 30);
+  EXPECT_EQ(std::nullopt, writer.get(2));
+  ASSERT_TRUE(writer.commit());
+
+  EXPECT_EQ(10, reader.get(1));
+  EXPECT_EQ(20, reader.get(2));
+  EXPECT_EQ(std::nullopt, reader.get(3));
+
+  Store::Transaction after = store.begin();
+  EXPECT_EQ(11, after.get(1));
+  EXPECT_EQ(std::nullopt, after.get(2));
+  EXPECT_EQ(30, after.get(3));
+  EXPECT_EQ(std::nullopt, after.get(4));
+}
+
+/* of two transactions writing the same row, the second to commit is refused */
+TEST(Mvcc, FirstCommitterWins)
+{
+  std::stringstream ss;
+  Pager pager(ss, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  Store store(pager);
+
+  Store::Transaction a = store.begin();
+  Store::Transaction b = store.begin();
+  a.put(7, 1);
+  b.put(7, 2);
+  b.put(8, 2);
+  EXPECT_TRUE(a.commit());
+  EXPECT_FALSE(b.commit());
+  EXPECT_EQ(1, store.stats().conflicts);
+
+  Store::Transaction check = store.begin();
+  EXPECT_EQ(1, check.get(7));
+  EXPECT_EQ(std::nullopt, check.get(8));
+}
+
+/* a store opened over an existing tree carries on from the timestamps already in it */
+TEST(Mvcc, Reopen)
+{
+  std::stringstream ss;
+  Pager pager(ss, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  PageId root;
+  u64 ts;
+  {
+    Store store(pager);
+    for (u32 i{0}; i < 5; ++i)
+    {
+      Store::Transaction t = store.begin();
+      t.put(1, i);
+      ASSERT_TRUE(t.commit());
+    }
+    root = store.root();
+    ts = store.begin().timestamp();
+  }
+
+  Store store(pager, root);
+  Store::Transaction t = store.begin();
+  EXPECT_EQ(ts, t.timestamp());
+  EXPECT_EQ(4, t.get(1));
+  t.put(1, 10);
+  ASSERT_TRUE(t.commit());
+  EXPECT_EQ(10, store.begin().get(1));
+}
+
+/* old versions are only dropped once no running transaction can see them */
+TEST(Mvcc, Collect)
+{
+  std::stringstream ss;
+  Pager pager(ss, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  Store store(pager);
+
+  Store::Transaction first = store.begin();
+  first.put(1, 0);
+  first.put(2, 0);
+  ASSERT_TRUE(first.commit());
+
+  Store::Transaction old = store.begin();
+  for (u32 i{1}; i <= 100; ++i)
+  {
+    Store::Transaction t = store.begin();
+    t.put(1, i);
+    ASSERT_TRUE(t.commit());
+  }
+  Store::Transaction erase = store.begin();
+  erase.erase(2);
+  ASSERT_TRUE(erase.commit());
+
+  // the old transaction still sees the first versions, only those in between go
+  EXPECT_EQ(99, store.collect());
+  EXPECT_EQ(0, old.get(1));
+  EXPECT_EQ(0, old.get(2));
+
+  old.abort();
+  // now the first version of 1 is hidden, and 2 is gone with its erase
+  EXPECT_EQ(3, store.collect());
+  Store::Transaction now = store.begin();
+  EXPECT_EQ(100, now.get(1));
+  EXPECT_EQ(std::nullopt, now.get(2));
+  EXPECT_EQ(0, store.collect());
+}
+
+/* transfers between accounts never change the total any snapshot sees */
+TEST(Mvcc, ConcurrentTransfers)
+{
+  constexpr u32 accounts = 16;
+  constexpr u32 balance = 100;
+  std::stringstream ss;
+  Pager pager(ss, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  Store store(pager);
+  {
+    Store::Transaction t = store.begin();
+    for (u32 i{0}; i < accounts; ++i)
+    {
+      t.put(i, balance);
+    }
+    ASSERT_TRUE(t.commit());
+  }
+  store.startCollector(std::chrono::milliseconds{1});
+
+  std::atomic<bool> done = false;
+  std::atomic<u32> badTotals = 0;
+  std::vector<std::thread> readers;
+  for (u32 r{0}; r < 2; ++r)
+  {
+    readers.emplace_back(
+        [&]
+        {
+          while (!done)
+          {
+            Store::Transaction t = store.begin();
+            u32 total = 0;
+            for (u32 i{0}; i < accounts; ++i)
+            {
+              total += t.get(i).value_or(0);
+            }
+            if (total != accounts * balance)
+            {
+              badTotals++;
+            }
+          }
+        });
+  }
+
+  std::vector<std::thread> writers;
+  for (u32 w{0}; w < 2; ++w)
+  {
+    writers.emplace_back(
+        [&, w]
+        {
+          std::mt19937 rng(w);
+          std::uniform_int_distribution<u32> pick(0, accounts - 1);
+          for (u32 n{0}; n < 200; ++n)
+          {
+            const u32 from = pick(rng);
+            const u32 to = (from + 1 + pick(rng) % (accounts - 1)) % accounts;
+            while (true)
+            {
+              Store::Transaction t = store.begin();
+              const u32 a = *t.get(from);
+              const u32 amount = std::min<u32>(a, 5);
+              t.put(from, a - amount);
+              t.put(to, *t.get(to) + amount);
+              if (t.commit())
+              {
+                break;
+              }
+            }
+          }
+        });
+  }
+  for (auto &t : writers)
+  {
+    t.join();
+  }
+  done = true;
+  for (auto &t : readers)
+  {
+    t.join();
+  }
+  store.stopCollector();
+
+  EXPECT_EQ(0, badTotals);
+  EXPECT_EQ(401, store.stats().commits);
+  EXPECT_GT(store.stats().collected, 0);
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include "database/pager.hpp"
+#include "database/pages/btree.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+/* write leaves linked in the order given, the last one has no sibling */
+void writeChain(Pager &pager, const std::vector<PageId> &order)
+{
+  for (std::size_t i{0}; i < order.size(); ++i)
+  {
+    LeafNode leaf{pager.getPage<BTreeHeader>(order[i])};
+    leaf.setSibling(i + 1 < order.size() ? order[i + 1] : 0);
+    leaf.page.buf[0] = static_cast<std::byte>(i);
+  }
+}
+
+/* follow the sibling chain like a range scan would, for at most `limit` leaves */
+std::size_t scan(Pager &pager, PageId first, std::size_t limit = SIZE_MAX)
+{
+  std::size_t n = 0;
+  const std::byte start = pager.readPage(first).buf[0];
+  for (PageId id = first; id != 0 && n < limit; ++n)
+  {
+    const Page<> &page = pager.readPage(id);
+    EXPECT_EQ(static_cast<std::byte>(static_cast<u8>(start) + n), page.buf[0]);
+    pager.readAhead(id, LeafNode::siblingOf);
+    id = LeafNode::siblingOf(page);
+  }
+  return n;
+}
+
+std::vector<PageId> allocate(std::stringstream &ss, std::size_t leaves, bool shuffle)
+{
+  Pager pager(ss);
+  std::vector<PageId> ids;
+  for (std::size_t i{0}; i < leaves; ++i)
+  {
+    ids.push_back(pager.nextFree(PageType::Leaf));
+  }
+  if (shuffle)
+  {
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(1));
+  }
+  writeChain(pager, ids);
+  return ids;
+}
+} // namespace
+
+/* leaves that follow each other on disk are read ahead by id and the window grows */
+TEST(ReadAhead, Sequential)
+{
+  std::stringstream ss;
+  const std::vector<PageId> ids = allocate(ss, 100, false);
+
+  Pager pager(ss);
+  pager.useAsyncIO(AsyncIO::create(pager.storage()));
+  const u64 reads = pager.stats().reads;
+  EXPECT_EQ(ids.size(), scan(pager, ids.front()));
+
+  // only the first leaf had to wait for a read
+  EXPECT_EQ(reads + 1, pager.stats().reads);
+  EXPECT_EQ(ids.size() - 1, pager.stats().prefetchHits);
+  EXPECT_EQ(0, pager.stats().readAheadWasted);
+  EXPECT_EQ(Pager::MAX_READAHEAD, pager.readAheadWindow());
+}
+
+/* a scan that stops early wastes what was read ahead, so the window shrinks again */
+TEST(ReadAhead, AbandonedScan)
+{
+  std::stringstream ss;
+  const std::vector<PageId> ids = allocate(ss, 100, false);
+
+  Pager pager(ss);
+  pager.useAsyncIO(AsyncIO::create(pager.storage()));
+  scan(pager, ids.front(), 10);
+  const u32 window = pager.readAheadWindow();
+  EXPECT_LT(Pager::MIN_READAHEAD, window);
+
+  // starting another scan somewhere else gives up on the first
+  scan(pager, ids[60], 1);
+  EXPECT_LT(0, pager.stats().readAheadWasted);
+  EXPECT_EQ(window / 2, pager.readAheadWindow());
+}
+
+/* leaves scattered over the file are still read one ahead by following the chain */
+TEST(ReadAhead, Scattered)
+{
+  std::stringstream ss;
+  const std::vector<PageId> ids = allocate(ss, 40, true);
+
+  Pager pager(ss);
+  pager.useAsyncIO(AsyncIO::create(pager.storage()));
+  EXPECT_EQ(ids.size(), scan(pager, ids.front()));
+  EXPECT_LT(0, pager.stats().readAhead);
+  EXPECT_EQ(pager.stats().readAhead, pager.stats().prefetchHits);
+}
+
+/* without asynchronous I/O read ahead is only a hint and the scan still works */
+TEST(ReadAhead, Synchronous)
+{
+  std::stringstream ss;
+  const std::vector<PageId> ids = allocate(ss, 20, false);
+
+  Pager pager(ss);
+  EXPECT_EQ(ids.size(), scan(pager, ids.front()));
+  EXPECT_EQ(0, pager.stats().readAhead);
+}
+
+/* scans that keep their own state can take turns without wasting each other's read ahead */
+TEST(ReadAhead, Interleaved)
+{
+  std::stringstream ss;
+  const std::vector<PageId> ids = allocate(ss, 200, false);
+
+  Pager pager(ss);
+  pager.useAsyncIO(AsyncIO::create(pager.storage()));
+  Pager::ReadAhead scans[2];
+  PageId at[2] = {ids[0], ids[100]};
+  for (int step{0}; step < 40; ++step)
+  {
+    for (int i{0}; i < 2; ++i)
+    {
+      const Page<> &page = pager.readPage(at[i]);
+      pager.readAhead(at[i], LeafNode::siblingOf, scans[i]);
+      at[i] = LeafNode::siblingOf(page);
+    }
+  }
+  EXPECT_EQ(0, pager.stats().readAheadWasted);
+  EXPECT_EQ(Pager::MAX_READAHEAD, scans[0].window);
+  EXPECT_EQ(Pager::MAX_READAHEAD, scans[1].window);
+
+  // ending a scan gives up on what it read ahead and leaves the other alone
+  const std::size_t left = scans[0].issued.size();
+  EXPECT_LT(0, left);
+  pager.endScan(scans[0]);
+  EXPECT_EQ(left, pager.stats().readAheadWasted);
+  EXPECT_TRUE(scans[0].issued.empty());
+  EXPECT_FALSE(scans[1].issued.empty());
+  pager.endScan(scans[1]);
+}
@@ -6,9 +6,9 @@
 TEST(SlotsIterator, ValuesSorted)
 {
   std::array<std::byte, 512> buf = {static_cast<std::byte>(0)};
-  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader<0>);
-  SlotHeader<bufsize> &sh = *reinterpret_cast<SlotHeader<bufsize> *>(buf.data());
-  sh = SlotHeader<bufsize>();
+  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader);
+  SlotHeader &sh = *reinterpret_cast<SlotHeader *>(buf.data());
+  sh = SlotHeader(bufsize);
   sh.insertCell(LeafCell(static_cast<u32>(3)));
   sh.insertCell(LeafCell(static_cast<u32>(2)));
   sh.insertCell(LeafCell(static_cast<u32>(1)));
@@ -28,9 +28,9 @@ TEST(SlotsIterator, ValuesSorted)
 TEST(SlotsIterator, IterateEndSlot)
 {
   std::array<std::byte, 512> buf = {static_cast<std::byte>(0)};
-  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader<0>);
-  SlotHeader<bufsize> &sh = *reinterpret_cast<SlotHeader<bufsize> *>(buf.data());
-  sh = SlotHeader<bufsize>();
+  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader);
+  SlotHeader &sh = *reinterpret_cast<SlotHeader *>(buf.data());
+  sh = SlotHeader(bufsize);
   sh.insertCell(InteriorCell<u32>::End());
   sh.insertCell(InteriorCell(static_cast<u32>(1)));
   sh.insertCell(InteriorCell(static_cast<u32>(2)));
@@ -61,9 +61,9 @@ TEST(SlotsIterator, IterateEndSlot)
 TEST(SlotsIterator, ReferenceAddress)
 {
   std::array<std::byte, 512> buf = {static_cast<std::byte>(0)};
-  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader<0>);
-  SlotHeader<bufsize> &sh = *reinterpret_cast<SlotHeader<bufsize> *>(buf.data());
-  sh = SlotHeader<bufsize>();
+  constexpr std::size_t bufsize = buf.size() - sizeof(SlotHeader);
+  SlotHeader &sh = *reinterpret_cast<SlotHeader *>(buf.data());
+  sh = SlotHeader(bufsize);
 
   const Slot *slot = sh.insertCell(LeafCell(static_cast<u32>(3)));
 
@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include "database_fixture.hpp"
+#include "database/database.hpp"
+
+#include <sys/stat.h>
+
+/* writes to a stream past its end fill the gap with zeros */
+TEST(StreamStorage, WritePastEnd)
+{
+  std::stringstream ss;
+  StreamStorage storage(ss);
+  const std::array<std::byte, 4> data = {std::byte{1}, std::byte{2}, std::byte{3}, std::byte{4}};
+  ASSERT_TRUE(storage.write(8, data));
+  EXPECT_EQ(12, storage.size());
+
+  std::array<std::byte, 12> back{};
+  ASSERT_TRUE(storage.read(0, back));
+  EXPECT_EQ(std::byte{0}, back[7]);
+  EXPECT_EQ(std::byte{4}, back[11]);
+  EXPECT_FALSE(storage.read(8, back));
+}
+
+/* pages that are not in the cache are read straight out of the mapping */
+TEST_F(TempFileFixture, MmapReadsInPlace)
+{
+  auto storage = std::make_unique<MmapStorage>(path);
+  MmapStorage &mapped = *storage;
+  Database db(std::move(storage));
+
+  const PageId id = db.pager.nextFree(PageType::Interior);
+  db.pager.getPage(id).buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(9);
+  // cached pages are newer than the mapping
+  EXPECT_EQ(nullptr, mapped.map(id * DEFAULT_PAGE_SIZE, DEFAULT_PAGE_SIZE));
+  db.pager.flush();
+
+  // the write went into the mapping, but the cache still has the page
+  ASSERT_NE(nullptr, mapped.map(id * DEFAULT_PAGE_SIZE, DEFAULT_PAGE_SIZE));
+  EXPECT_NE(static_cast<const void *>(mapped.map(id * DEFAULT_PAGE_SIZE, DEFAULT_PAGE_SIZE)),
+            static_cast<const void *>(db.pager.readPage(id).buf.data()));
+}
+
+/* a reopened database is read without copying into the cache */
+TEST_F(TempFileFixture, MmapReopen)
+{
+  PageId id{};
+  {
+    Database db(std::make_unique<MmapStorage>(path));
+    id = db.pager.nextFree(PageType::Interior);
+    db.pager.getPage(id).buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(9);
+  }
+  EXPECT_EQ(2 * DEFAULT_PAGE_SIZE, std::filesystem::file_size(path));
+
+  auto storage = std::make_unique<MmapStorage>(path);
+  MmapStorage &mapped = *storage;
+  Database db(std::move(storage));
+  const std::size_t cached = db.pager.cachedPages();
+
+  const Page<> &page = db.pager.readPage(id);
+  EXPECT_EQ(static_cast<const void *>(mapped.map(id * DEFAULT_PAGE_SIZE, DEFAULT_PAGE_SIZE)),
+            static_cast<const void *>(page.buf.data()));
+  EXPECT_EQ(PageType::Interior, page.header()->type);
+  EXPECT_EQ(static_cast<std::byte>(9), page.buf[DEFAULT_PAGE_SIZE - 1]);
+
+  {
+    SharedPage<> shared = db.pager.pinShared(id);
+    EXPECT_EQ(&page, &shared.page());
+  }
+  EXPECT_EQ(cached, db.pager.cachedPages());
+
+  // writing copies the page into the cache, which readers then see
+  {
+    ExclusivePage<> exclusive = db.pager.pinExclusive(id);
+    EXPECT_NE(&page, &exclusive.page());
+    exclusive->buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(10);
+  }
+  EXPECT_EQ(static_cast<std::byte>(10), db.pager.readPage(id).buf[DEFAULT_PAGE_SIZE - 1]);
+  EXPECT_EQ(static_cast<std::byte>(9), page.buf[DEFAULT_PAGE_SIZE - 1]);
+  db.pager.advise(1, 1, Storage::Access::Sequential);
+}
+
+/* a page being read in place isn't written back into the mapping or truncated away under the
+ * reader, a change to it waits in the cache until the reader is done */
+TEST_F(TempFileFixture, MmapGuardHoldsPage)
+{
+  PageId id{};
+  {
+    Database db(std::make_unique<MmapStorage>(path));
+    id = db.pager.nextFree(PageType::Interior);
+    db.pager.getPage(id).buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(9);
+  }
+
+  Database db(std::make_unique<MmapStorage>(path));
+  {
+    SharedPage<> reader = db.pager.pinShared(id);
+    EXPECT_FALSE(db.pager.truncate(id));
+    {
+      ExclusivePage<> writer = db.pager.pinExclusive(id);
+      writer->buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(10);
+    }
+    db.pager.flush();
+    EXPECT_EQ(static_cast<std::byte>(9), reader->buf[DEFAULT_PAGE_SIZE - 1]);
+    EXPECT_EQ(1, db.pager.dirtyPages());
+  }
+  db.pager.flush();
+  EXPECT_EQ(0, db.pager.dirtyPages());
+  EXPECT_EQ(static_cast<std::byte>(10), db.pager.readPage(id).buf[DEFAULT_PAGE_SIZE - 1]);
+
+  // once nothing reads it the page can go
+  EXPECT_TRUE(db.pager.truncate(id));
+}
+
+/* pages written through positional I/O are there when the file is opened again */
+TEST_F(TempFileFixture, FileStorageReopen)
+{
+  std::vector<PageId> ids;
+  {
+    Database db(std::make_unique<FileStorage>(path));
+    for (u8 i{0}; i < 5; ++i)
+    {
+      ids.push_back(db.pager.nextFree(PageType::Leaf));
+      db.pager.getPage(ids.back()).buf[DEFAULT_PAGE_SIZE - 1] = static_cast<std::byte>(i);
+    }
+  }
+  EXPECT_EQ(6 * DEFAULT_PAGE_SIZE, std::filesystem::file_size(path));
+
+  Database db(std::make_unique<FileStorage>(path));
+  EXPECT_EQ(6 * DEFAULT_PAGE_SIZE, db.pager.fsize());
+  for (u8 i{0}; i < ids.size(); ++i)
+  {
+    EXPECT_EQ(static_cast<std::byte>(i), db.pager.readPage(ids[i]).buf[DEFAULT_PAGE_SIZE - 1]);
+  }
+}
+
+/* appended pages go into disk space reserved an extent at a time */
+TEST_F(TempFileFixture, FileStorageExtents)
+{
+  constexpr u32 extentPages = 16;
+  {
+    Database db(std::make_unique<FileStorage>(path));
+    db.pager.setExtentSize(extentPages * DEFAULT_PAGE_SIZE);
+    const PagerStats before = db.pager.stats();
+    for (u32 i{0}; i < extentPages + 1; ++i)
+    {
+      UNUSED(db.pager.nextFree(PageType::Leaf));
+    }
+    // the header page was already there, so the second extent is needed for the last two pages
+    EXPECT_EQ(2 * extentPages * DEFAULT_PAGE_SIZE, db.pager.reservedSize());
+    if (db.pager.stats().extents - before.extents == 0)
+    {
+      GTEST_SKIP() << "the file system can't reserve space";
+    }
+    EXPECT_EQ(2, db.pager.stats().extents - before.extents);
+
+    struct stat st;
+    ASSERT_EQ(0, ::stat(path.c_str(), &st));
+    EXPECT_GE(static_cast<u64>(st.st_blocks) * 512, db.pager.reservedSize());
+  }
+
+  // the reserved space past the last page is not part of the file
+  EXPECT_EQ((extentPages + 2) * DEFAULT_PAGE_SIZE, std::filesystem::file_size(path));
+  Database db(std::make_unique<FileStorage>(path));
+  EXPECT_EQ((extentPages + 2) * DEFAULT_PAGE_SIZE, db.pager.fsize());
+}
+
+/* direct I/O bypasses the OS cache, unaligned I/O still works through a copy */
+TEST_F(TempFileFixture, FileStorageDirect)
+{
+  std::unique_ptr<FileStorage> storage;
+  try
+  {
+    storage = std::make_unique<FileStorage>(path, true);
+  }
+  catch (const std::runtime_error &)
+  {
+    GTEST_SKIP() << "direct I/O is not supported here";
+  }
+  ASSERT_TRUE(storage->direct());
+  const u32 alignment = storage->alignment();
+  ASSERT_LE(alignment, MAX_PAGE_SIZE);
+
+  const std::array<std::byte, 3> data = {std::byte{1}, std::byte{2}, std::byte{3}};
+  ASSERT_TRUE(storage->write(alignment + 1, data));
+  EXPECT_EQ(alignment + 4, storage->size());
+  EXPECT_EQ(alignment + 4, std::filesystem::file_size(path));
+  std::array<std::byte, 3> back{};
+  ASSERT_TRUE(storage->read(alignment + 1, back));
+  EXPECT_EQ(data, back);
+  EXPECT_FALSE(storage->read(alignment + 2, back));
+  storage.reset();
+  std::filesystem::remove(path);
+
+  const u32 pageSize = std::max(alignment, DEFAULT_PAGE_SIZE);
+  PageId id{};
+  {
+    Database db(std::make_unique<FileStorage>(path, true), pageSize);
+    id = db.pager.nextFree(PageType::Interior);
+    db.pager.getPage(id).buf[pageSize - 1] = static_cast<std::byte>(7);
+  }
+  Database db(std::make_unique<FileStorage>(path, true));
+  EXPECT_EQ(pageSize, db.pager.pageSize());
+  EXPECT_EQ(PageType::Interior, db.pager.readPage(id).header()->type);
+  EXPECT_EQ(static_cast<std::byte>(7), db.pager.readPage(id).buf[pageSize - 1]);
+
+  // pages smaller than a block can't be used with direct I/O
+  if (alignment > MIN_PAGE_SIZE)
+  {
+    std::filesystem::remove(path);
+    EXPECT_THROW({ Database small(std::make_unique<FileStorage>(path, true), MIN_PAGE_SIZE); },
+                 std::invalid_argument);
+  }
+}
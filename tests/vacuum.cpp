@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include "btree_fixture.hpp"
+#include "database_fixture.hpp"
+#include "database/vacuum.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+#include <sys/stat.h>
+
+namespace
+{
+/* a log whose reads are slow enough that recovery is still going when the test carries on */
+class SlowReadStorage : public StreamStorage
+{
+public:
+  using StreamStorage::StreamStorage;
+
+  [[nodiscard]] bool read(u64 offset, std::span<std::byte> buf) override
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return StreamStorage::read(offset, buf);
+  }
+};
+
+/* a tree of ascending keys with junk pages allocated in between its splits and freed afterwards,
+ * so the tree is spread over the file with holes. returns the root */
+PageId scatteredTree(Pager &pager, u32 keys)
+{
+  PageId leafId{};
+  Page<BTreeHeader> &leaf = pager.fromNextFree<BTreeHeader>(PageType::Leaf, &leafId);
+  UNUSED(leaf);
+  std::vector<PageId> junk;
+  for (u32 key{0}; key < keys; ++key)
+  {
+    leafInsert<u32>(pager, leafId, pager.getPage<BTreeHeader>(leafId), key);
+    if (key % 7 == 0)
+    {
+      junk.push_back(pager.nextFree(PageType::Leaf));
+    }
+  }
+  for (PageId id : junk)
+  {
+    pager.freePage(id);
+  }
+
+  PageId root = leafId;
+  while (!pager.readPage<BTreeHeader>(root).header()->isRoot())
+  {
+    root = pager.readPage<BTreeHeader>(root).header()->parent;
+  }
+  return root;
+}
+
+PageId firstLeaf(Pager &pager, PageId id)
+{
+  while (!pager.readPage<BTreeHeader>(id).header()->isLeaf())
+  {
+    const auto &slots = pager.readPage<BTreeHeader>(id).header()->slots;
+    id = reinterpret_cast<const InteriorCell<u32> *>(slots.readCell(slots.begin()->cellOffset))
+             ->leftChild;
+  }
+  return id;
+}
+} // namespace
+
+/* the tree ends up at the front of the file with its leaves in order and the rest cut off */
+TEST_F(TempFileFixture, VacuumCompacts)
+{
+  constexpr u32 keys = 2000;
+  Pager pager(std::make_unique<FileStorage>(path), DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  const PageId root = scatteredTree(pager, keys);
+  const u64 before = pager.fsize();
+
+  Vacuum vacuum(pager, root);
+  u32 steps = 0;
+  while (!vacuum.step(4))
+  {
+    steps++;
+  }
+  EXPECT_GT(steps, 1);
+  EXPECT_GT(vacuum.stats().moves, 0);
+  EXPECT_GT(vacuum.stats().dropped, 0);
+
+  const u32 treePages = checkParents(pager, vacuum.root()).pages;
+  EXPECT_EQ((1 + treePages) * MIN_PAGE_SIZE, pager.fsize());
+  EXPECT_LT(pager.fsize(), before);
+  EXPECT_EQ(0, pager.readPage<FirstPage::Header>(0).header()->db.freelist);
+  pager.flush();
+  struct stat st;
+  ASSERT_EQ(0, ::stat(path.c_str(), &st));
+  EXPECT_EQ(pager.fsize(), static_cast<u64>(st.st_size));
+
+  // the leaves follow each other in the file
+  PageId leaf = firstLeaf(pager, vacuum.root());
+  u32 leaves = 0;
+  for (PageId next = leaf; next != 0; ++leaves)
+  {
+    leaf = next;
+    next = LeafNode::siblingOf(pager.readPage(leaf));
+    if (next != 0)
+    {
+      EXPECT_EQ(leaf + 1, next);
+    }
+  }
+  EXPECT_EQ(treePages, leaf);
+
+  for (u32 key{0}; key < keys; ++key)
+  {
+    const Page<BTreeHeader> &found = InteriorNode::searchGetLeaf(pager, vacuum.root(), key);
+    const auto [first, last] = LeafNode::equalRange<u32>(found.header()->slots, key);
+    EXPECT_LT(first, last) << key;
+  }
+}
+
+/* changes between steps make the vacuum walk the tree again */
+TEST_F(TempFileFixture, VacuumReplans)
+{
+  Pager pager(std::make_unique<FileStorage>(path), DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  const PageId root = scatteredTree(pager, 1000);
+
+  Vacuum vacuum(pager, root);
+  EXPECT_FALSE(vacuum.step(1));
+  const PageId extra = pager.nextFree(PageType::Leaf);
+  pager.freePage(extra);
+  while (!vacuum.step())
+  {
+  }
+  EXPECT_EQ(2, vacuum.stats().plans);
+  EXPECT_EQ((1 + checkParents(pager, vacuum.root()).pages) * MIN_PAGE_SIZE, pager.fsize());
+}
+
+/* with a log every move is committed, so the pages it changed can leave a small cache */
+TEST_F(TempFileFixture, VacuumWithLog)
+{
+  constexpr u32 keys = 4000;
+  PageId root;
+  {
+    Pager pager(std::make_unique<FileStorage>(path), DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+    root = scatteredTree(pager, keys);
+  }
+
+  std::stringstream log;
+  Pager pager(std::make_unique<FileStorage>(path), BufferPool::MIN_FRAMES * 8 * MIN_PAGE_SIZE,
+              MIN_PAGE_SIZE);
+  pager.useLog(std::make_unique<StreamStorage>(log));
+  const u64 before = pager.fsize();
+  Vacuum vacuum(pager, root);
+  while (!vacuum.step())
+  {
+  }
+  EXPECT_GT(vacuum.stats().moves, pager.cacheCapacity());
+  EXPECT_EQ((1 + checkParents(pager, vacuum.root()).pages) * MIN_PAGE_SIZE, pager.fsize());
+  EXPECT_LT(pager.fsize(), before);
+  for (u32 key{0}; key < keys; ++key)
+  {
+    const Page<BTreeHeader> &found = InteriorNode::searchGetLeaf(pager, vacuum.root(), key);
+    const auto [first, last] = LeafNode::equalRange<u32>(found.header()->slots, key);
+    EXPECT_LT(first, last) << key;
+  }
+}
+
+/* the file can be shrunk while pages are still being redone, with another thread waiting for it */
+TEST_F(TempFileFixture, TruncateDuringRecovery)
+{
+  constexpr u32 pages = 100;
+  std::string fileImage, logImage;
+  {
+    std::stringstream file, log;
+    Pager pager(file, DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+    pager.useLog(std::make_unique<StreamStorage>(log));
+    for (u32 i{0}; i < pages; ++i)
+    {
+      UNUSED(pager.nextFree(PageType::Leaf));
+      UNUSED(pager.commit());
+    }
+    fileImage = file.str();
+    logImage = log.str();
+  }
+  std::ofstream(path, std::ios::binary) << fileImage;
+
+  std::stringstream log(logImage);
+  Pager pager(std::make_unique<FileStorage>(path), DEFAULT_CACHE_SIZE, MIN_PAGE_SIZE);
+  pager.useLog(std::make_unique<SlowReadStorage>(log), 1);
+  std::thread waiter([&pager] { pager.waitForRecovery(); });
+  EXPECT_TRUE(pager.truncate(pages / 2));
+  waiter.join();
+  EXPECT_FALSE(pager.recovering());
+  EXPECT_EQ(pages / 2 * MIN_PAGE_SIZE, pager.fsize());
+}
@@ -0,0 +1,494 @@
+#include <gtest/gtest.h>
+
+#include "database/pager.hpp"
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+constexpr u32 LAST = DEFAULT_PAGE_SIZE - 1;
+
+/* a log whose syncs take long enough for commits to pile up behind them */
+class SlowSyncStorage : public StreamStorage
+{
+public:
+  using StreamStorage::StreamStorage;
+
+  bool sync() override
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    return StreamStorage::sync();
+  }
+};
+
+/* a database file that counts its syncs */
+class CountingStorage : public StreamStorage
+{
+public:
+  using StreamStorage::StreamStorage;
+
+  bool sync() override
+  {
+    syncs++;
+    return StreamStorage::sync();
+  }
+
+  u32 syncs = 0;
+};
+} // namespace
+
+/* a crash keeps what was committed and loses what wasn't, even if nothing reached the file */
+TEST(Wal, RecoverCommitted)
+{
+  std::stringstream file, log;
+  std::string fileImage, logImage;
+  PageId committed, uncommitted;
+  {
+    Pager pager(file);
+    pager.useLog(std::make_unique<StreamStorage>(log));
+    committed = pager.nextFree(PageType::Leaf);
+    pager.getPage(committed).buf[LAST] = std::byte{42};
+    pager.commit();
+
+    uncommitted = pager.nextFree(PageType::Leaf);
+    pager.getPage(committed).buf[LAST] = std::byte{11};
+    // uncommitted pages are never written back
+    pager.flush();
+    fileImage = file.str();
+    logImage = log.str();
+  }
+  EXPECT_EQ(DEFAULT_PAGE_SIZE, fileImage.size());
+
+  std::stringstream crashedFile(fileImage), crashedLog(logImage);
+  Pager pager(crashedFile);
+  pager.useLog(std::make_unique<StreamStorage>(crashedLog));
+  EXPECT_EQ(2 * DEFAULT_PAGE_SIZE, pager.fsize());
+  EXPECT_EQ(std::byte{42}, pager.readPage(committed).buf[LAST]);
+  EXPECT_NE(uncommitted, committed);
+}
+
+/* a commit record cut off by the crash does not count */
+TEST(Wal, TornCommit)
+{
+  std::stringstream file, log;
+  PageId id;
+  std::string fileImage, logImage;
+  {
+    Pager pager(file);
+    pager.useLog(std::make_unique<StreamStorage>(log));
+    id = pager.nextFree(PageType::Leaf);
+    pager.getPage(id).buf[LAST] = std::byte{1};
+    pager.commit();
+    pager.getPage(id).buf[LAST] = std::byte{2};
+    pager.commit();
+    fileImage = file.str();
+    logImage = log.str();
+  }
+
+  logImage.resize(logImage.size() - 10);
+  std::stringstream crashedFile(fileImage), crashedLog(logImage);
+  Pager pager(crashedFile);
+  pager.useLog(std::make_unique<StreamStorage>(crashedLog));
+  EXPECT_EQ(std::byte{1}, pager.readPage(id).buf[LAST]);
+}
+
+/* a checkpoint puts the committed pages in the file, after which there is nothing to redo */
+TEST(Wal, Checkpoint)
+{
+  std::stringstream file, log;
+  Pager pager(file);
+  pager.useLog(std::make_unique<StreamStorage>(log));
+  const PageId id = pager.nextFree(PageType::Leaf);
+  pager.getPage(id).buf[LAST] = std::byte{7};
+  const Lsn lsn = pager.commit();
+  pager.checkpoint();
+
+  EXPECT_EQ(std::byte{7}, static_cast<std::byte>(file.str()[(id + 1) * DEFAULT_PAGE_SIZE - 1]));
+  EXPECT_LE(lsn, pager.wal()->end());
+
+  std::stringstream logCopy(log.str());
+  Wal wal(std::make_unique<StreamStorage>(logCopy), DEFAULT_PAGE_SIZE);
+  EXPECT_TRUE(wal.recover().empty());
+  EXPECT_EQ(pager.wal()->end(), wal.end());
+}
+
+/* commits that arrive while the log is syncing share the next sync */
+TEST(Wal, GroupCommit)
+{
+  constexpr u32 THREADS = 8;
+  std::stringstream file, log;
+  Pager pager(file);
+  pager.useLog(std::make_unique<SlowSyncStorage>(log));
+  std::vector<PageId> ids;
+  for (u32 i{0}; i < THREADS; ++i)
+  {
+    ids.push_back(pager.nextFree(PageType::Leaf));
+  }
+  pager.commit();
+  const WalStats before = pager.wal()->stats();
+
+  std::vector<std::thread> threads;
+  for (u32 i{0}; i < THREADS; ++i)
+  {
+    threads.emplace_back(
+        [&, i]
+        {
+          {
+            auto page = pager.pinExclusive(ids[i]);
+            page->buf[LAST] = static_cast<std::byte>(i + 1);
+          }
+          pager.commit();
+        });
+  }
+  for (auto &t : threads)
+  {
+    t.join();
+  }
+
+  EXPECT_EQ(before.commits + THREADS, pager.wal()->stats().commits);
+  EXPECT_LT(pager.wal()->stats().syncs - before.syncs, THREADS);
+  EXPECT_EQ(pager.wal()->end(), pager.wal()->durable());
+  for (u32 i{0}; i < THREADS; ++i)
+  {
+    EXPECT_EQ(static_cast<std::byte>(i + 1), pager.readPage(ids[i]).buf[LAST]);
+  }
+}
+
+/* a commit only logs the pages its own thread changed, and leaves a page being read untouched */
+TEST(Wal, CommitIsPerThread)
+{
+  std::stringstream file, log;
+  std::string fileImage, logImage;
+  PageId mine, theirs;
+  {
+    Pager pager(file);
+    pager.useLog(std::make_unique<StreamStorage>(log));
+    mine = pager.nextFree(PageType::Leaf);
+    theirs = pager.nextFree(PageType::Leaf);
+    pager.commit();
+
+    pager.getPage(mine).buf[LAST] = std::byte{1};
+    std::thread(
+        [&]
+        {
+          pager.getPage(theirs).buf[LAST] = std::byte{2};
+          pager.commit();
+        })
+        .join();
+    fileImage = file.str();
+    logImage = log.str();
+
+    // the lsn and checksum only go into the copies that are logged and written
+    const auto reader = pager.pinShared(mine);
+    const PageBuffer before = reader->buf;
+    pager.commit();
+    pager.flush();
+    EXPECT_EQ(before, reader->buf);
+  }
+
+  std::stringstream crashedFile(fileImage), crashedLog(logImage);
+  Pager pager(crashedFile);
+  pager.useLog(std::make_unique<StreamStorage>(crashedLog));
+  EXPECT_EQ(std::byte{0}, pager.readPage(mine).buf[LAST]);
+  EXPECT_EQ(std::byte{2}, pager.readPage(theirs).buf[LAST]);
+}
+
+/* a page changed again since its commit can't be written back, but the image it was committed with
+ * can, so the log still starts over */
+TEST(Wal, CheckpointWritesCommittedImage)
+{
+  std::stringstream file, log;
+  std::string fileImage, logImage;
+  PageId id;
+  {
+    Pager pager(file);
+    pager.useLog(std::make_unique<StreamStorage>(log));
+    id = pager.nextFree(PageType::Leaf);
+    pager.getPage(id).buf[LAST] = std::byte{1};
+    pager.commit();
+    pager.getPage(id).buf[LAST] = std::byte{2};
+    pager.checkpoint();
+    EXPECT_EQ(0, pager.wal()->size());
+    EXPECT_EQ(std::byte{2}, pager.readPage(id).buf[LAST]);
+    fileImage = file.str();
+    logImage = log.str();
+
+    // the next commit logs the whole page again
+    pager.commit();
+    EXPECT_LT(static_cast<u64>(DEFAULT_PAGE_SIZE), pager.wal()->size());
+  }
+
+  std::stringstream crashedFile(fileImage), crashedLog(logImage);
+  Pager pager(crashedFile);
+  pager.useLog(std::make_unique<StreamStorage>(crashedLog));
+  EXPECT_EQ(std::byte{1}, pager.readPage(id).buf[LAST]);
+}
+
+/* the checkpointer runs on its interval, and straight away once the log is too big */
+TEST(Wal, BackgroundCheckpoint)
+{
+  const auto waitForCheckpoints = [](Pager &pager, u64 n)
+  {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pager.stats().checkpoints < n && std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pager.stats().checkpoints >= n;
+  };
+
+  std::stringstream file, log;
+  Pager pager(file);
+  pager.useLog(std::make_unique<StreamStorage>(log));
+  pager.startCheckpointer({.interval = std::chrono::milliseconds(10)});
+  std::vector<PageId> ids;
+  for (u8 i{0}; i < 40; ++i)
+  {
+    ids.push_back(pager.nextFree(PageType::Leaf));
+    pager.getPage(ids.back()).buf[LAST] = static_cast<std::byte>(i);
+  }
+  pager.commit();
+  ASSERT_TRUE(waitForCheckpoints(pager, 1));
+  EXPECT_LE(40, pager.stats().checkpointWrites);
+  for (u8 i{0}; i < ids.size(); ++i)
+  {
+    EXPECT_EQ(static_cast<char>(i), file.str()[(ids[i] + 1) * DEFAULT_PAGE_SIZE - 1]);
+  }
+
+  pager.startCheckpointer({.interval = std::chrono::hours(1), .maxLogSize = DEFAULT_PAGE_SIZE});
+  const u64 checkpoints = pager.stats().checkpoints;
+  pager.getPage(ids[0]).buf[LAST] = std::byte{100};
+  pager.getPage(ids[1]).buf[LAST] = std::byte{101};
+  pager.commit();
+  ASSERT_TRUE(waitForCheckpoints(pager, checkpoints + 1));
+  EXPECT_EQ(101, file.str()[(ids[1] + 1) * DEFAULT_PAGE_SIZE - 1]);
+}
+
+/* recovery splits the pages between threads, and pages can be read before it is done */
+TEST(Wal, ParallelRedo)
+{
+  constexpr u32 PAGES = 100;
+  std::stringstream file, log;
+  std::string fileImage, logImage;
+  std::vector<PageId> ids;
+  {
+    Pager pager(file);
+    pager.useLog(std::make_unique<StreamStorage>(log));
+    for (u32 i{0}; i < PAGES; ++i)
+    {
+      ids.push_back(pager.nextFree(PageType::Leaf));
+      pager.getPage(ids.back()).buf[LAST] = static_cast<std::byte>(i);
+      pager.commit();
+    }
+    fileImage = file.str();
+    logImage = log.str();
+  }
+
+  std::stringstream crashedFile(fileImage), crashedLog(logImage);
+  Pager pager(crashedFile);
+  pager.useLog(std::make_unique<StreamStorage>(crashedLog), 4);
+  EXPECT_EQ((PAGES + 1) * DEFAULT_PAGE_SIZE, pager.fsize());
+  EXPECT_EQ(std::byte{PAGES - 1}, pager.readPage(ids.back()).buf[LAST]);
+
+  pager.waitForRecovery();
+  EXPECT_FALSE(pager.recovering());
+  // every page including the first, which holds the free list
+  EXPECT_EQ(PAGES + 1, pager.stats().redone);
+  for (u32 i{0}; i < PAGES; ++i)
+  {
+    EXPECT_EQ(static_cast<std::byte>(i), pager.readPage(ids[i]).buf[LAST]);
+  }
+}
+
+/* records older than the page on disk are not applied again */
+TEST(Wal, RedoSkipsApplied)
+{
+  std::stringstream file, log;
+  std::string fileImage, logImage;
+  PageId id;
+  {
+    Pager pager(file);
+    pager.useLog(std::make_unique<StreamStorage>(log));
+    id = pager.nextFree(PageType::Leaf);
+    pager.getPage(id).buf[LAST] = std::byte{1};
+    pager.commit();
+    pager.getPage(id).buf[LAST] = std::byte{2};
+    pager.commit();
+    // the page reaches the file but the log is not started over
+    pager.flush();
+    fileImage = file.str();
+    logImage = log.str();
+  }
+
+  std::stringstream crashedFile(fileImage), crashedLog(logImage);
+  Pager pager(crashedFile);
+  pager.useLog(std::make_unique<StreamStorage>(crashedLog), 1);
+  pager.waitForRecovery();
+  EXPECT_EQ(std::byte{2}, pager.readPage(id).buf[LAST]);
+  // both of the page's records, and the first page's from allocating it
+  EXPECT_EQ(3, pager.stats().redoSkipped);
+}
+
+/* a redone page changed again before a checkpoint keeps its committed state in the file or the log */
+TEST(Wal, CheckpointAfterRedo)
+{
+  std::stringstream file, log;
+  std::string fileImage, logImage;
+  PageId id;
+  {
+    Pager pager(file);
+    pager.useLog(std::make_unique<StreamStorage>(log));
+    id = pager.nextFree(PageType::Leaf);
+    pager.getPage(id).buf[LAST] = std::byte{1};
+    pager.commit();
+    fileImage = file.str();
+    logImage = log.str();
+  }
+
+  std::stringstream recoveredFile(fileImage), recoveredLog(logImage);
+  {
+    Pager pager(recoveredFile);
+    pager.useLog(std::make_unique<StreamStorage>(recoveredLog), 1);
+    pager.waitForRecovery();
+    pager.getPage(id).buf[LAST] = std::byte{2};
+    // the change is not committed, so only the redone image can be written back
+    pager.checkpoint();
+    fileImage = recoveredFile.str();
+    logImage = recoveredLog.str();
+  }
+
+  std::stringstream crashedFile(fileImage), crashedLog(logImage);
+  Pager pager(crashedFile);
+  pager.useLog(std::make_unique<StreamStorage>(crashedLog));
+  EXPECT_EQ(std::byte{1}, pager.readPage(id).buf[LAST]);
+}
+
+/* full syncs the log on every commit, normal only before writing pages back, off never does */
+TEST(Wal, SyncModes)
+{
+  for (Sync mode : {Sync::Full, Sync::Normal, Sync::Off})
+  {
+    std::stringstream file, log;
+    auto storage = std::make_unique<CountingStorage>(file);
+    CountingStorage &counted = *storage;
+    Pager pager(std::move(storage));
+    pager.useLog(std::make_unique<StreamStorage>(log));
+    pager.setSync(mode);
+    const PageId id = pager.nextFree(PageType::Leaf);
+
+    u64 syncs = pager.wal()->stats().syncs;
+    for (u32 i{0}; i < 10; ++i)
+    {
+      pager.getPage(id).buf[LAST] = static_cast<std::byte>(i);
+      pager.commit();
+    }
+    EXPECT_EQ(mode == Sync::Full ? 10 : 0, pager.wal()->stats().syncs - syncs);
+    // every mode hands the commits to the log's storage
+    EXPECT_EQ(log.str().size(), pager.wal()->end());
+
+    syncs = pager.wal()->stats().syncs;
+    const u32 fileSyncs = counted.syncs;
+    pager.checkpoint();
+    EXPECT_EQ(mode == Sync::Normal ? 1 : 0, pager.wal()->stats().syncs - syncs);
+    EXPECT_EQ(mode != Sync::Off, counted.syncs > fileSyncs);
+    EXPECT_EQ(9, static_cast<u32>(pager.readPage(id).buf[LAST]));
+
+    // a commit can ask for more than the pager does
+    pager.getPage(id).buf[LAST] = std::byte{42};
+    syncs = pager.wal()->stats().syncs;
+    pager.commit(Sync::Full);
+    EXPECT_EQ(1, pager.wal()->stats().syncs - syncs);
+  }
+}
+
+/* after its first image a page is logged as the bytes that changed, until the log starts over */
+TEST(Wal, DeltaRecords)
+{
+  std::stringstream file, log;
+  Pager pager(file);
+  pager.useLog(std::make_unique<StreamStorage>(log));
+  const PageId id = pager.nextFree(PageType::Leaf);
+  pager.commit();
+  EXPECT_EQ(0, pager.wal()->stats().deltas);
+
+  const Lsn start = pager.wal()->end();
+  pager.getPage(id).buf[LAST] = std::byte{1};
+  pager.commit();
+  EXPECT_EQ(1, pager.wal()->stats().deltas);
+  // the header's lsn and the last byte, then the commit
+  EXPECT_LT(pager.wal()->end() - start, 128);
+
+  pager.checkpoint();
+  const u64 records = pager.wal()->stats().records;
+  pager.getPage(id).buf[LAST] = std::byte{2};
+  pager.commit();
+  EXPECT_EQ(records + 1, pager.wal()->stats().records);
+  EXPECT_EQ(1, pager.wal()->stats().deltas);
+  EXPECT_GT(pager.wal()->size(), DEFAULT_PAGE_SIZE);
+}
+
+/* a page torn while being written back is rebuilt from its image and the deltas after it */
+TEST(Wal, DeltaRedoTornPage)
+{
+  constexpr u32 COMMITS = 20;
+  std::stringstream file, log;
+  std::string fileImage, logImage;
+  PageId id;
+  {
+    Pager pager(file);
+    pager.useLog(std::make_unique<StreamStorage>(log));
+    id = pager.nextFree(PageType::Leaf);
+    for (u32 i{0}; i < COMMITS; ++i)
+    {
+      pager.getPage(id).buf[LAST - i * 100] = static_cast<std::byte>(i + 1);
+      pager.commit();
+      if (i == COMMITS / 2)
+      {
+        // the page reaches the file but the log is not started over
+        pager.flush();
+      }
+    }
+    // all but the commit with the new page
+    EXPECT_EQ(COMMITS - 1, pager.wal()->stats().deltas);
+    fileImage = file.str();
+    logImage = log.str();
+  }
+
+  for (bool torn : {false, true})
+  {
+    std::string image = fileImage;
+    if (torn)
+    {
+      std::fill_n(image.begin() + id * DEFAULT_PAGE_SIZE, DEFAULT_PAGE_SIZE / 2, '\0');
+    }
+    std::stringstream crashedFile(image), crashedLog(logImage);
+    Pager pager(crashedFile);
+    pager.useLog(std::make_unique<StreamStorage>(crashedLog));
+    const Page<> &page = pager.readPage(id);
+    for (u32 i{0}; i < COMMITS; ++i)
+    {
+      EXPECT_EQ(static_cast<std::byte>(i + 1), page.buf[LAST - i * 100]);
+    }
+  }
+}
+
+/* a delta that would run off the end of the page is refused */
+TEST(Wal, DeltaPatchBounds)
+{
+  std::vector<std::byte> before(64), after(64);
+  after[3] = std::byte{1};
+  after[9] = std::byte{2};
+  after[40] = std::byte{3};
+  const std::vector<std::byte> delta = Wal::diff(before, after);
+  // bytes 3 to 9 share a run, 40 gets its own
+  EXPECT_EQ(2 * sizeof(Wal::DeltaRun) + 7 + 1, delta.size());
+
+  std::vector<std::byte> page(64);
+  EXPECT_TRUE(Wal::patch(page, delta));
+  EXPECT_EQ(after, page);
+
+  std::vector<std::byte> small(32);
+  EXPECT_FALSE(Wal::patch(small, delta));
+  EXPECT_FALSE(Wal::patch(page, std::span(delta).first(delta.size() - 1)));
+}